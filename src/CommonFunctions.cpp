@@ -2,49 +2,34 @@
 // Licensed under the Apache license, version 2.0
 // See LICENSE.txt for details
 
-#include <windows.h>
+#include "Platform.h"
 #include "Constants.h"
 #include "CommonFunctions.h"
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#ifndef _WIN32
+#include <cstring>
+#endif
 
-void DeleteHiveLogFiles
+void ReportError
 (
-    _In_ const std::wstring &HiveFilePath
+    _In_ const HRESULT ErrorCode,
+    _In_ const std::wstring_view Context
 )
 {
-    for (auto& Ext : Constants::Hives::LogFileExtensions)
+    if (!Context.empty())
     {
-        std::wstring LogFilePath = HiveFilePath + Ext;
-        DWORD Attributes = GetFileAttributesW(LogFilePath.c_str());
-        if (Attributes != INVALID_FILE_ATTRIBUTES)
-        {
-            Attributes &= ~FILE_ATTRIBUTE_HIDDEN;
-            Attributes &= ~FILE_ATTRIBUTE_SYSTEM;
-            SetFileAttributesW(LogFilePath.c_str(), Attributes);
-            DeleteFileW(LogFilePath.c_str());
-        }
+        std::wcerr << Context << L":" << std::endl;
     }
-}
 
-void ReportError
-(
-    _In_ const HRESULT ErrorCode,
-    _In_ const std::wstring& Context
-)
-{
+#ifdef _WIN32
     LPWSTR MessageBuffer = NULL;
     DWORD FmtResult = FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
                                      FORMAT_MESSAGE_IGNORE_INSERTS | FORMAT_MESSAGE_MAX_WIDTH_MASK,
                                      NULL, ErrorCode, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
                                      (LPWSTR)&MessageBuffer, 0, NULL);
 
-    if (!Context.empty())
-    {
-        std::wcerr << Context << L":" << std::endl;
-    }
-
     if (FmtResult == 0)
     {
         std::wcerr << L"ERROR " << std::hex << std::setw(8) << ErrorCode << L" (could not format message)";
@@ -55,10 +40,29 @@ void ReportError
         LocalFree((PVOID)MessageBuffer);
         MessageBuffer = NULL;
     }
+#else
+    // POSIX code paths wrap errno values with HRESULT_FROM_WIN32
+    if (HRESULT_FACILITY(ErrorCode) == FACILITY_WIN32)
+    {
+        std::wcerr << L"ERROR " << std::hex << std::setw(8) << ErrorCode << L" (" << std::strerror(HRESULT_CODE(ErrorCode)) << L")";
+    }
+    else
+    {
+        std::wcerr << L"ERROR " << std::hex << std::setw(8) << ErrorCode << L" (could not format message)";
+    }
+#endif
 
     std::wcerr << std::endl << std::endl;
 }
 
+void ReportWarning
+(
+    _In_ const std::wstring_view Message
+)
+{
+    std::wcerr << L"WARNING: " << Message << std::endl << std::endl;
+}
+
 VOID GlobalStringSubstitute(
     _Inout_ std::wstring& String,
     _In_ const std::wstring& Pattern,
@@ -72,3 +76,41 @@ VOID GlobalStringSubstitute(
         Position = String.find(Pattern, Position + Replacement.length());
     }
 }
+
+#ifndef _WIN32
+std::string PathToUtf8
+(
+    _In_ const std::wstring& Path
+)
+{
+    std::string Encoded;
+    Encoded.reserve(Path.length());
+    for (const wchar_t Char : Path)
+    {
+        const uint32_t CodePoint = static_cast<uint32_t>(Char);
+        if (CodePoint < 0x80)
+        {
+            Encoded.push_back(static_cast<char>(CodePoint));
+        }
+        else if (CodePoint < 0x800)
+        {
+            Encoded.push_back(static_cast<char>(0xC0 | (CodePoint >> 6)));
+            Encoded.push_back(static_cast<char>(0x80 | (CodePoint & 0x3F)));
+        }
+        else if (CodePoint < 0x10000)
+        {
+            Encoded.push_back(static_cast<char>(0xE0 | (CodePoint >> 12)));
+            Encoded.push_back(static_cast<char>(0x80 | ((CodePoint >> 6) & 0x3F)));
+            Encoded.push_back(static_cast<char>(0x80 | (CodePoint & 0x3F)));
+        }
+        else
+        {
+            Encoded.push_back(static_cast<char>(0xF0 | (CodePoint >> 18)));
+            Encoded.push_back(static_cast<char>(0x80 | ((CodePoint >> 12) & 0x3F)));
+            Encoded.push_back(static_cast<char>(0x80 | ((CodePoint >> 6) & 0x3F)));
+            Encoded.push_back(static_cast<char>(0x80 | (CodePoint & 0x3F)));
+        }
+    }
+    return Encoded;
+}
+#endif
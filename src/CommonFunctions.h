@@ -3,14 +3,9 @@
 // See LICENSE.txt for details
 
 #pragma once
+#include "Platform.h"
 #include <string>
-
-/// @brief Delete .LOG1 and .LOG2 system files that were created when loading an application hive
-/// @param[in] HiveFilePath Path to the hive file
-void DeleteHiveLogFiles
-(
-    _In_ const std::wstring &HiveFilePath
-);
+#include <string_view>
 
 /// @brief Report an error
 /// @param[in] ErrorCode HRESULT value
@@ -18,7 +13,14 @@ void DeleteHiveLogFiles
 void ReportError
 (
     _In_ const HRESULT ErrorCode,
-    _In_ const std::wstring& Context = std::wstring{}
+    _In_ const std::wstring_view Context = std::wstring_view{}
+);
+
+/// @brief Report a condition that does not stop the current operation
+/// @param[in] Message Description of the condition and of how it is handled
+void ReportWarning
+(
+    _In_ const std::wstring_view Message
 );
 
 /// @brief Perform global replacement of substring in a std::wstring
@@ -30,3 +32,13 @@ VOID GlobalStringSubstitute(
     _In_ const std::wstring& Pattern,
     _In_ const std::wstring& Replacement
 );
+
+#ifndef _WIN32
+/// @brief Encode a path to UTF-8 for POSIX file APIs
+/// @param[in] Path Path as a wide string (UTF-32 on POSIX platforms)
+/// @return UTF-8 encoded path
+std::string PathToUtf8
+(
+    _In_ const std::wstring& Path
+);
+#endif
@@ -3,7 +3,7 @@
 // See LICENSE.txt for details
 
 #pragma once
-#include <windows.h>
+#include "Platform.h"
 #include <vector>
 #include <string>
 
@@ -17,12 +17,61 @@ namespace Constants {
 
         /// Switch for converting a .reg file to a hive
         static const std::wstring RegFileToHiveSwitch { L"--reg-file-to-hive" };
+
+        /// Switch for rewriting a hive, e.g. for compacting it or for merging its logs
+        static const std::wstring HiveToHiveSwitch { L"--hive-to-hive" };
+
+        /// Switch for printing a key of a hive, or one of its values, as in a .reg file
+        static const std::wstring GetSwitch { L"--get" };
+
+        /// Switch for listing the paths of a key of a hive and of all the keys below it
+        static const std::wstring ListSwitch { L"--list" };
+
+        /// Switch for checking the structure of a hive, and reporting its problems
+        static const std::wstring VerifyHiveSwitch { L"--verify-hive" };
+
+        /// Option setting the size of the buffer used when reading .reg files
+        static const std::wstring BufferSizeOption { L"--buffer-size" };
+
+        /// Option setting the count of worker threads
+        static const std::wstring ThreadCountOption { L"--threads" };
+
+        /// Option selecting a key to export from a hive, by a path pattern relative to the hive root
+        static const std::wstring SubkeyOption { L"--subkey" };
+
+        /// Option excluding a key and its subtree from a hive export, by a path pattern relative to the hive root
+        static const std::wstring ExcludeOption { L"--exclude" };
+
+        /// Option naming the index file of a hive, built when missing or out of date, for looking up keys and values
+        static const std::wstring IndexOption { L"--index" };
+
+        /// Wildcard matching any sequence of characters in a key name of a path pattern
+        static const WCHAR AnyCharactersWildcard { L'*' };
+
+        /// Wildcard matching any single character in a key name of a path pattern
+        static const WCHAR AnyCharacterWildcard { L'?' };
     };
 
     /// Program defaults
     namespace Defaults {
         /// Default Root registry path in generated .reg files
         static const std::wstring ExportKeyPath { L"(HiveRoot)" };
+
+        /// Default size in bytes of the buffer used when reading or writing .reg files
+        static const SIZE_T RegFileBufferSize = 4u * 1024u * 1024u;
+
+        /// Size in bytes of the blocks by which buffered output files are written
+        static const SIZE_T OutputBlockSize = 64u * 1024u;
+
+        /// Size in bytes of the blocks from which threads carve the allocations of a registry tree
+        static const SIZE_T ArenaBlockSize = 256u * 1024u;
+
+        /// Size in bytes up to which the data of a registry value is stored within the value, without allocation.
+        /// Fits numbers and short strings.
+        static const SIZE_T ValueDataInlineSize = 32u;
+
+        /// Count of separately locked parts of a name table, so that threads parsing a file seldom wait for each other
+        static const SIZE_T NameTableShardCount = 64u;
     };
 
     /// Hive-specific constants
@@ -32,6 +81,12 @@ namespace Constants {
 
         /// Special value storing the destination of a symbolic link
         static const std::wstring SymbolicLinkValue { L"SymbolicLinkValue" };
+
+        /// Maximal depth of a key below the hive root, as enforced by the configuration manager
+        static const SIZE_T MaximalKeyDepth = 512u;
+
+        /// Count of subkeys from which a key read in parallel hands its subkeys to other threads, when they run short of work
+        static const SIZE_T ParallelReadSplitSubkeyCount = 8u;
     };
 
     /// .reg file-specific constants
@@ -88,6 +143,19 @@ namespace Constants {
 
         /// Sequence used when continuing a hexadecimal rendition on a new line
         static const std::wstring HexByteNewLine { L"\\\r\n" };
+
+        /// Count of chunks per worker thread when parsing a .reg file in parallel, for load balancing
+        static const SIZE_T ParallelChunksPerThread = 4u;
+
+        /// Minimal count of code units in a chunk of a .reg file parsed in parallel
+        static const SIZE_T ParallelChunkMinimalLength = 512u * 1024u;
+
+        /// Count of code units above which the rendition of a subtree is split into several tasks,
+        /// and around which ranges of keys of a flat tree are rendered by separate tasks
+        static const SIZE_T ParallelRenderTaskLength = 256u * 1024u;
+
+        /// Count of rendering tasks per worker thread held in memory at once when rendering a .reg file
+        static const SIZE_T ParallelRenderTasksPerThread = 4u;
     };
 };
 
@@ -4,57 +4,187 @@
 
 #pragma once
 
-#include <Windows.h>
+#include "Platform.h"
+#include "FlatRegistryTree.h"
+#include "HiveIndex.h"
+#include "HiveView.h"
+#include "KeyPathPatterns.h"
+#include "NameTable.h"
+#include "ValueData.h"
+#include <memory_resource>
 #include <string>
 #include <vector>
 
+/// Allocator of the internal representation of registry keys and values.
+/// All the strings and containers of a tree use the allocator of its root key, typically a #MonotonicArena,
+/// so that a whole tree is built with few allocations and released in one step.
+/// @note Keys and values cannot be copied, only moved, so that no stage of a conversion duplicates a subtree.
+using RegistryAllocator = std::pmr::polymorphic_allocator<std::byte>;
+
 /// Internal representation of a registry value.
 struct RegistryValue {
-    /// Name of the registry value. May not contain null character
-    std::wstring Name;
+    using allocator_type = RegistryAllocator;
+
+    RegistryValue() = default;
+    RegistryValue(const RegistryValue&) = delete;
+    RegistryValue(RegistryValue&&) = default;
+    RegistryValue& operator=(const RegistryValue&) = delete;
+    RegistryValue& operator=(RegistryValue&&) = default;
+
+    explicit RegistryValue(const allocator_type& Allocator) :
+        BinaryValue(Allocator)
+    {
+    }
+
+    RegistryValue(RegistryValue&& Other, const allocator_type& Allocator) :
+        Name(Other.Name), Type(Other.Type), BinaryValue(std::move(Other.BinaryValue), Allocator)
+    {
+    }
+
+    /// @brief Get the allocator of the value
+    allocator_type get_allocator() const { return BinaryValue.get_allocator(); }
+
+    /// Name of the registry value, interned in the #NameTable of the tree. May not contain null character
+    RegistryName Name;
 
     /// Type of the registry value. Usually a small number.
-    DWORD Type;
+    DWORD Type = REG_NONE;
 
-    /// Binary representation of the underlying data as a byte buffer.
-    std::vector<BYTE> BinaryValue;
+    /// Binary representation of the underlying data as a byte buffer. Small data is stored within the value.
+    ValueData BinaryValue;
 };
 
 /// Internal representation of a registry key.
 struct RegistryKey {
-    /// Name of the registry key. May contain any character except backslash
-    std::wstring Name;
+    using allocator_type = RegistryAllocator;
+
+    RegistryKey() = default;
+    RegistryKey(const RegistryKey&) = delete;
+    RegistryKey(RegistryKey&&) = default;
+    RegistryKey& operator=(const RegistryKey&) = delete;
+    RegistryKey& operator=(RegistryKey&&) = default;
+
+    explicit RegistryKey(const allocator_type& Allocator) :
+        Subkeys(Allocator), Values(Allocator)
+    {
+    }
+
+    RegistryKey(RegistryKey&& Other, const allocator_type& Allocator) :
+        Name(Other.Name), Subkeys(std::move(Other.Subkeys), Allocator), Values(std::move(Other.Values), Allocator)
+    {
+    }
+
+    /// @brief Get the allocator of the key, shared by its subkeys and values
+    allocator_type get_allocator() const { return Subkeys.get_allocator(); }
+
+    /// Name of the registry key, interned in the #NameTable of the tree. May contain any character except backslash
+    RegistryName Name;
 
     /// Container of subkeys
-    std::vector<RegistryKey> Subkeys;
+    std::pmr::vector<RegistryKey> Subkeys;
 
     /// Container of values
-    std::vector<RegistryValue> Values;
+    std::pmr::vector<RegistryValue> Values;
 };
 
 /// @brief Create an internal representation of a registry key from a registry hive (binary) file
 /// @param[in] HiveFilePath Path to the registry hive
-/// @param[in] RootName Path to the root key for export
-/// @param[out] RegKey Internal structure
+/// @param[in] RootName Name of the root key of the representation
+/// @param[in] ThreadCount Count of threads reading the hive
+/// @param[in,out] Names Table in which the names of keys and values are interned. Must outlive #RegKey.
+/// @param[out] RegKey Internal structure. The tree is built with its allocator, which must be thread-safe
+///                    when several threads read the hive.
 /// @return HRESULT semantics
-/// @note For the moment, system files that are created (.LOG1, .LOG2) are not cleaned up.
+/// @note The hive file is parsed from a read-only mapping, as #HiveView does. It is neither loaded by the system
+///       nor modified, and the logs of a dirty hive are replayed in memory.
+/// @note Values and subkeys are in the order RegEnumValueW and RegEnumKeyExW would use.
+/// @note Subtrees are read concurrently, large subkey lists being split among threads as they run short of work.
+///       The tree does not depend on #ThreadCount.
 _Must_inspect_result_
 HRESULT HiveToInternal
 (
     _In_ const std::wstring &HiveFilePath,
     _In_ const std::wstring &RootName,
+    _In_ const SIZE_T ThreadCount,
+    _Inout_ NameTable& Names,
     _Out_ RegistryKey& RegKey
 );
 
-/// @brief Create a .reg file from the internal representation of a registry key
-/// @param[in] RegKey Representation of the registry key
+/// @brief Create a .reg file from a view of a registry hive (binary) file
+/// @param[in] View View of the hive
+/// @param[in] RootName Path to the root key for export
+/// @param[in] SelectedKeys Patterns of the keys to export with their subkeys, or no pattern for exporting the whole hive
+/// @param[in] ExcludedKeys Patterns of the keys that are left out of the export with their subkeys
 /// @param[in] OutputFilePath Path of the desired output file
+/// @param[in] BufferSize Size in bytes of the buffer through which the file is written
+/// @param[in] ThreadCount Count of threads rendering the file
+/// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if no key is selected
+/// @note #OutputFilePath is overwritten if it already exists. Without patterns, the whole hive is exported, its
+///       subkeys and values in the order RegEnumKeyExW and RegEnumValueW would use.
+/// @note Keys and values are rendered straight from the mapped hive, without building a tree: memory use is about
+///       the size of the hive file and of the rendition buffers.
+/// @note Selected keys are exported under #RootName with their path from the hive root. Their parents are exported
+///       without their values, so that the file has a single root key and can be converted back to a hive.
+///       Only the keys on the way to them are visited, and excluded subtrees are never read.
+_Must_inspect_result_
+HRESULT HiveViewToRegfile
+(
+    _In_ const HiveView& View,
+    _In_ const std::wstring &RootName,
+    _In_ const KeyPathPatterns& SelectedKeys,
+    _In_ const KeyPathPatterns& ExcludedKeys,
+    _In_ const std::wstring &OutputFilePath,
+    _In_ const SIZE_T BufferSize,
+    _In_ const SIZE_T ThreadCount
+);
+
+/// @brief Render a key of a registry hive (binary) file, or one of its values, as in a .reg file
+/// @param[in] View View of the hive
+/// @param[in] RootName Path to the root key for export
+/// @param[in] KeyPath Path to the key relative to the hive root, with names separated by backslashes.
+///                    Empty for the hive root.
+/// @param[in] ValueName Name of the value to render (empty for the default value), or null for all the values of the key
+/// @param[in] Index Index of the hive, through which the key and the value are looked up, or null
+/// @param[out] Output Rendition: the path to the key followed by the values, without subkeys nor .reg preamble
+/// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no such key or value
+/// @note Without #Index, the key is looked up name by name with #HiveView::OpenKey, without enumerating siblings
+///       nor reading other keys: querying a few values costs a few cell reads whatever the size of the hive.
+///       With #Index, only the cells of the key and of the value are read.
+/// @note Lookups are case-insensitive: the key is named as stored in the hive, which may differ in case from #KeyPath.
+_Must_inspect_result_
+HRESULT HiveViewKeyToRegText
+(
+    _In_ const HiveView& View,
+    _In_ const std::wstring &RootName,
+    _In_ const std::wstring &KeyPath,
+    _In_opt_ const std::wstring* ValueName,
+    _In_opt_ const HiveIndex* Index,
+    _Out_ std::wstring& Output
+);
+
+/// @brief Convert the internal representation of a registry key to a flat tree
+/// @param[in] RegKey Representation of the registry key, which becomes the root key of #Tree
+/// @param[out] Tree Flat registry tree, with keys and values in the order of #RegKey
 /// @return HRESULT semantics
-/// @note #OutputFilePath is overwritten if it already exists
+/// @note The arrays and blobs of #Tree are measured first, then allocated once.
 _Must_inspect_result_
-HRESULT InternalToRegfile
+HRESULT InternalToFlat
 (
     _In_ const RegistryKey& RegKey,
+    _Out_ FlatRegistryTree& Tree
+);
+
+/// @brief Create a hive file from a flat registry tree
+/// @param[in] Tree Flat registry tree, whose first key is the root key of the hive
+/// @param[in] OutputFilePath Path of the desired output file
+/// @return HRESULT semantics
+/// @note #OutputFilePath is overwritten if it already exists
+/// @note The hive is serialized directly, in a single pass of sequential writes. No log file is created.
+/// @note Both passes of the writer are linear scans of the keys of #Tree, without recursion.
+_Must_inspect_result_
+HRESULT FlatToHive
+(
+    _In_ const FlatRegistryTree& Tree,
     _In_ const std::wstring &OutputFilePath
 );
 
@@ -63,6 +193,7 @@ HRESULT InternalToRegfile
 /// @param[in] OutputFilePath Path of the desired output file
 /// @return HRESULT semantics
 /// @note #OutputFilePath is overwritten if it already exists
+/// @note The key is converted with #InternalToFlat, then written with #FlatToHive.
 _Must_inspect_result_
 HRESULT InternalToHive
 (
@@ -72,11 +203,25 @@ HRESULT InternalToHive
 
 /// @brief Create an internal representation of a registry key from a registry .reg (text) file
 /// @param[in] RegFilePath Path to the registry .reg file
-/// @param[out] RegKey Internal structure
+/// @param[in] BufferSize Size in bytes of the window through which the file is read, when parsed by a single thread
+/// @param[in] ThreadCount Count of threads parsing the file
+/// @param[in,out] Names Table in which the names of keys and values are interned. Must outlive #RegKey.
+/// @param[out] RegKey Internal structure. The tree is built with its allocator, which must be thread-safe
+///                    when several threads parse the file.
 /// @return HRESULT semantics
+/// @note With a single thread, the file is streamed through a single window: memory usage does not depend on
+///       the file size. Strings and hexadecimal renditions may span several windows. The window only grows when
+///       a key path does not fit in it.
+/// @note With several threads, the file is mapped in memory and cut at blank lines before key paths into chunks
+///       that are parsed concurrently. The keys of each chunk are then attached to their parents by path.
+/// @note Subtrees are moved into #RegKey, never copied. Debug builds assert that taking over the parsed tree
+///       allocates nothing from a #MonotonicArena.
 _Must_inspect_result_
 HRESULT RegfileToInternal
 (
     _In_ const std::wstring& RegFilePath,
+    _In_ const SIZE_T BufferSize,
+    _In_ const SIZE_T ThreadCount,
+    _Inout_ NameTable& Names,
     _Out_ RegistryKey& RegKey
 );
\ No newline at end of file
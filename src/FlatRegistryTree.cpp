@@ -0,0 +1,74 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "FlatRegistryTree.h"
+#include <cstddef>
+
+// non-static function: documented in header.
+void FlatRegistryTree::Clear()
+{
+    Keys.clear();
+    Values.clear();
+    Names.clear();
+    Data.clear();
+}
+
+// non-static function: documented in header.
+void FlatRegistryTree::Reserve
+(
+    _In_ const SIZE_T KeyCount,
+    _In_ const SIZE_T ValueCount,
+    _In_ const SIZE_T NameLength,
+    _In_ const SIZE_T DataSize
+)
+{
+    Keys.reserve(KeyCount);
+    Values.reserve(ValueCount);
+    Names.reserve(NameLength);
+    Data.reserve(DataSize + ValueCount * (alignof(std::max_align_t) - 1));
+}
+
+// non-static function: documented in header.
+SIZE_T FlatRegistryTree::OpenKey
+(
+    _In_ const std::wstring_view Name,
+    _In_ const SIZE_T Parent
+)
+{
+    const SIZE_T KeyIndex = Keys.size();
+
+    Keys.push_back(FlatRegistryKey{ Names.length(), Name.length(), Parent, KeyIndex + 1, Values.size(), 0, Parent == SIZE_MAX ? 0 : Keys[Parent].Depth + 1 });
+    Names.append(Name);
+
+    return KeyIndex;
+}
+
+// non-static function: documented in header.
+void FlatRegistryTree::AppendValue
+(
+    _In_ const std::wstring_view Name,
+    _In_ const DWORD Type,
+    _In_ const BYTE* Bytes,
+    _In_ const SIZE_T DataSize
+)
+{
+    // data is read in place as strings or numbers: each value begins at an aligned offset of the blob
+    const SIZE_T DataOffset = (Data.size() + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+    Values.push_back(FlatRegistryValue{ Names.length(), Name.length(), Type, DataOffset, DataSize });
+    Names.append(Name);
+    Data.resize(DataOffset);
+    Data.insert(Data.end(), Bytes, Bytes + DataSize);
+
+    Keys.back().ValueCount += 1;
+}
+
+// non-static function: documented in header.
+void FlatRegistryTree::CloseKey
+(
+    _In_ const SIZE_T KeyIndex
+)
+{
+    Keys[KeyIndex].SubtreeEnd = Keys.size();
+}
@@ -0,0 +1,151 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Registry key of a #FlatRegistryTree
+struct FlatRegistryKey {
+    /// Offset of the name of the key in FlatRegistryTree::Names, in code units
+    SIZE_T NameOffset;
+
+    /// Length of the name of the key, in code units
+    SIZE_T NameLength;
+
+    /// Index of the parent key, or SIZE_MAX for the root key
+    SIZE_T Parent;
+
+    /// Index past the last key of the subtree of this key.
+    /// The first subkey, if any, immediately follows the key; each next subkey begins where the subtree of the previous one ends.
+    SIZE_T SubtreeEnd;
+
+    /// Index of the first value of the key in FlatRegistryTree::Values
+    SIZE_T FirstValue;
+
+    /// Count of values of the key, stored from #FirstValue on
+    SIZE_T ValueCount;
+
+    /// Depth of the key below the root key
+    SIZE_T Depth;
+};
+
+/// Registry value of a #FlatRegistryTree
+struct FlatRegistryValue {
+    /// Offset of the name of the value in FlatRegistryTree::Names, in code units
+    SIZE_T NameOffset;
+
+    /// Length of the name of the value, in code units
+    SIZE_T NameLength;
+
+    /// Type of the registry value
+    DWORD Type;
+
+    /// Offset of the data of the value in FlatRegistryTree::Data, aligned for any scalar type
+    SIZE_T DataOffset;
+
+    /// Size of the data of the value, in bytes
+    SIZE_T DataSize;
+};
+
+/// Representation of a registry tree as contiguous arrays, for stages that traverse whole trees.
+/// Keys are stored in depth-first order, so that any subtree is a range of keys, and values are stored in the order
+/// of their keys. Names and data of all keys and values are stored in two shared blobs.
+/// @note Keys are appended in depth-first order: a key is opened, then its values are appended, then its subkeys,
+///       and the key is closed.
+struct FlatRegistryTree {
+    /// @brief Remove all keys and values
+    void Clear();
+
+    /// @brief Allocate room for a tree of known size, so that appending to it does not reallocate
+    /// @param[in] KeyCount Count of keys
+    /// @param[in] ValueCount Count of values
+    /// @param[in] NameLength Total length of the names of keys and values, in code units
+    /// @param[in] DataSize Total size of the data of values, in bytes, without alignment
+    void Reserve
+    (
+        _In_ const SIZE_T KeyCount,
+        _In_ const SIZE_T ValueCount,
+        _In_ const SIZE_T NameLength,
+        _In_ const SIZE_T DataSize
+    );
+
+    /// @brief Open a key, after its parent and the preceding siblings and their subtrees
+    /// @param[in] Name Name of the key
+    /// @param[in] Parent Index of the parent key, which must be open, or SIZE_MAX for the root key
+    /// @return Index of the new key
+    SIZE_T OpenKey
+    (
+        _In_ const std::wstring_view Name,
+        _In_ const SIZE_T Parent
+    );
+
+    /// @brief Append a value to the last opened key, before its subkeys
+    /// @param[in] Name Name of the value
+    /// @param[in] Type Type of the value
+    /// @param[in] Bytes Data of the value
+    /// @param[in] DataSize Size of the data of the value, in bytes
+    void AppendValue
+    (
+        _In_ const std::wstring_view Name,
+        _In_ const DWORD Type,
+        _In_ const BYTE* Bytes,
+        _In_ const SIZE_T DataSize
+    );
+
+    /// @brief Close a key, after all its subkeys have been closed
+    /// @param[in] KeyIndex Index of the key
+    void CloseKey
+    (
+        _In_ const SIZE_T KeyIndex
+    );
+
+    /// @brief Get the name of a key
+    /// @param[in] KeyIndex Index of the key
+    /// @return Name of the key, valid until the tree is modified
+    std::wstring_view KeyName
+    (
+        _In_ const SIZE_T KeyIndex
+    ) const
+    {
+        return std::wstring_view{ Names.data() + Keys[KeyIndex].NameOffset, Keys[KeyIndex].NameLength };
+    }
+
+    /// @brief Get the name of a value
+    /// @param[in] ValueIndex Index of the value
+    /// @return Name of the value, valid until the tree is modified
+    std::wstring_view ValueName
+    (
+        _In_ const SIZE_T ValueIndex
+    ) const
+    {
+        return std::wstring_view{ Names.data() + Values[ValueIndex].NameOffset, Values[ValueIndex].NameLength };
+    }
+
+    /// @brief Get the data of a value
+    /// @param[in] ValueIndex Index of the value
+    /// @return Beginning of the data of the value, valid until the tree is modified
+    const BYTE* ValueData
+    (
+        _In_ const SIZE_T ValueIndex
+    ) const
+    {
+        return Data.data() + Values[ValueIndex].DataOffset;
+    }
+
+    /// Keys of the tree, in depth-first order. The root key, if any, comes first.
+    std::vector<FlatRegistryKey> Keys;
+
+    /// Values of the tree, in the order of their keys
+    std::vector<FlatRegistryValue> Values;
+
+    /// Names of all keys and values, without separators
+    std::wstring Names;
+
+    /// Data of all values
+    std::vector<BYTE> Data;
+};
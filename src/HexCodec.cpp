@@ -0,0 +1,314 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "HexCodec.h"
+#include "Constants.h"
+#include "StructuralScan.h"
+#include <algorithm>
+#include <cstdint>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define HEX_CODEC_SIMD
+#include <emmintrin.h>
+#endif
+
+/// Value of a code unit that is not a hexadecimal digit
+static const BYTE InvalidNibble = 0xFFu;
+
+/// Lower-case hexadecimal digits, as rendered by reg export
+static const WCHAR HexDigits[] = L"0123456789abcdef";
+
+/// Renditions of all byte values in a .reg file, followed by a separator
+struct HexByteTable {
+    /// Two digits and a separator for each byte value
+    WCHAR Renditions[256][3] {};
+
+    constexpr HexByteTable()
+    {
+        for (SIZE_T Value = 0; Value < 256; ++Value)
+        {
+            Renditions[Value][0] = HexDigits[Value >> 4];
+            Renditions[Value][1] = HexDigits[Value & 0xFu];
+            Renditions[Value][2] = Constants::RegFiles::HexByteSeparator;
+        }
+    }
+};
+
+/// Lookup table for #EncodeHexRendition
+static constexpr HexByteTable HexBytes {};
+
+/// @brief Get the value of a hexadecimal digit
+/// @param[in] CodeUnit Code unit to convert
+/// @return Value of the digit, or #InvalidNibble
+static BYTE HexDigitValue
+(
+    _In_ const WCHAR CodeUnit
+)
+{
+    if (CodeUnit >= L'0' && CodeUnit <= L'9')
+    {
+        return static_cast<BYTE>(CodeUnit - L'0');
+    }
+    if (CodeUnit >= L'a' && CodeUnit <= L'f')
+    {
+        return static_cast<BYTE>(CodeUnit - L'a' + 10);
+    }
+    if (CodeUnit >= L'A' && CodeUnit <= L'F')
+    {
+        return static_cast<BYTE>(CodeUnit - L'A' + 10);
+    }
+    return InvalidNibble;
+}
+
+// non-static function: documented in header.
+SIZE_T GetHexRenditionLength
+(
+    _In_ const std::wstring_view& Text
+)
+{
+    SIZE_T Position = 0;
+    while (true)
+    {
+        Position = FindStructuralChar(Text, Position, StructuralClasses::NewLines);
+        if (Position == Text.npos)
+        {
+            return Text.length();
+        }
+        if (Text[Position] == L'\r' && (Position == 0 || Text[Position - 1] != L'\\'))
+        {
+            return Position;
+        }
+        Position += 1;
+    }
+}
+
+#ifdef HEX_CODEC_SIMD
+
+/// Count of bytes decoded at once
+static const SIZE_T HexBlockByteCount = 8u;
+
+/// Count of code units in a block: two digits and a comma per byte
+static const SIZE_T HexBlockLength = 3u * HexBlockByteCount;
+
+/// @brief Convert 8 UTF-16 code units to the values of hexadecimal digits
+/// @param[in] Units Code units
+/// @param[out] DigitMask One bit per code unit, set for hexadecimal digits
+/// @param[out] CommaMask One bit per code unit, set for commas
+/// @return Values of the digits, one per 16-bit lane. Lanes of other code units are meaningless.
+static __m128i HexDigitValues
+(
+    _In_ const __m128i Units,
+    _Out_ uint32_t& DigitMask,
+    _Out_ uint32_t& CommaMask
+)
+{
+    // code units above 0x7FFF are negative here, and fail all range checks
+    const __m128i Lowered = _mm_or_si128(Units, _mm_set1_epi16(0x20));
+    const __m128i IsDecimal = _mm_and_si128(_mm_cmpgt_epi16(Units, _mm_set1_epi16(L'0' - 1)), _mm_cmplt_epi16(Units, _mm_set1_epi16(L'9' + 1)));
+    const __m128i IsLetter = _mm_and_si128(_mm_cmpgt_epi16(Lowered, _mm_set1_epi16(L'a' - 1)), _mm_cmplt_epi16(Lowered, _mm_set1_epi16(L'f' + 1)));
+    const __m128i IsComma = _mm_cmpeq_epi16(Units, _mm_set1_epi16(static_cast<short>(Constants::RegFiles::HexByteSeparator)));
+
+    // two mask bits per code unit: keep one
+    DigitMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(_mm_or_si128(IsDecimal, IsLetter), _mm_setzero_si128())));
+    CommaMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(IsComma, _mm_setzero_si128())));
+
+    const __m128i DecimalValues = _mm_and_si128(IsDecimal, _mm_sub_epi16(Units, _mm_set1_epi16(L'0')));
+    const __m128i LetterValues = _mm_and_si128(IsLetter, _mm_sub_epi16(Lowered, _mm_set1_epi16(L'a' - 10)));
+    return _mm_or_si128(DecimalValues, LetterValues);
+}
+
+/// @brief Decode a block of 8 comma-separated bytes
+/// @param[in] Units Code units of the block: #HexBlockLength code units
+/// @param[out] Block Decoded bytes
+/// @return true if the block is made of 8 pairs of digits, each followed by a comma
+static bool DecodeHexBlock
+(
+    _In_ const uint16_t* Units,
+    _Out_ BYTE (&Block)[HexBlockByteCount]
+)
+{
+    // digits at positions 3n and 3n+1, commas at positions 3n+2
+    static const uint32_t ExpectedDigitMask = 0x6DB6DBu;
+    static const uint32_t ExpectedCommaMask = 0x924924u;
+    uint32_t DigitMasks[3];
+    uint32_t CommaMasks[3];
+    BYTE Nibbles[HexBlockLength + 8];
+
+    for (SIZE_T Part = 0; Part < 3; ++Part)
+    {
+        const __m128i Units8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Units + 8 * Part));
+        const __m128i Values = HexDigitValues(Units8, DigitMasks[Part], CommaMasks[Part]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Nibbles + 8 * Part), _mm_packus_epi16(Values, _mm_setzero_si128()));
+    }
+
+    const uint32_t DigitMask = DigitMasks[0] | (DigitMasks[1] << 8) | (DigitMasks[2] << 16);
+    const uint32_t CommaMask = CommaMasks[0] | (CommaMasks[1] << 8) | (CommaMasks[2] << 16);
+    if (DigitMask != ExpectedDigitMask || CommaMask != ExpectedCommaMask)
+    {
+        return false;
+    }
+
+    for (SIZE_T ByteIndex = 0; ByteIndex < HexBlockByteCount; ++ByteIndex)
+    {
+        Block[ByteIndex] = static_cast<BYTE>((Nibbles[3 * ByteIndex] << 4) | Nibbles[3 * ByteIndex + 1]);
+    }
+    return true;
+}
+
+#endif
+
+// non-static function: documented in header.
+SIZE_T DecodeHexRendition
+(
+    _In_ const std::wstring_view& Text,
+    _Inout_ std::vector<BYTE>& Bytes
+)
+{
+    const SIZE_T Length = GetHexRenditionLength(Text);
+    SIZE_T Position = 0;
+
+    // at most one byte per three code units, save for renditions without commas
+    const SIZE_T ExpectedSize = Bytes.size() + (Length + 2) / 3;
+    if (ExpectedSize > Bytes.capacity())
+    {
+        // renditions spanning several windows keep a geometric growth
+        Bytes.reserve(std::max(ExpectedSize, 2 * Bytes.capacity()));
+    }
+
+    while (Position < Length)
+    {
+#ifdef HEX_CODEC_SIMD
+        if constexpr (sizeof(WCHAR) == sizeof(uint16_t))
+        {
+            const uint16_t* Units = reinterpret_cast<const uint16_t*>(Text.data());
+            BYTE Block[HexBlockByteCount];
+            bool BlockDecoded = false;
+            while (Position + HexBlockLength <= Length && DecodeHexBlock(Units + Position, Block))
+            {
+                Bytes.insert(Bytes.end(), Block, Block + HexBlockByteCount);
+                Position += HexBlockLength;
+                BlockDecoded = true;
+            }
+            if (BlockDecoded)
+            {
+                continue;
+            }
+        }
+#endif
+
+        const WCHAR CurrentChar = Text[Position];
+        if (CurrentChar == Constants::RegFiles::HexByteSeparator)
+        {
+            Position += 1;
+        }
+        else if (CurrentChar == Constants::RegFiles::HexByteNewLine[0])
+        {
+            const std::wstring_view Continuation = Text.substr(Position, Constants::RegFiles::HexByteNewLine.length());
+            if (Continuation != Constants::RegFiles::HexByteNewLine)
+            {
+                break;
+            }
+            SIZE_T NextPosition = Position + Continuation.length();
+            while (NextPosition < Text.length() && Text[NextPosition] == Constants::RegFiles::LeadingSpace)
+            {
+                NextPosition += 1;
+            }
+            if (NextPosition == Text.length())
+            {
+                // more leading spaces may follow: let the caller handle the continuation
+                break;
+            }
+            Position = NextPosition;
+        }
+        else if (Position + 1 < Length)
+        {
+            const BYTE HighNibble = HexDigitValue(CurrentChar);
+            const BYTE LowNibble = HexDigitValue(Text[Position + 1]);
+            if (HighNibble == InvalidNibble || LowNibble == InvalidNibble)
+            {
+                break;
+            }
+            Bytes.push_back(static_cast<BYTE>((HighNibble << 4) | LowNibble));
+            Position += 2;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return Position;
+}
+
+// non-static function: documented in header.
+void EncodeHexRendition
+(
+    _Inout_ std::wstring& Output,
+    _In_ const SIZE_T FirstLineSizeSoFar,
+    _In_ const DWORD Type,
+    _In_ const BYTE* Bytes,
+    _In_ const SIZE_T Size
+)
+{
+    // reg export breaks the line after the first separator that goes over 80 - 4 code units
+    const SIZE_T BreakThreshold = Constants::RegFiles::HexWrappingLimit - 4;
+    const SIZE_T LineBreakLength = Constants::RegFiles::HexByteNewLine.length() + Constants::RegFiles::HexNewLineLeadingSpaces;
+    const SIZE_T DeclarationStart = Output.length();
+    SIZE_T LineLength = 0;
+    SIZE_T Position = 0;
+
+    Output += Constants::RegFiles::HexPrefix;
+    if (Type != REG_BINARY)
+    {
+        WCHAR TypeDigits[2 * sizeof(DWORD)];
+        SIZE_T DigitCount = 0;
+        DWORD Remaining = Type;
+
+        do
+        {
+            TypeDigits[DigitCount++] = HexDigits[Remaining & 0xFu];
+            Remaining >>= 4;
+        } while (Remaining != 0);
+
+        Output += Constants::RegFiles::HexTypeSpecOpening;
+        while (DigitCount != 0)
+        {
+            Output += TypeDigits[--DigitCount];
+        }
+        Output += Constants::RegFiles::HexTypeSpecClosing;
+    }
+    Output += Constants::RegFiles::HexSuffix;
+
+    LineLength = FirstLineSizeSoFar + (Output.length() - DeclarationStart);
+    Output.reserve(Output.length() + Size * 3 + (Size / 16 + 1) * LineBreakLength);
+
+    while (Position < Size)
+    {
+        // each byte takes 3 code units with its separator, so the count of bytes on the line is known beforehand
+        const SIZE_T LineBytes = LineLength >= BreakThreshold ? 1 : (BreakThreshold - LineLength) / 3 + 1;
+        const bool LastLine = Size - Position <= LineBytes;
+        const SIZE_T Count = LastLine ? Size - Position : LineBytes;
+        const SIZE_T LineStart = Output.length();
+
+        Output.resize(LineStart + Count * 3);
+        WCHAR* Cursor = &Output[LineStart];
+        for (SIZE_T Index = 0; Index < Count; ++Index)
+        {
+            Cursor = std::copy_n(HexBytes.Renditions[Bytes[Position + Index]], 3, Cursor);
+        }
+
+        if (LastLine)
+        {
+            // no separator after the last byte, and no line break either
+            Output.pop_back();
+            break;
+        }
+
+        Output += Constants::RegFiles::HexByteNewLine;
+        Output.append(Constants::RegFiles::HexNewLineLeadingSpaces, Constants::RegFiles::LeadingSpace);
+
+        Position += LineBytes;
+        LineLength = Constants::RegFiles::HexNewLineLeadingSpaces;
+    }
+}
@@ -0,0 +1,52 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Find the extent of the hexadecimal or dword rendition of value data in a .reg file
+/// @param[in] Text Part of the rendition
+/// @return Position of the new line ending the rendition, or length of #Text if it is not in #Text
+/// @note New lines of continuations, preceded by a backslash, do not end the rendition.
+SIZE_T GetHexRenditionLength
+(
+    _In_ const std::wstring_view& Text
+);
+
+/// @brief Decode the hexadecimal rendition of value data in a .reg file, as far as possible
+/// @param[in] Text Part of the rendition after the hex: or hex(n): declaration
+/// @param[in,out] Bytes Decoded bytes. The bytes read from #Text are appended.
+/// @return Count of code units consumed from #Text
+/// @note Pairs of hexadecimal digits, commas and continuations (backslash, new line and leading spaces)
+///       are consumed. Decoding stops at the new line ending the rendition, at the first unexpected
+///       code unit, before an incomplete pair at the end of #Text, and before a continuation whose
+///       leading spaces reach the end of #Text.
+/// @note Blocks of 8 comma-separated bytes are decoded with SSE2 where available.
+SIZE_T DecodeHexRendition
+(
+    _In_ const std::wstring_view& Text,
+    _Inout_ std::vector<BYTE>& Bytes
+);
+
+/// @brief Render value data in hexadecimal in a .reg file
+/// @param[in,out] Output Rendition of the .reg file, to which the hex: or hex(n): declaration and the bytes are appended
+/// @param[in] FirstLineSizeSoFar Count of code units already on the line, before the declaration
+/// @param[in] Type Type of the value, declared in the rendition unless it is REG_BINARY
+/// @param[in] Bytes Value data
+/// @param[in] Size Count of bytes in #Bytes
+/// @note Lines are broken as reg export does, so that they do not go over Constants::RegFiles::HexWrappingLimit
+///       code units. The new line ending the rendition is not appended.
+/// @note Bytes are rendered from a lookup table, a whole line at once.
+void EncodeHexRendition
+(
+    _Inout_ std::wstring& Output,
+    _In_ const SIZE_T FirstLineSizeSoFar,
+    _In_ const DWORD Type,
+    _In_ const BYTE* Bytes,
+    _In_ const SIZE_T Size
+);
@@ -0,0 +1,867 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "HiveImage.h"
+#include "CommonFunctions.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+/// @brief Describe a cell for error messages
+/// @param[in] CellOffset Offset of the cell
+/// @return Human-readable description
+static std::wstring DescribeCell
+(
+    _In_ const DWORD CellOffset
+)
+{
+    std::wostringstream DescriptionStream;
+    DescriptionStream << L"Cell at offset 0x" << std::hex << std::setw(8) << std::setfill(L'0') << CellOffset;
+    return DescriptionStream.str();
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT OpenHiveImage
+(
+    _In_ const BYTE* Data,
+    _In_ const SIZE_T Size,
+    _Out_ HiveImage& Image
+)
+{
+    Image = HiveImage{};
+
+    if (Data == nullptr || Size < Regf::BaseBlock::Size)
+    {
+        ReportError(E_UNEXPECTED, L"Hive is smaller than its base block");
+        return E_UNEXPECTED;
+    }
+
+    if (Regf::ReadDword(Data + Regf::BaseBlock::SignatureOffset) != Regf::BaseBlock::Signature)
+    {
+        ReportError(E_UNEXPECTED, L"Hive does not begin with regf signature");
+        return E_UNEXPECTED;
+    }
+
+    if (Regf::ReadDword(Data + Regf::BaseBlock::ChecksumOffset) != Regf::BaseBlockChecksum(Data))
+    {
+        ReportError(E_UNEXPECTED, L"Hive base block checksum mismatch");
+        return E_UNEXPECTED;
+    }
+
+    if (Regf::ReadDword(Data + Regf::BaseBlock::MajorVersionOffset) != Regf::BaseBlock::MajorVersion)
+    {
+        std::wostringstream ErrorMessageStream;
+        ErrorMessageStream << L"Unsupported hive major version " << Regf::ReadDword(Data + Regf::BaseBlock::MajorVersionOffset);
+        ReportError(E_UNEXPECTED, ErrorMessageStream.str());
+        return E_UNEXPECTED;
+    }
+
+    if (Regf::ReadDword(Data + Regf::BaseBlock::FileTypeOffset) != Regf::BaseBlock::PrimaryFileType)
+    {
+        ReportError(E_UNEXPECTED, L"File is not a primary hive file");
+        return E_UNEXPECTED;
+    }
+
+    Image.Data = Data;
+    Image.Size = Size;
+    Image.MinorVersion = Regf::ReadDword(Data + Regf::BaseBlock::MinorVersionOffset);
+    Image.RootCellOffset = Regf::ReadDword(Data + Regf::BaseBlock::RootCellOffset);
+    Image.BinsDataSize = std::min<SIZE_T>(Regf::ReadDword(Data + Regf::BaseBlock::BinsDataSizeOffset), Size - Regf::BaseBlock::Size);
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT GetHiveCell
+(
+    _In_ const HiveImage& Image,
+    _In_ const DWORD CellOffset,
+    _Out_ const BYTE*& CellData,
+    _Out_ SIZE_T& CellDataSize
+)
+{
+    CellData = nullptr;
+    CellDataSize = 0;
+
+    if (CellOffset % Regf::Cell::Alignment != 0 || CellOffset >= Image.BinsDataSize ||
+        Image.BinsDataSize - CellOffset < Regf::Cell::Alignment)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Offset out of hive bins");
+        return E_UNEXPECTED;
+    }
+
+    const BYTE* Cell = Image.Data + Regf::BaseBlock::Size + CellOffset;
+    const LONG RawSize = static_cast<LONG>(Regf::ReadDword(Cell));
+    if (RawSize >= 0)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Cell is not allocated");
+        return E_UNEXPECTED;
+    }
+
+    const SIZE_T CellSize = static_cast<SIZE_T>(-static_cast<int64_t>(RawSize));
+    if (CellSize < Regf::Cell::HeaderSize || CellSize > Image.BinsDataSize - CellOffset)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Cell size out of hive bins");
+        return E_UNEXPECTED;
+    }
+
+    CellData = Cell + Regf::Cell::HeaderSize;
+    CellDataSize = CellSize - Regf::Cell::HeaderSize;
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT GetKeyNode
+(
+    _In_ const HiveImage& Image,
+    _In_ const DWORD CellOffset,
+    _Out_ HiveKeyNode& Node
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* Cell = nullptr;
+    SIZE_T CellSize = 0;
+
+    Node = HiveKeyNode{};
+
+    Result = GetHiveCell(Image, CellOffset, Cell, CellSize);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    if (CellSize < Regf::KeyNode::NameOffset || Regf::ReadWord(Cell) != Regf::Cell::KeyNodeSignature)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Not a key node");
+        return E_UNEXPECTED;
+    }
+
+    Node.CellOffset = CellOffset;
+    Node.Flags = Regf::ReadWord(Cell + Regf::KeyNode::FlagsOffset);
+    Node.SubkeyCount = Regf::ReadDword(Cell + Regf::KeyNode::SubkeyCountOffset);
+    Node.SubkeyListOffset = Regf::ReadDword(Cell + Regf::KeyNode::SubkeyListOffset);
+    Node.ValueCount = Regf::ReadDword(Cell + Regf::KeyNode::ValueCountOffset);
+    Node.ValueListOffset = Regf::ReadDword(Cell + Regf::KeyNode::ValueListOffset);
+    Node.SecurityOffset = Regf::ReadDword(Cell + Regf::KeyNode::SecurityOffset);
+    Node.NameLength = Regf::ReadWord(Cell + Regf::KeyNode::NameLengthOffset);
+    Node.Name = Cell + Regf::KeyNode::NameOffset;
+
+    if (Node.NameLength > CellSize - Regf::KeyNode::NameOffset)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Key name exceeds cell");
+        return E_UNEXPECTED;
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT GetValueNode
+(
+    _In_ const HiveImage& Image,
+    _In_ const DWORD CellOffset,
+    _Out_ HiveValueNode& Node
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* Cell = nullptr;
+    SIZE_T CellSize = 0;
+
+    Node = HiveValueNode{};
+
+    Result = GetHiveCell(Image, CellOffset, Cell, CellSize);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    if (CellSize < Regf::Value::NameOffset || Regf::ReadWord(Cell) != Regf::Cell::ValueSignature)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Not a value");
+        return E_UNEXPECTED;
+    }
+
+    const DWORD RawDataSize = Regf::ReadDword(Cell + Regf::Value::DataSizeOffset);
+
+    Node.CellOffset = CellOffset;
+    Node.Flags = Regf::ReadWord(Cell + Regf::Value::FlagsOffset);
+    Node.Type = Regf::ReadDword(Cell + Regf::Value::TypeOffset);
+    Node.DataSize = RawDataSize & ~Regf::Value::InlineDataFlag;
+    Node.HasInlineData = (RawDataSize & Regf::Value::InlineDataFlag) != 0;
+    Node.NameLength = Regf::ReadWord(Cell + Regf::Value::NameLengthOffset);
+    Node.Name = Cell + Regf::Value::NameOffset;
+
+    if (Node.HasInlineData)
+    {
+        Node.InlineData = Cell + Regf::Value::DataOffset;
+        if (Node.DataSize > Regf::Value::InlineDataMaximalSize)
+        {
+            ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Inline data larger than 4 bytes");
+            return E_UNEXPECTED;
+        }
+    }
+    else
+    {
+        Node.DataOffset = Regf::ReadDword(Cell + Regf::Value::DataOffset);
+    }
+
+    if (Node.NameLength > CellSize - Regf::Value::NameOffset)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Value name exceeds cell");
+        return E_UNEXPECTED;
+    }
+
+    return S_OK;
+}
+
+/// @brief Check a subkey list leaf (li, lf or lh) and get the layout of its elements
+/// @param[in] Cell Beginning of the leaf cell data
+/// @param[in] CellSize Size of the leaf cell data
+/// @param[in] CellOffset Offset of the leaf cell, for error messages
+/// @param[out] ElementSize Size of an element of the leaf
+/// @param[out] Count Count of elements of the leaf
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT GetLeafElements
+(
+    _In_ const BYTE* Cell,
+    _In_ const SIZE_T CellSize,
+    _In_ const DWORD CellOffset,
+    _Out_ SIZE_T& ElementSize,
+    _Out_ WORD& Count
+)
+{
+    const WORD Signature = Regf::ReadWord(Cell);
+
+    Count = Regf::ReadWord(Cell + Regf::SubkeyList::CountOffset);
+    ElementSize = 0;
+
+    if (Signature == Regf::Cell::IndexLeafSignature)
+    {
+        ElementSize = Regf::SubkeyList::IndexElementSize;
+    }
+    else if (Signature == Regf::Cell::FastLeafSignature || Signature == Regf::Cell::HashLeafSignature)
+    {
+        ElementSize = Regf::SubkeyList::HashElementSize;
+    }
+    else
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Not a subkey list leaf");
+        return E_UNEXPECTED;
+    }
+
+    if (Count * ElementSize > CellSize - Regf::SubkeyList::ElementsOffset)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(CellOffset) + L" - Subkey list exceeds cell");
+        return E_UNEXPECTED;
+    }
+
+    return S_OK;
+}
+
+/// @brief Append the offsets found in a subkey list leaf (li, lf or lh)
+/// @param[in] Cell Beginning of the leaf cell data
+/// @param[in] CellSize Size of the leaf cell data
+/// @param[in] CellOffset Offset of the leaf cell, for error messages
+/// @param[in,out] SubkeyOffsets Container for the offsets
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT AppendLeafOffsets
+(
+    _In_ const BYTE* Cell,
+    _In_ const SIZE_T CellSize,
+    _In_ const DWORD CellOffset,
+    _Inout_ std::vector<DWORD>& SubkeyOffsets
+)
+{
+    HRESULT Result = E_FAIL;
+    SIZE_T ElementSize = 0;
+    WORD Count = 0;
+
+    Result = GetLeafElements(Cell, CellSize, CellOffset, ElementSize, Count);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    const BYTE* Element = Cell + Regf::SubkeyList::ElementsOffset;
+    for (WORD Index = 0; Index < Count; ++Index, Element += ElementSize)
+    {
+        SubkeyOffsets.push_back(Regf::ReadDword(Element));
+    }
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT GetSubkeyOffsets
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _Out_ std::vector<DWORD>& SubkeyOffsets
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* Cell = nullptr;
+    SIZE_T CellSize = 0;
+
+    SubkeyOffsets.clear();
+
+    if (Node.SubkeyCount == 0)
+    {
+        return S_OK;
+    }
+
+    Result = GetHiveCell(Image, Node.SubkeyListOffset, Cell, CellSize);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    if (CellSize < Regf::SubkeyList::ElementsOffset)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(Node.SubkeyListOffset) + L" - Subkey list too small");
+        return E_UNEXPECTED;
+    }
+
+    SubkeyOffsets.reserve(std::min<SIZE_T>(Node.SubkeyCount, CellSize));
+
+    if (Regf::ReadWord(Cell) == Regf::Cell::IndexRootSignature)
+    {
+        const WORD LeafCount = Regf::ReadWord(Cell + Regf::SubkeyList::CountOffset);
+        if (LeafCount * Regf::SubkeyList::IndexElementSize > CellSize - Regf::SubkeyList::ElementsOffset)
+        {
+            ReportError(E_UNEXPECTED, DescribeCell(Node.SubkeyListOffset) + L" - Index root exceeds cell");
+            return E_UNEXPECTED;
+        }
+
+        for (WORD LeafIndex = 0; LeafIndex < LeafCount; ++LeafIndex)
+        {
+            const DWORD LeafOffset = Regf::ReadDword(Cell + Regf::SubkeyList::ElementsOffset + LeafIndex * Regf::SubkeyList::IndexElementSize);
+            const BYTE* Leaf = nullptr;
+            SIZE_T LeafSize = 0;
+
+            Result = GetHiveCell(Image, LeafOffset, Leaf, LeafSize);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            if (LeafSize < Regf::SubkeyList::ElementsOffset)
+            {
+                ReportError(E_UNEXPECTED, DescribeCell(LeafOffset) + L" - Subkey list too small");
+                return E_UNEXPECTED;
+            }
+
+            Result = AppendLeafOffsets(Leaf, LeafSize, LeafOffset, SubkeyOffsets);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+        }
+    }
+    else
+    {
+        Result = AppendLeafOffsets(Cell, CellSize, Node.SubkeyListOffset, SubkeyOffsets);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+    }
+
+    if (SubkeyOffsets.size() != Node.SubkeyCount)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(Node.CellOffset) + L" - Subkey count does not match subkey list");
+        return E_UNEXPECTED;
+    }
+
+    return S_OK;
+}
+
+/// @brief Compare the name of a key with a name, in the order used for sorting subkey lists
+/// @param[in] Image Accessor over the image
+/// @param[in] CellOffset Offset of the key node cell
+/// @param[in] Name Name to compare with
+/// @param[in,out] NameBuffer Buffer for decoding the name of the key
+/// @param[out] Node Key node
+/// @param[out] Comparison Negative, zero or positive value when the name of the key sorts before, with or after #Name
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT CompareSubkeyName
+(
+    _In_ const HiveImage& Image,
+    _In_ const DWORD CellOffset,
+    _In_ const std::wstring_view Name,
+    _Inout_ std::wstring& NameBuffer,
+    _Out_ HiveKeyNode& Node,
+    _Out_ int& Comparison
+)
+{
+    HRESULT Result = E_FAIL;
+
+    Comparison = 0;
+
+    Result = GetKeyNode(Image, CellOffset, Node);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    Regf::DecodeName(Node.Name, Node.NameLength, Node.HasCompressedName(), NameBuffer);
+    Comparison = Regf::CompareNames(NameBuffer, Name);
+    return S_OK;
+}
+
+/// @brief Look for a key in a subkey list leaf (li, lf or lh)
+/// @param[in] Image Accessor over the image
+/// @param[in] Cell Beginning of the leaf cell data
+/// @param[in] CellSize Size of the leaf cell data
+/// @param[in] CellOffset Offset of the leaf cell, for error messages
+/// @param[in] Name Name of the key
+/// @param[in] Hash Hash of #Name, as stored in lh leaves
+/// @param[in,out] NameBuffer Buffer for decoding names
+/// @param[out] Subkey Key node of the key, when found
+/// @param[out] Found Whether the key was found
+/// @return HRESULT semantics
+/// @note The hashes of lh leaves are probed, so that only the keys with the same hash are read. When no hash
+///       matches, all the names of the leaf are compared. Other leaves are searched by halves, as they are sorted
+///       by name.
+_Must_inspect_result_
+static HRESULT FindInLeaf
+(
+    _In_ const HiveImage& Image,
+    _In_ const BYTE* Cell,
+    _In_ const SIZE_T CellSize,
+    _In_ const DWORD CellOffset,
+    _In_ const std::wstring_view Name,
+    _In_ const DWORD Hash,
+    _Inout_ std::wstring& NameBuffer,
+    _Out_ HiveKeyNode& Subkey,
+    _Out_ bool& Found
+)
+{
+    HRESULT Result = E_FAIL;
+    SIZE_T ElementSize = 0;
+    WORD Count = 0;
+    int Comparison = 0;
+
+    Found = false;
+
+    Result = GetLeafElements(Cell, CellSize, CellOffset, ElementSize, Count);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    const BYTE* Elements = Cell + Regf::SubkeyList::ElementsOffset;
+
+    if (Regf::ReadWord(Cell) == Regf::Cell::HashLeafSignature)
+    {
+        bool HashFound = false;
+        for (WORD Index = 0; Index < Count; ++Index)
+        {
+            const BYTE* Element = Elements + Index * ElementSize;
+            if (Regf::ReadDword(Element + sizeof(DWORD)) != Hash)
+            {
+                continue;
+            }
+
+            HashFound = true;
+            Result = CompareSubkeyName(Image, Regf::ReadDword(Element), Name, NameBuffer, Subkey, Comparison);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            if (Comparison == 0)
+            {
+                Found = true;
+                return S_OK;
+            }
+        }
+        if (HashFound)
+        {
+            return S_OK;
+        }
+
+        // the hive may have been written with other casing rules than ours: compare all names before giving up
+        for (WORD Index = 0; Index < Count; ++Index)
+        {
+            Result = CompareSubkeyName(Image, Regf::ReadDword(Elements + Index * ElementSize), Name, NameBuffer, Subkey, Comparison);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            if (Comparison == 0)
+            {
+                Found = true;
+                return S_OK;
+            }
+        }
+        return S_OK;
+    }
+
+    SIZE_T Begin = 0;
+    SIZE_T End = Count;
+    while (Begin < End)
+    {
+        const SIZE_T Middle = Begin + (End - Begin) / 2;
+
+        Result = CompareSubkeyName(Image, Regf::ReadDword(Elements + Middle * ElementSize), Name, NameBuffer, Subkey, Comparison);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+        if (Comparison == 0)
+        {
+            Found = true;
+            return S_OK;
+        }
+        if (Comparison < 0)
+        {
+            Begin = Middle + 1;
+        }
+        else
+        {
+            End = Middle;
+        }
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT FindSubkey
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const std::wstring_view Name,
+    _Out_ HiveKeyNode& Subkey
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* Cell = nullptr;
+    SIZE_T CellSize = 0;
+    std::vector<BYTE> EncodedName;
+    std::wstring NameBuffer;
+    bool Found = false;
+
+    Subkey = HiveKeyNode{};
+
+    if (Node.SubkeyCount == 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    const bool CompressedName = Regf::EncodeName(Name, EncodedName);
+    const DWORD Hash = Regf::NameHash(EncodedName.data(), EncodedName.size(), CompressedName);
+
+    Result = GetHiveCell(Image, Node.SubkeyListOffset, Cell, CellSize);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    if (CellSize < Regf::SubkeyList::ElementsOffset)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(Node.SubkeyListOffset) + L" - Subkey list too small");
+        return E_UNEXPECTED;
+    }
+
+    if (Regf::ReadWord(Cell) == Regf::Cell::IndexRootSignature)
+    {
+        const WORD LeafCount = Regf::ReadWord(Cell + Regf::SubkeyList::CountOffset);
+        if (LeafCount * Regf::SubkeyList::IndexElementSize > CellSize - Regf::SubkeyList::ElementsOffset)
+        {
+            ReportError(E_UNEXPECTED, DescribeCell(Node.SubkeyListOffset) + L" - Index root exceeds cell");
+            return E_UNEXPECTED;
+        }
+
+        // leaves are searched by halves by their last key, then the first leaf that may hold the name is searched
+        SIZE_T Begin = 0;
+        SIZE_T End = LeafCount;
+        while (Begin < End)
+        {
+            const SIZE_T Middle = Begin + (End - Begin) / 2;
+            const DWORD LeafOffset = Regf::ReadDword(Cell + Regf::SubkeyList::ElementsOffset + Middle * Regf::SubkeyList::IndexElementSize);
+            const BYTE* Leaf = nullptr;
+            SIZE_T LeafSize = 0;
+            SIZE_T ElementSize = 0;
+            WORD Count = 0;
+            int Comparison = 0;
+
+            Result = GetHiveCell(Image, LeafOffset, Leaf, LeafSize);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            if (LeafSize < Regf::SubkeyList::ElementsOffset)
+            {
+                ReportError(E_UNEXPECTED, DescribeCell(LeafOffset) + L" - Subkey list too small");
+                return E_UNEXPECTED;
+            }
+
+            Result = GetLeafElements(Leaf, LeafSize, LeafOffset, ElementSize, Count);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            if (Count == 0)
+            {
+                ReportError(E_UNEXPECTED, DescribeCell(LeafOffset) + L" - Empty subkey list leaf");
+                return E_UNEXPECTED;
+            }
+
+            const DWORD LastOffset = Regf::ReadDword(Leaf + Regf::SubkeyList::ElementsOffset + (Count - 1) * ElementSize);
+            Result = CompareSubkeyName(Image, LastOffset, Name, NameBuffer, Subkey, Comparison);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            if (Comparison < 0)
+            {
+                Begin = Middle + 1;
+            }
+            else
+            {
+                End = Middle;
+            }
+        }
+
+        if (Begin < LeafCount)
+        {
+            const DWORD LeafOffset = Regf::ReadDword(Cell + Regf::SubkeyList::ElementsOffset + Begin * Regf::SubkeyList::IndexElementSize);
+            const BYTE* Leaf = nullptr;
+            SIZE_T LeafSize = 0;
+
+            Result = GetHiveCell(Image, LeafOffset, Leaf, LeafSize);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+
+            Result = FindInLeaf(Image, Leaf, LeafSize, LeafOffset, Name, Hash, NameBuffer, Subkey, Found);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+        }
+    }
+    else
+    {
+        Result = FindInLeaf(Image, Cell, CellSize, Node.SubkeyListOffset, Name, Hash, NameBuffer, Subkey, Found);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+    }
+
+    if (!Found)
+    {
+        Subkey = HiveKeyNode{};
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT FindValue
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const std::wstring_view Name,
+    _Out_ HiveValueNode& Value
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* ValueList = nullptr;
+    std::wstring NameBuffer;
+
+    Value = HiveValueNode{};
+
+    Result = GetValueList(Image, Node, ValueList);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    for (DWORD ValueIndex = 0; ValueIndex < Node.ValueCount; ++ValueIndex)
+    {
+        Result = GetValueNode(Image, Regf::ReadDword(ValueList + ValueIndex * sizeof(DWORD)), Value);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+
+        Regf::DecodeName(Value.Name, Value.NameLength, Value.HasCompressedName(), NameBuffer);
+        if (Regf::CompareNames(NameBuffer, Name) == 0)
+        {
+            return S_OK;
+        }
+    }
+
+    Value = HiveValueNode{};
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT GetValueList
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _Out_ const BYTE*& ValueList
+)
+{
+    HRESULT Result = E_FAIL;
+    SIZE_T CellSize = 0;
+
+    ValueList = nullptr;
+
+    if (Node.ValueCount == 0)
+    {
+        return S_OK;
+    }
+
+    Result = GetHiveCell(Image, Node.ValueListOffset, ValueList, CellSize);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    if (Node.ValueCount > CellSize / sizeof(DWORD))
+    {
+        ValueList = nullptr;
+        ReportError(E_UNEXPECTED, DescribeCell(Node.ValueListOffset) + L" - Value count exceeds value list");
+        return E_UNEXPECTED;
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT GetValueDataView
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveValueNode& Node,
+    _Out_ const BYTE*& Data,
+    _Inout_ ValueData& Scratch
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* Cell = nullptr;
+    SIZE_T CellSize = 0;
+
+    Data = nullptr;
+
+    if (Node.HasInlineData)
+    {
+        Data = Node.InlineData;
+        return S_OK;
+    }
+
+    if (Node.DataSize == 0)
+    {
+        return S_OK;
+    }
+
+    Result = GetHiveCell(Image, Node.DataOffset, Cell, CellSize);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    if (Node.DataSize > Regf::BigData::SegmentSize && Image.MinorVersion >= Regf::BaseBlock::BigDataMinorVersion)
+    {
+        if (CellSize < Regf::BigData::SegmentListOffset + sizeof(DWORD) || Regf::ReadWord(Cell) != Regf::Cell::BigDataSignature)
+        {
+            ReportError(E_UNEXPECTED, DescribeCell(Node.DataOffset) + L" - Not a big data cell");
+            return E_UNEXPECTED;
+        }
+
+        const WORD SegmentCount = Regf::ReadWord(Cell + Regf::BigData::SegmentCountOffset);
+        const DWORD SegmentListOffset = Regf::ReadDword(Cell + Regf::BigData::SegmentListOffset);
+        const BYTE* SegmentList = nullptr;
+        SIZE_T SegmentListSize = 0;
+
+        Result = GetHiveCell(Image, SegmentListOffset, SegmentList, SegmentListSize);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+        if (SegmentCount > SegmentListSize / sizeof(DWORD))
+        {
+            ReportError(E_UNEXPECTED, DescribeCell(SegmentListOffset) + L" - Segment count exceeds segment list");
+            return E_UNEXPECTED;
+        }
+
+        Scratch.clear();
+        Scratch.reserve(std::min<SIZE_T>(Node.DataSize, static_cast<SIZE_T>(SegmentCount) * Regf::BigData::SegmentSize));
+        for (WORD SegmentIndex = 0; SegmentIndex < SegmentCount && Scratch.size() < Node.DataSize; ++SegmentIndex)
+        {
+            const DWORD SegmentOffset = Regf::ReadDword(SegmentList + SegmentIndex * sizeof(DWORD));
+            const BYTE* Segment = nullptr;
+            SIZE_T SegmentSize = 0;
+
+            Result = GetHiveCell(Image, SegmentOffset, Segment, SegmentSize);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+
+            const SIZE_T ChunkSize = std::min<SIZE_T>({ SegmentSize, Regf::BigData::SegmentSize, Node.DataSize - Scratch.size() });
+            Scratch.append(Segment, ChunkSize);
+        }
+
+        if (Scratch.size() != Node.DataSize)
+        {
+            ReportError(E_UNEXPECTED, DescribeCell(Node.DataOffset) + L" - Big data segments shorter than value size");
+            return E_UNEXPECTED;
+        }
+        Data = Scratch.data();
+        return S_OK;
+    }
+
+    if (Node.DataSize > CellSize)
+    {
+        ReportError(E_UNEXPECTED, DescribeCell(Node.DataOffset) + L" - Value size exceeds data cell");
+        return E_UNEXPECTED;
+    }
+
+    Data = Cell;
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT GetValueData
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveValueNode& Node,
+    _Out_ ValueData& Data
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* View = nullptr;
+
+    Result = GetValueDataView(Image, Node, View, Data);
+    if (FAILED(Result))
+    {
+        Data.clear();
+        return Result;
+    }
+
+    // big data is already concatenated into the buffer
+    if (View != Data.data())
+    {
+        Data.assign(View, Node.DataSize);
+    }
+    return S_OK;
+}
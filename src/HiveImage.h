@@ -0,0 +1,242 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include "RegfFormat.h"
+#include "ValueData.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Read-only accessor over a regf image held in memory (typically a mapped hive file)
+struct HiveImage {
+    /// Beginning of the image, i.e. of the base block
+    const BYTE* Data = nullptr;
+
+    /// Size of the image in bytes
+    SIZE_T Size = 0;
+
+    /// Size of the hive bins data, as declared by the base block and clipped to the image
+    SIZE_T BinsDataSize = 0;
+
+    /// Minor version of the hive format
+    DWORD MinorVersion = 0;
+
+    /// Offset of the root key node cell
+    DWORD RootCellOffset = Regf::Cell::NullOffset;
+};
+
+/// Decoded fields of a key node (nk) cell
+struct HiveKeyNode {
+    /// Offset of the cell
+    DWORD CellOffset = Regf::Cell::NullOffset;
+
+    /// Key flags (Regf::KeyNode::*Flag)
+    WORD Flags = 0;
+
+    /// Number of stable subkeys
+    DWORD SubkeyCount = 0;
+
+    /// Offset of the stable subkey list
+    DWORD SubkeyListOffset = Regf::Cell::NullOffset;
+
+    /// Number of values
+    DWORD ValueCount = 0;
+
+    /// Offset of the value list
+    DWORD ValueListOffset = Regf::Cell::NullOffset;
+
+    /// Offset of the security (sk) cell
+    DWORD SecurityOffset = Regf::Cell::NullOffset;
+
+    /// Name as stored in the cell (Latin-1 or UTF-16LE)
+    const BYTE* Name = nullptr;
+
+    /// Length of #Name in bytes
+    WORD NameLength = 0;
+
+    /// @brief Whether #Name is stored as Latin-1
+    bool HasCompressedName() const { return (Flags & Regf::KeyNode::CompressedNameFlag) != 0; }
+};
+
+/// Decoded fields of a value (vk) cell
+struct HiveValueNode {
+    /// Offset of the cell
+    DWORD CellOffset = Regf::Cell::NullOffset;
+
+    /// Value flags (Regf::Value::*Flag)
+    WORD Flags = 0;
+
+    /// Type of the registry value
+    DWORD Type = 0;
+
+    /// Size of the data in bytes, without Regf::Value::InlineDataFlag
+    DWORD DataSize = 0;
+
+    /// Whether the data is stored in the cell itself, at #InlineData
+    bool HasInlineData = false;
+
+    /// Location of the data when #HasInlineData is set
+    const BYTE* InlineData = nullptr;
+
+    /// Offset of the data cell (or big data cell) when #HasInlineData is not set
+    DWORD DataOffset = Regf::Cell::NullOffset;
+
+    /// Name as stored in the cell (Latin-1 or UTF-16LE). Empty for the default value.
+    const BYTE* Name = nullptr;
+
+    /// Length of #Name in bytes
+    WORD NameLength = 0;
+
+    /// @brief Whether #Name is stored as Latin-1
+    bool HasCompressedName() const { return (Flags & Regf::Value::CompressedNameFlag) != 0; }
+};
+
+/// @brief Validate the base block of a regf image and fill an accessor over it
+/// @param[in] Data Beginning of the image
+/// @param[in] Size Size of the image in bytes
+/// @param[out] Image Accessor over the image
+/// @return HRESULT semantics
+_Must_inspect_result_
+HRESULT OpenHiveImage
+(
+    _In_ const BYTE* Data,
+    _In_ const SIZE_T Size,
+    _Out_ HiveImage& Image
+);
+
+/// @brief Locate an allocated cell in a regf image
+/// @param[in] Image Accessor over the image
+/// @param[in] CellOffset Offset of the cell, relative to the hive bins data
+/// @param[out] CellData Beginning of the cell data, after the cell size
+/// @param[out] CellDataSize Size of the cell data in bytes
+/// @return HRESULT semantics
+_Must_inspect_result_
+HRESULT GetHiveCell
+(
+    _In_ const HiveImage& Image,
+    _In_ const DWORD CellOffset,
+    _Out_ const BYTE*& CellData,
+    _Out_ SIZE_T& CellDataSize
+);
+
+/// @brief Decode a key node (nk) cell
+/// @param[in] Image Accessor over the image
+/// @param[in] CellOffset Offset of the cell
+/// @param[out] Node Decoded fields
+/// @return HRESULT semantics
+_Must_inspect_result_
+HRESULT GetKeyNode
+(
+    _In_ const HiveImage& Image,
+    _In_ const DWORD CellOffset,
+    _Out_ HiveKeyNode& Node
+);
+
+/// @brief Decode a value (vk) cell
+/// @param[in] Image Accessor over the image
+/// @param[in] CellOffset Offset of the cell
+/// @param[out] Node Decoded fields
+/// @return HRESULT semantics
+_Must_inspect_result_
+HRESULT GetValueNode
+(
+    _In_ const HiveImage& Image,
+    _In_ const DWORD CellOffset,
+    _Out_ HiveValueNode& Node
+);
+
+/// @brief Collect the offsets of the stable subkeys of a key, in subkey list order
+/// @param[in] Image Accessor over the image
+/// @param[in] Node Key node
+/// @param[out] SubkeyOffsets Offsets of the key node cells of the subkeys
+/// @return HRESULT semantics
+/// @note Index roots (ri) are flattened.
+_Must_inspect_result_
+HRESULT GetSubkeyOffsets
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _Out_ std::vector<DWORD>& SubkeyOffsets
+);
+
+/// @brief Look up a subkey of a key by name, without enumerating its siblings
+/// @param[in] Image Accessor over the image
+/// @param[in] Node Key node
+/// @param[in] Name Name of the subkey, compared case-insensitively
+/// @param[out] Subkey Key node of the subkey
+/// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no such subkey
+/// @note Index roots are searched by halves. The hashes of lh leaves are probed, and li and lf leaves are searched
+///       by halves, as subkey lists are sorted by uppercase name: only a handful of key nodes are read.
+///       When no hash of an lh leaf matches, all the names of the leaf are compared, in case the hive was written
+///       with other casing rules.
+_Must_inspect_result_
+HRESULT FindSubkey
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const std::wstring_view Name,
+    _Out_ HiveKeyNode& Subkey
+);
+
+/// @brief Look up a value of a key by name
+/// @param[in] Image Accessor over the image
+/// @param[in] Node Key node
+/// @param[in] Name Name of the value, compared case-insensitively. Empty for the default value.
+/// @param[out] Value Value node
+/// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no such value
+/// @note Value lists are not sorted: the values of the key are read until the name is found.
+_Must_inspect_result_
+HRESULT FindValue
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const std::wstring_view Name,
+    _Out_ HiveValueNode& Value
+);
+
+/// @brief Locate the value list of a key
+/// @param[in] Image Accessor over the image
+/// @param[in] Node Key node
+/// @param[out] ValueList Beginning of the array of Node.ValueCount value cell offsets, null if there is no value
+/// @return HRESULT semantics
+_Must_inspect_result_
+HRESULT GetValueList
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _Out_ const BYTE*& ValueList
+);
+
+/// @brief Locate the data of a value, following data cells and big data segments
+/// @param[in] Image Accessor over the image
+/// @param[in] Node Value node
+/// @param[out] Data Beginning of the Node.DataSize bytes of the value, null if there are none
+/// @param[in,out] Scratch Buffer into which big data segments are concatenated, kept across calls to spare allocations
+/// @return HRESULT semantics
+/// @note Data stored in the value cell or in a single data cell is not copied: #Data points into the image.
+///       Only big data, split into segments, is copied into #Scratch.
+_Must_inspect_result_
+HRESULT GetValueDataView
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveValueNode& Node,
+    _Out_ const BYTE*& Data,
+    _Inout_ ValueData& Scratch
+);
+
+/// @brief Read the data of a value, following data cells and big data segments
+/// @param[in] Image Accessor over the image
+/// @param[in] Node Value node
+/// @param[out] Data Contents of the value
+/// @return HRESULT semantics
+_Must_inspect_result_
+HRESULT GetValueData
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveValueNode& Node,
+    _Out_ ValueData& Data
+);
@@ -0,0 +1,611 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "HiveIndex.h"
+#include "CommonFunctions.h"
+#include "Constants.h"
+#include "OutputFile.h"
+#include "RegfFormat.h"
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+/// Layout of index files.
+/// A header is followed by the key table, the value table and the strings. Keys are sorted by path, name by name,
+/// so that the keys below a key follow it; the values of a key are contiguous, and sorted by name.
+/// Strings are stored as key and value names are in hives: in Latin-1 when possible, in UTF-16LE otherwise.
+namespace IndexFile {
+    /// Signature at the beginning of index files ("hsix")
+    static const DWORD Signature = 0x78697368u;
+
+    /// Version of the layout
+    static const DWORD Version = 1u;
+
+    /// Header, binding the index to the base block of the hive
+    namespace Header {
+        static const SIZE_T SignatureOffset = 0x00u;
+        static const SIZE_T VersionOffset = 0x04u;
+        static const SIZE_T PrimarySequenceOffset = 0x08u;
+        static const SIZE_T SecondarySequenceOffset = 0x0Cu;
+        static const SIZE_T TimestampOffset = 0x10u;
+        static const SIZE_T BinsDataSizeOffset = 0x18u;
+        static const SIZE_T KeyCountOffset = 0x1Cu;
+        static const SIZE_T ValueCountOffset = 0x20u;
+        static const SIZE_T StringsSizeOffset = 0x24u;
+        static const SIZE_T Size = 0x28u;
+    }
+
+    /// Entry of the key table
+    namespace KeyEntry {
+        static const SIZE_T PathOffsetOffset = 0x00u;
+        static const SIZE_T PathLengthOffset = 0x04u;
+        static const SIZE_T CellOffsetOffset = 0x08u;
+        static const SIZE_T FirstValueOffset = 0x0Cu;
+        static const SIZE_T SubtreeEndOffset = 0x10u;
+        static const SIZE_T Size = 0x14u;
+    }
+
+    /// Entry of the value table
+    namespace ValueEntry {
+        static const SIZE_T NameOffsetOffset = 0x00u;
+        static const SIZE_T NameLengthOffset = 0x04u;
+        static const SIZE_T CellOffsetOffset = 0x08u;
+        static const SIZE_T Size = 0x0Cu;
+    }
+
+    /// Flag of string lengths, set when the string is stored in Latin-1
+    static const DWORD CompressedFlag = 0x80000000u;
+}
+
+/// Tables of an index being built
+struct IndexTables {
+    /// Key table
+    std::vector<BYTE> Keys;
+
+    /// Value table
+    std::vector<BYTE> Values;
+
+    /// Strings
+    std::vector<BYTE> Strings;
+
+    /// Buffer for encoding strings
+    std::vector<BYTE> Encoded;
+};
+
+/// @brief Compare two key paths name by name, in the order of the key table
+/// @param[in] Left First path
+/// @param[in] Right Second path
+/// @return Negative, zero or positive value when #Left sorts before, with or after #Right
+/// @note A key sorts before its subkeys, which sort before its next sibling: this is the order in which
+///       the tree is walked when building the index, subkeys being sorted as in subkey lists.
+static int ComparePaths
+(
+    _In_ const std::wstring_view Left,
+    _In_ const std::wstring_view Right
+)
+{
+    SIZE_T LeftStart = 0;
+    SIZE_T RightStart = 0;
+
+    while (true)
+    {
+        if (LeftStart > Left.length() || RightStart > Right.length())
+        {
+            return LeftStart > Left.length() ? (RightStart > Right.length() ? 0 : -1) : 1;
+        }
+
+        const SIZE_T LeftEnd = std::min(Left.find(Constants::RegFiles::PathSeparator, LeftStart), Left.length());
+        const SIZE_T RightEnd = std::min(Right.find(Constants::RegFiles::PathSeparator, RightStart), Right.length());
+        const int Comparison = Regf::CompareNames(Left.substr(LeftStart, LeftEnd - LeftStart), Right.substr(RightStart, RightEnd - RightStart));
+        if (Comparison != 0)
+        {
+            return Comparison;
+        }
+
+        LeftStart = LeftEnd + 1;
+        RightStart = RightEnd + 1;
+    }
+}
+
+/// @brief Store a string of the index
+/// @param[in,out] Tables Tables of the index
+/// @param[in] String String to store
+/// @param[out] Entry Table entry, whose offset and length of string are written
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT StoreString
+(
+    _Inout_ IndexTables& Tables,
+    _In_ const std::wstring_view String,
+    _Out_ BYTE* Entry
+)
+{
+    const bool Compressed = Regf::EncodeName(String, Tables.Encoded);
+
+    if (Tables.Encoded.size() >= IndexFile::CompressedFlag || Tables.Strings.size() + Tables.Encoded.size() > MAXDWORD)
+    {
+        return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+    }
+
+    Regf::WriteDword(Entry, static_cast<DWORD>(Tables.Strings.size()));
+    Regf::WriteDword(Entry + sizeof(DWORD), static_cast<DWORD>(Tables.Encoded.size()) | (Compressed ? IndexFile::CompressedFlag : 0));
+    Tables.Strings.insert(Tables.Strings.end(), Tables.Encoded.begin(), Tables.Encoded.end());
+    return S_OK;
+}
+
+/// @brief Add a key, its values and its subtree to the index
+/// @param[in] Image Accessor over the hive image
+/// @param[in] Node Key node of the key
+/// @param[in] Depth Depth of the key below the hive root, to bound recursion on corrupted hives
+/// @param[in,out] KeyPath Path to the key relative to the hive root, restored on return
+/// @param[in,out] Tables Tables of the index
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT IndexHiveKey
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const SIZE_T Depth,
+    _Inout_ std::wstring& KeyPath,
+    _Inout_ IndexTables& Tables
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* ValueList = nullptr;
+    std::vector<DWORD> SubkeyOffsets;
+    std::vector<std::pair<std::wstring, DWORD>> Names;
+
+    if (Depth > Constants::Hives::MaximalKeyDepth)
+    {
+        ReportError(E_UNEXPECTED, L"Key tree is too deep - Current key path: " + KeyPath);
+        return E_UNEXPECTED;
+    }
+
+    const SIZE_T KeyIndex = Tables.Keys.size() / IndexFile::KeyEntry::Size;
+    const SIZE_T ValueIndex = Tables.Values.size() / IndexFile::ValueEntry::Size;
+    if (KeyIndex >= MAXDWORD || ValueIndex + Node.ValueCount >= MAXDWORD)
+    {
+        return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+    }
+
+    Tables.Keys.resize(Tables.Keys.size() + IndexFile::KeyEntry::Size);
+    Result = StoreString(Tables, KeyPath, Tables.Keys.data() + KeyIndex * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::PathOffsetOffset);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+    Regf::WriteDword(Tables.Keys.data() + KeyIndex * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::CellOffsetOffset, Node.CellOffset);
+    Regf::WriteDword(Tables.Keys.data() + KeyIndex * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::FirstValueOffset, static_cast<DWORD>(ValueIndex));
+
+    // values are sorted by name, so that they are searched by halves
+    Result = GetValueList(Image, Node, ValueList);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Getting value list - Current key path: " + KeyPath);
+        return Result;
+    }
+
+    for (DWORD Index = 0; Index < Node.ValueCount; ++Index)
+    {
+        HiveValueNode ValueNode;
+        Result = GetValueNode(Image, Regf::ReadDword(ValueList + Index * sizeof(DWORD)), ValueNode);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Getting value - Current key path: " + KeyPath);
+            return Result;
+        }
+        std::wstring& Name = Names.emplace_back(std::wstring{}, ValueNode.CellOffset).first;
+        Regf::DecodeName(ValueNode.Name, ValueNode.NameLength, ValueNode.HasCompressedName(), Name);
+    }
+
+    std::sort(Names.begin(), Names.end(), [](const std::pair<std::wstring, DWORD>& Left, const std::pair<std::wstring, DWORD>& Right)
+    {
+        return Regf::CompareNames(Left.first, Right.first) < 0;
+    });
+
+    Tables.Values.resize(Tables.Values.size() + Names.size() * IndexFile::ValueEntry::Size);
+    for (SIZE_T Index = 0; Index < Names.size(); ++Index)
+    {
+        BYTE* Entry = Tables.Values.data() + (ValueIndex + Index) * IndexFile::ValueEntry::Size;
+        Result = StoreString(Tables, Names[Index].first, Entry + IndexFile::ValueEntry::NameOffsetOffset);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+        Regf::WriteDword(Entry + IndexFile::ValueEntry::CellOffsetOffset, Names[Index].second);
+    }
+
+    // subkey lists are sorted already, save in corrupted hives: the order of the key table must not depend on it
+    Result = GetSubkeyOffsets(Image, Node, SubkeyOffsets);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Getting subkey list - Current key path: " + KeyPath);
+        return Result;
+    }
+
+    Names.clear();
+    for (const DWORD SubkeyOffset : SubkeyOffsets)
+    {
+        HiveKeyNode SubkeyNode;
+        Result = GetKeyNode(Image, SubkeyOffset, SubkeyNode);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Getting subkey - Current key path: " + KeyPath);
+            return Result;
+        }
+        std::wstring& Name = Names.emplace_back(std::wstring{}, SubkeyOffset).first;
+        Regf::DecodeName(SubkeyNode.Name, SubkeyNode.NameLength, SubkeyNode.HasCompressedName(), Name);
+    }
+
+    std::sort(Names.begin(), Names.end(), [](const std::pair<std::wstring, DWORD>& Left, const std::pair<std::wstring, DWORD>& Right)
+    {
+        return Regf::CompareNames(Left.first, Right.first) < 0;
+    });
+
+    for (const std::pair<std::wstring, DWORD>& Subkey : Names)
+    {
+        HiveKeyNode SubkeyNode;
+        Result = GetKeyNode(Image, Subkey.second, SubkeyNode);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+
+        const SIZE_T PathLength = KeyPath.length();
+        if (Depth > 0)
+        {
+            KeyPath += Constants::RegFiles::PathSeparator;
+        }
+        KeyPath += Subkey.first;
+
+        Result = IndexHiveKey(Image, SubkeyNode, Depth + 1, KeyPath, Tables);
+        KeyPath.resize(PathLength);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+    }
+
+    Regf::WriteDword(Tables.Keys.data() + KeyIndex * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::SubtreeEndOffset, static_cast<DWORD>(Tables.Keys.size() / IndexFile::KeyEntry::Size));
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::Build
+(
+    _In_ const HiveView& View,
+    _In_ const std::wstring& IndexFilePath
+)
+{
+    HRESULT Result = E_FAIL;
+    IndexTables Tables;
+    std::wstring KeyPath;
+    OutputFile IndexOutput;
+    BYTE Header[IndexFile::Header::Size] = {};
+
+    Result = IndexHiveKey(View.Image(), View.RootKey(), 0, KeyPath, Tables);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Indexing hive keys");
+        return Result;
+    }
+
+    // the index is bound to the base block as it was when the hive was last written
+    const BYTE* BaseBlock = View.Image().Data;
+    Regf::WriteDword(Header + IndexFile::Header::SignatureOffset, IndexFile::Signature);
+    Regf::WriteDword(Header + IndexFile::Header::VersionOffset, IndexFile::Version);
+    Regf::WriteDword(Header + IndexFile::Header::PrimarySequenceOffset, Regf::ReadDword(BaseBlock + Regf::BaseBlock::PrimarySequenceOffset));
+    Regf::WriteDword(Header + IndexFile::Header::SecondarySequenceOffset, Regf::ReadDword(BaseBlock + Regf::BaseBlock::SecondarySequenceOffset));
+    Regf::WriteQword(Header + IndexFile::Header::TimestampOffset, Regf::ReadQword(BaseBlock + Regf::BaseBlock::TimestampOffset));
+    Regf::WriteDword(Header + IndexFile::Header::BinsDataSizeOffset, static_cast<DWORD>(View.Image().BinsDataSize));
+    Regf::WriteDword(Header + IndexFile::Header::KeyCountOffset, static_cast<DWORD>(Tables.Keys.size() / IndexFile::KeyEntry::Size));
+    Regf::WriteDword(Header + IndexFile::Header::ValueCountOffset, static_cast<DWORD>(Tables.Values.size() / IndexFile::ValueEntry::Size));
+    Regf::WriteDword(Header + IndexFile::Header::StringsSizeOffset, static_cast<DWORD>(Tables.Strings.size()));
+
+    Result = IndexOutput.Create(IndexFilePath);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Creating index file " + IndexFilePath);
+        return Result;
+    }
+
+    for (const std::pair<const void*, SIZE_T>& Part : {
+        std::pair<const void*, SIZE_T>{ Header, sizeof(Header) },
+        std::pair<const void*, SIZE_T>{ Tables.Keys.data(), Tables.Keys.size() },
+        std::pair<const void*, SIZE_T>{ Tables.Values.data(), Tables.Values.size() },
+        std::pair<const void*, SIZE_T>{ Tables.Strings.data(), Tables.Strings.size() } })
+    {
+        Result = IndexOutput.Write(Part.first, Part.second);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Writing index file " + IndexFilePath);
+            return Result;
+        }
+    }
+
+    IndexOutput.Close();
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::Open
+(
+    _In_ const std::wstring& IndexFilePath,
+    _In_ const HiveView& View
+)
+{
+    HRESULT Result = E_FAIL;
+
+    Image = nullptr;
+
+    Result = File.Open(IndexFilePath);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Loading index file " + IndexFilePath);
+        return Result;
+    }
+
+    const BYTE* Data = File.Data();
+    const BYTE* BaseBlock = View.Image().Data;
+    if (Data == nullptr || File.Size() < IndexFile::Header::Size ||
+        Regf::ReadDword(Data + IndexFile::Header::SignatureOffset) != IndexFile::Signature ||
+        Regf::ReadDword(Data + IndexFile::Header::VersionOffset) != IndexFile::Version ||
+        Regf::ReadDword(Data + IndexFile::Header::PrimarySequenceOffset) != Regf::ReadDword(BaseBlock + Regf::BaseBlock::PrimarySequenceOffset) ||
+        Regf::ReadDword(Data + IndexFile::Header::SecondarySequenceOffset) != Regf::ReadDword(BaseBlock + Regf::BaseBlock::SecondarySequenceOffset) ||
+        Regf::ReadQword(Data + IndexFile::Header::TimestampOffset) != Regf::ReadQword(BaseBlock + Regf::BaseBlock::TimestampOffset) ||
+        Regf::ReadDword(Data + IndexFile::Header::BinsDataSizeOffset) != View.Image().BinsDataSize)
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    KeyCount = Regf::ReadDword(Data + IndexFile::Header::KeyCountOffset);
+    ValueCount = Regf::ReadDword(Data + IndexFile::Header::ValueCountOffset);
+    StringsSize = Regf::ReadDword(Data + IndexFile::Header::StringsSizeOffset);
+
+    // the hive root is always indexed, and a truncated index is one whose write did not complete
+    if (KeyCount == 0 ||
+        IndexFile::Header::Size + static_cast<ULONGLONG>(KeyCount) * IndexFile::KeyEntry::Size +
+        static_cast<ULONGLONG>(ValueCount) * IndexFile::ValueEntry::Size + StringsSize != File.Size())
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    Keys = Data + IndexFile::Header::Size;
+    Values = Keys + KeyCount * IndexFile::KeyEntry::Size;
+    Strings = Values + ValueCount * IndexFile::ValueEntry::Size;
+    Image = &View.Image();
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::Load
+(
+    _In_ const std::wstring& IndexFilePath,
+    _In_ const HiveView& View
+)
+{
+    HRESULT Result = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    std::error_code ErrorCode;
+
+    if (std::filesystem::exists(IndexFilePath, ErrorCode))
+    {
+        Result = Open(IndexFilePath, View);
+        if (Result != HRESULT_FROM_WIN32(ERROR_INVALID_DATA))
+        {
+            return Result;
+        }
+        File.Close();
+    }
+
+    Result = Build(View, IndexFilePath);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    Result = Open(IndexFilePath, View);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Reading index file " + IndexFilePath);
+        return Result;
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::GetString
+(
+    _In_ const BYTE* Entry,
+    _Out_ std::wstring& String
+) const
+{
+    const DWORD Offset = Regf::ReadDword(Entry);
+    const DWORD Length = Regf::ReadDword(Entry + sizeof(DWORD)) & ~IndexFile::CompressedFlag;
+    const bool Compressed = (Regf::ReadDword(Entry + sizeof(DWORD)) & IndexFile::CompressedFlag) != 0;
+
+    if (static_cast<ULONGLONG>(Offset) + Length > StringsSize)
+    {
+        String.clear();
+        ReportError(E_UNEXPECTED, L"Index string exceeds index file");
+        return E_UNEXPECTED;
+    }
+
+    Regf::DecodeName(Strings + Offset, Length, Compressed, String);
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::GetKeyPath
+(
+    _In_ const SIZE_T KeyIndex,
+    _Out_ std::wstring& KeyPath
+) const
+{
+    return GetString(Keys + KeyIndex * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::PathOffsetOffset, KeyPath);
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::FindKey
+(
+    _In_ const std::wstring_view KeyPath,
+    _Out_ SIZE_T& KeyIndex
+) const
+{
+    HRESULT Result = E_FAIL;
+    std::wstring PathBuffer;
+    SIZE_T Begin = 0;
+    SIZE_T End = KeyCount;
+
+    KeyIndex = 0;
+
+    while (Begin < End)
+    {
+        const SIZE_T Middle = Begin + (End - Begin) / 2;
+        Result = GetKeyPath(Middle, PathBuffer);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+
+        const int Comparison = ComparePaths(PathBuffer, KeyPath);
+        if (Comparison == 0)
+        {
+            KeyIndex = Middle;
+            return S_OK;
+        }
+        if (Comparison < 0)
+        {
+            Begin = Middle + 1;
+        }
+        else
+        {
+            End = Middle;
+        }
+    }
+
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::GetKey
+(
+    _In_ const SIZE_T KeyIndex,
+    _Out_ HiveKeyNode& Key
+) const
+{
+    Key = HiveKeyNode{};
+
+    if (KeyIndex >= KeyCount)
+    {
+        return E_INVALIDARG;
+    }
+
+    return GetKeyNode(*Image, Regf::ReadDword(Keys + KeyIndex * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::CellOffsetOffset), Key);
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::FindValue
+(
+    _In_ const SIZE_T KeyIndex,
+    _In_ const std::wstring_view Name,
+    _Out_ HiveValueNode& Value
+) const
+{
+    HRESULT Result = E_FAIL;
+    std::wstring NameBuffer;
+
+    Value = HiveValueNode{};
+
+    if (KeyIndex >= KeyCount)
+    {
+        return E_INVALIDARG;
+    }
+
+    // the values of a key end where the values of the next key begin
+    SIZE_T Begin = Regf::ReadDword(Keys + KeyIndex * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::FirstValueOffset);
+    SIZE_T End = KeyIndex + 1 < KeyCount ?
+        Regf::ReadDword(Keys + (KeyIndex + 1) * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::FirstValueOffset) : ValueCount;
+    if (Begin > End || End > ValueCount)
+    {
+        ReportError(E_UNEXPECTED, L"Index value range exceeds value table");
+        return E_UNEXPECTED;
+    }
+
+    while (Begin < End)
+    {
+        const SIZE_T Middle = Begin + (End - Begin) / 2;
+        const BYTE* Entry = Values + Middle * IndexFile::ValueEntry::Size;
+        Result = GetString(Entry + IndexFile::ValueEntry::NameOffsetOffset, NameBuffer);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+
+        const int Comparison = Regf::CompareNames(NameBuffer, Name);
+        if (Comparison == 0)
+        {
+            return GetValueNode(*Image, Regf::ReadDword(Entry + IndexFile::ValueEntry::CellOffsetOffset), Value);
+        }
+        if (Comparison < 0)
+        {
+            Begin = Middle + 1;
+        }
+        else
+        {
+            End = Middle;
+        }
+    }
+
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveIndex::ListKeys
+(
+    _In_ const std::wstring_view KeyPath,
+    _Out_ std::vector<std::wstring>& KeyPaths
+) const
+{
+    HRESULT Result = E_FAIL;
+    SIZE_T KeyIndex = 0;
+
+    KeyPaths.clear();
+
+    Result = FindKey(KeyPath, KeyIndex);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    const SIZE_T SubtreeEnd = Regf::ReadDword(Keys + KeyIndex * IndexFile::KeyEntry::Size + IndexFile::KeyEntry::SubtreeEndOffset);
+    if (SubtreeEnd <= KeyIndex || SubtreeEnd > KeyCount)
+    {
+        ReportError(E_UNEXPECTED, L"Index subtree exceeds key table");
+        return E_UNEXPECTED;
+    }
+
+    KeyPaths.resize(SubtreeEnd - KeyIndex);
+    for (SIZE_T Index = KeyIndex; Index < SubtreeEnd; ++Index)
+    {
+        Result = GetKeyPath(Index, KeyPaths[Index - KeyIndex]);
+        if (FAILED(Result))
+        {
+            KeyPaths.clear();
+            return Result;
+        }
+    }
+
+    return S_OK;
+}
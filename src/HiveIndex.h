@@ -0,0 +1,155 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include "HiveView.h"
+#include "MappedFile.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Index of the keys and values of a hive, kept in a file next to it for repeated queries.
+/// The index holds the paths of all keys, sorted name by name, with the offsets of their key nodes, and for each key
+/// the names of its values, sorted, with the offsets of their value nodes. Lookups search the mapped index by halves,
+/// and only read the cells of the keys and values they return.
+/// @note An index is bound to the sequence numbers, timestamp and size of the hive it was built from: it is built
+///       again whenever the hive changes.
+class HiveIndex {
+public:
+    HiveIndex() = default;
+
+    HiveIndex(const HiveIndex&) = delete;
+    HiveIndex& operator=(const HiveIndex&) = delete;
+
+    /// @brief Open the index of a hive, building it first when it is missing or out of date
+    /// @param[in] IndexFilePath Path to the index file
+    /// @param[in] View View of the hive. Must outlive the index.
+    /// @return HRESULT semantics
+    /// @note #IndexFilePath is overwritten when the index is built again.
+    _Must_inspect_result_
+    HRESULT Load
+    (
+        _In_ const std::wstring& IndexFilePath,
+        _In_ const HiveView& View
+    );
+
+    /// @brief Build the index of a hive and write it to a file
+    /// @param[in] View View of the hive
+    /// @param[in] IndexFilePath Path to the index file, overwritten if it already exists
+    /// @return HRESULT semantics
+    /// @note The hive is read in a single pass. Subkeys and values are sorted by name as they are read.
+    _Must_inspect_result_
+    static HRESULT Build
+    (
+        _In_ const HiveView& View,
+        _In_ const std::wstring& IndexFilePath
+    );
+
+    /// @brief Look up a key in the index
+    /// @param[in] KeyPath Path to the key relative to the hive root, empty for the hive root
+    /// @param[out] KeyIndex Index of the key in the index
+    /// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no such key
+    _Must_inspect_result_
+    HRESULT FindKey
+    (
+        _In_ const std::wstring_view KeyPath,
+        _Out_ SIZE_T& KeyIndex
+    ) const;
+
+    /// @brief Read the key node of a key of the index
+    /// @param[in] KeyIndex Index of the key, as found by #FindKey
+    /// @param[out] Key Key node
+    /// @return HRESULT semantics
+    _Must_inspect_result_
+    HRESULT GetKey
+    (
+        _In_ const SIZE_T KeyIndex,
+        _Out_ HiveKeyNode& Key
+    ) const;
+
+    /// @brief Decode the path of a key of the index
+    /// @param[in] KeyIndex Index of the key, as found by #FindKey
+    /// @param[out] KeyPath Path to the key relative to the hive root, with the names as stored in the hive
+    /// @return HRESULT semantics
+    _Must_inspect_result_
+    HRESULT GetKeyPath
+    (
+        _In_ const SIZE_T KeyIndex,
+        _Out_ std::wstring& KeyPath
+    ) const;
+
+    /// @brief Look up a value of a key in the index
+    /// @param[in] KeyIndex Index of the key, as found by #FindKey
+    /// @param[in] Name Name of the value, empty for the default value
+    /// @param[out] Value Value node
+    /// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no such value
+    _Must_inspect_result_
+    HRESULT FindValue
+    (
+        _In_ const SIZE_T KeyIndex,
+        _In_ const std::wstring_view Name,
+        _Out_ HiveValueNode& Value
+    ) const;
+
+    /// @brief List the paths of a key and of all the keys below it
+    /// @param[in] KeyPath Path to the key relative to the hive root, empty for the hive root
+    /// @param[out] KeyPaths Paths relative to the hive root, in the order of the index
+    /// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no such key
+    /// @note The keys below a key follow it in the index: only their paths are read, not the hive.
+    _Must_inspect_result_
+    HRESULT ListKeys
+    (
+        _In_ const std::wstring_view KeyPath,
+        _Out_ std::vector<std::wstring>& KeyPaths
+    ) const;
+
+private:
+    /// @brief Map an index file and check that it was built from a hive
+    /// @param[in] IndexFilePath Path to the index file
+    /// @param[in] View View of the hive
+    /// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if the index is out of date or malformed
+    _Must_inspect_result_
+    HRESULT Open
+    (
+        _In_ const std::wstring& IndexFilePath,
+        _In_ const HiveView& View
+    );
+
+    /// @brief Decode a string of the index
+    /// @param[in] Entry Table entry, beginning with the offset and the length of the string
+    /// @param[out] String Decoded string
+    /// @return HRESULT semantics
+    _Must_inspect_result_
+    HRESULT GetString
+    (
+        _In_ const BYTE* Entry,
+        _Out_ std::wstring& String
+    ) const;
+
+    /// Mapping of the index file
+    MappedFile File;
+
+    /// Accessor over the indexed hive
+    const HiveImage* Image = nullptr;
+
+    /// Count of keys in the index
+    SIZE_T KeyCount = 0;
+
+    /// Count of values in the index
+    SIZE_T ValueCount = 0;
+
+    /// Beginning of the key table
+    const BYTE* Keys = nullptr;
+
+    /// Beginning of the value table
+    const BYTE* Values = nullptr;
+
+    /// Beginning of the strings
+    const BYTE* Strings = nullptr;
+
+    /// Size of the strings in bytes
+    SIZE_T StringsSize = 0;
+};
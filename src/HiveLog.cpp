@@ -0,0 +1,243 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "HiveLog.h"
+#include "CommonFunctions.h"
+#include "Constants.h"
+#include "RegfFormat.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <system_error>
+
+/// Transaction log file of a hive, mapped in memory
+struct HiveLogFile {
+    /// Mapping of the log file
+    MappedFile File;
+
+    /// Primary sequence number of the base block of the log file
+    DWORD Sequence = 0;
+};
+
+/// @brief Check the base block of a transaction log file
+/// @param[in] Data Beginning of the log file
+/// @param[in] Size Size of the log file in bytes
+/// @return true if the log file is made of log entries, and its base block is intact
+/// @note Logs in the format used before Windows 8.1 (dirty page bitmaps) are not made of log entries.
+static bool IsLogBaseBlockValid
+(
+    _In_ const BYTE* Data,
+    _In_ const SIZE_T Size
+)
+{
+    return Data != nullptr && Size >= Regf::LogFile::BaseBlockSize &&
+        Regf::ReadDword(Data + Regf::BaseBlock::SignatureOffset) == Regf::BaseBlock::Signature &&
+        Regf::ReadDword(Data + Regf::BaseBlock::ChecksumOffset) == Regf::BaseBlockChecksum(Data) &&
+        Regf::ReadDword(Data + Regf::BaseBlock::FileTypeOffset) == Regf::LogFile::LogEntriesFileType;
+}
+
+/// @brief Check a log entry
+/// @param[in] Entry Beginning of the log entry
+/// @param[in] Available Count of bytes from #Entry to the end of the log file
+/// @return true if the log entry is complete, its dirty pages lie within the hive bins data, and its hashes match
+static bool IsLogEntryValid
+(
+    _In_ const BYTE* Entry,
+    _In_ const SIZE_T Available
+)
+{
+    if (Available < Regf::LogEntry::DirtyPagesOffset ||
+        Regf::ReadDword(Entry + Regf::LogEntry::SignatureOffset) != Regf::LogEntry::Signature)
+    {
+        return false;
+    }
+
+    const SIZE_T EntrySize = Regf::ReadDword(Entry + Regf::LogEntry::SizeOffset);
+    const DWORD BinsDataSize = Regf::ReadDword(Entry + Regf::LogEntry::BinsDataSizeOffset);
+    const SIZE_T PageCount = Regf::ReadDword(Entry + Regf::LogEntry::DirtyPageCountOffset);
+
+    if (EntrySize < Regf::LogEntry::DirtyPagesOffset || EntrySize % Regf::LogEntry::Alignment != 0 || EntrySize > Available ||
+        BinsDataSize % Regf::Bin::Alignment != 0 ||
+        PageCount > (EntrySize - Regf::LogEntry::DirtyPagesOffset) / Regf::LogEntry::DirtyPageReferenceSize)
+    {
+        return false;
+    }
+
+    ULONGLONG PagesSize = 0;
+    for (SIZE_T PageIndex = 0; PageIndex < PageCount; ++PageIndex)
+    {
+        const BYTE* Reference = Entry + Regf::LogEntry::DirtyPagesOffset + PageIndex * Regf::LogEntry::DirtyPageReferenceSize;
+        const DWORD PageOffset = Regf::ReadDword(Reference);
+        const DWORD PageSize = Regf::ReadDword(Reference + sizeof(DWORD));
+        if (static_cast<ULONGLONG>(PageOffset) + PageSize > BinsDataSize)
+        {
+            return false;
+        }
+        PagesSize += PageSize;
+    }
+
+    if (Regf::LogEntry::DirtyPagesOffset + PageCount * Regf::LogEntry::DirtyPageReferenceSize + PagesSize > EntrySize)
+    {
+        return false;
+    }
+
+    return Regf::Marvin32(Entry, Regf::LogEntry::HeaderHashedSize, Regf::LogEntry::HashSeed) == Regf::ReadQword(Entry + Regf::LogEntry::HeaderHashOffset) &&
+        Regf::Marvin32(Entry + Regf::LogEntry::DirtyPagesOffset, EntrySize - Regf::LogEntry::DirtyPagesOffset, Regf::LogEntry::HashSeed) == Regf::ReadQword(Entry + Regf::LogEntry::DataHashOffset);
+}
+
+// non-static function: documented in header.
+bool IsHiveImageDirty
+(
+    _In_ const BYTE* Data,
+    _In_ const SIZE_T Size
+)
+{
+    // images that are not hives at all are reported when they are opened
+    if (Data == nullptr || Size < Regf::BaseBlock::Size ||
+        Regf::ReadDword(Data + Regf::BaseBlock::SignatureOffset) != Regf::BaseBlock::Signature)
+    {
+        return false;
+    }
+
+    return Regf::ReadDword(Data + Regf::BaseBlock::ChecksumOffset) != Regf::BaseBlockChecksum(Data) ||
+        Regf::ReadDword(Data + Regf::BaseBlock::PrimarySequenceOffset) != Regf::ReadDword(Data + Regf::BaseBlock::SecondarySequenceOffset);
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT ReplayHiveLogs
+(
+    _In_ const std::wstring& HiveFilePath,
+    _In_ const MappedFile& HiveFile,
+    _Out_ std::vector<BYTE>& GrownImage,
+    _Out_ const BYTE*& Data,
+    _Out_ SIZE_T& Size
+)
+{
+    HRESULT Result = E_FAIL;
+    std::list<HiveLogFile> Logs;
+    std::vector<const BYTE*> Entries;
+    const HiveLogFile* LastLog = nullptr;
+    DWORD NextSequence = 0;
+    DWORD MaximalBinsDataSize = 0;
+    BYTE* Image = nullptr;
+
+    GrownImage.clear();
+    Data = HiveFile.Data();
+    Size = HiveFile.Size();
+
+    if (HiveFile.MutableData() == nullptr || Size < Regf::BaseBlock::Size)
+    {
+        ReportError(E_INVALIDARG, L"Hive file " + HiveFilePath + L" is not mapped for replaying its logs");
+        return E_INVALIDARG;
+    }
+
+    // entries older than the last completed write are already in the hive file, unless its base block is corrupted
+    const DWORD HiveSequence = Regf::ReadDword(Data + Regf::BaseBlock::ChecksumOffset) == Regf::BaseBlockChecksum(Data) ?
+        Regf::ReadDword(Data + Regf::BaseBlock::SecondarySequenceOffset) : 0;
+
+    for (const std::wstring& Extension : Constants::Hives::LogFileExtensions)
+    {
+        const std::wstring LogFilePath = HiveFilePath + Extension;
+        std::error_code ErrorCode;
+
+        if (!std::filesystem::exists(LogFilePath, ErrorCode))
+        {
+            continue;
+        }
+
+        HiveLogFile& Log = Logs.emplace_back();
+        Result = Log.File.Open(LogFilePath);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Loading transaction log " + LogFilePath);
+            return Result;
+        }
+
+        if (!IsLogBaseBlockValid(Log.File.Data(), Log.File.Size()))
+        {
+            Logs.pop_back();
+            continue;
+        }
+        Log.Sequence = Regf::ReadDword(Log.File.Data() + Regf::BaseBlock::PrimarySequenceOffset);
+    }
+
+    Logs.sort([](const HiveLogFile& Left, const HiveLogFile& Right)
+    {
+        return Left.Sequence < Right.Sequence;
+    });
+
+    // entries are chained by sequence number, from the older log to the newer one
+    for (const HiveLogFile& Log : Logs)
+    {
+        SIZE_T Offset = Regf::LogFile::BaseBlockSize;
+        while (IsLogEntryValid(Log.File.Data() + Offset, Log.File.Size() - Offset))
+        {
+            const BYTE* Entry = Log.File.Data() + Offset;
+            const DWORD Sequence = Regf::ReadDword(Entry + Regf::LogEntry::SequenceOffset);
+
+            Offset += Regf::ReadDword(Entry + Regf::LogEntry::SizeOffset);
+            if (Sequence < HiveSequence)
+            {
+                continue;
+            }
+            if (!Entries.empty() && Sequence != NextSequence)
+            {
+                break;
+            }
+
+            Entries.push_back(Entry);
+            NextSequence = Sequence + 1;
+            MaximalBinsDataSize = std::max(MaximalBinsDataSize, Regf::ReadDword(Entry + Regf::LogEntry::BinsDataSizeOffset));
+            LastLog = &Log;
+        }
+    }
+
+    if (Entries.empty())
+    {
+        return S_FALSE;
+    }
+
+    if (Regf::BaseBlock::Size + MaximalBinsDataSize <= Size)
+    {
+        Image = HiveFile.MutableData();
+    }
+    else
+    {
+        // the hive grew since it was last written: pages past the end of the file cannot be mapped
+        GrownImage.reserve(Regf::BaseBlock::Size + MaximalBinsDataSize);
+        GrownImage.assign(Data, Data + Size);
+        GrownImage.resize(Regf::BaseBlock::Size + MaximalBinsDataSize);
+        Image = GrownImage.data();
+        Size = GrownImage.size();
+    }
+
+    for (const BYTE* Entry : Entries)
+    {
+        const SIZE_T PageCount = Regf::ReadDword(Entry + Regf::LogEntry::DirtyPageCountOffset);
+        const BYTE* PageData = Entry + Regf::LogEntry::DirtyPagesOffset + PageCount * Regf::LogEntry::DirtyPageReferenceSize;
+
+        for (SIZE_T PageIndex = 0; PageIndex < PageCount; ++PageIndex)
+        {
+            const BYTE* Reference = Entry + Regf::LogEntry::DirtyPagesOffset + PageIndex * Regf::LogEntry::DirtyPageReferenceSize;
+            const DWORD PageOffset = Regf::ReadDword(Reference);
+            const DWORD PageSize = Regf::ReadDword(Reference + sizeof(DWORD));
+
+            std::memcpy(Image + Regf::BaseBlock::Size + PageOffset, PageData, PageSize);
+            PageData += PageSize;
+        }
+    }
+
+    // the base block is taken from the log, and marked as completely written
+    std::memcpy(Image, LastLog->File.Data(), Regf::LogFile::BaseBlockSize);
+    Regf::WriteDword(Image + Regf::BaseBlock::PrimarySequenceOffset, NextSequence);
+    Regf::WriteDword(Image + Regf::BaseBlock::SecondarySequenceOffset, NextSequence);
+    Regf::WriteDword(Image + Regf::BaseBlock::FileTypeOffset, Regf::BaseBlock::PrimaryFileType);
+    Regf::WriteDword(Image + Regf::BaseBlock::BinsDataSizeOffset, Regf::ReadDword(Entries.back() + Regf::LogEntry::BinsDataSizeOffset));
+    Regf::WriteDword(Image + Regf::BaseBlock::ChecksumOffset, Regf::BaseBlockChecksum(Image));
+
+    Data = Image;
+    return S_OK;
+}
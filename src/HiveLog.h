@@ -0,0 +1,42 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+/// @brief Check whether the last write of a hive image was not completed, so that its logs need to be replayed
+/// @param[in] Data Beginning of the image
+/// @param[in] Size Size of the image in bytes
+/// @return true if the sequence numbers of the base block differ, or if the base block is corrupted
+bool IsHiveImageDirty
+(
+    _In_ const BYTE* Data,
+    _In_ const SIZE_T Size
+);
+
+/// @brief Replay the transaction logs of a dirty hive in memory
+/// @param[in] HiveFilePath Path to the primary hive file. Its logs are found next to it, with the extensions
+///                         of Constants::Hives::LogFileExtensions.
+/// @param[in] HiveFile Copy-on-write mapping of the primary hive file, into which the log entries are replayed
+/// @param[out] GrownImage Copy of the hive, into which the log entries are replayed instead when they grow the hive
+///                        beyond the file. Left empty otherwise.
+/// @param[out] Data Beginning of the replayed image
+/// @param[out] Size Size of the replayed image in bytes
+/// @return HRESULT semantics: S_FALSE if there is no log entry to replay, #Data and #Size then describing the file as is
+/// @note Log entries (HvLE) are checked against their hashes, and replayed in sequence from the first one that is
+///       not already in the hive file, through both logs. The replay stops at the first invalid or missing entry.
+/// @note Only the pages written by the log entries are copied: the hive file and its logs are never modified.
+_Must_inspect_result_
+HRESULT ReplayHiveLogs
+(
+    _In_ const std::wstring& HiveFilePath,
+    _In_ const MappedFile& HiveFile,
+    _Out_ std::vector<BYTE>& GrownImage,
+    _Out_ const BYTE*& Data,
+    _Out_ SIZE_T& Size
+);
@@ -2,11 +2,37 @@
 // Licensed under the Apache license, version 2.0
 // See LICENSE.txt for details
 
-#include <windows.h>
+#include "Platform.h"
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <clocale>
+#include <cstdlib>
+#endif
 #include <iostream>
+#include <vector>
 #include "Conversions.h"
 #include "CommonFunctions.h"
 #include "Constants.h"
+#include "HiveVerify.h"
+#include "MonotonicArena.h"
+#include "ParallelTasks.h"
+
+#ifdef _DEBUG
+/// @brief Print the allocations served by an arena, to follow the memory taken by a registry tree
+/// @param[in] Arena Arena in which the tree is built
+static void PrintArenaStatistics
+(
+    _In_ const MonotonicArena& Arena
+)
+{
+    const MonotonicArena::Statistics ArenaStatistics = Arena.GetStatistics();
+
+    std::wcerr << L"Registry tree: " << ArenaStatistics.AllocationCount << L" allocations, " <<
+        ArenaStatistics.AllocatedBytes << L" bytes, " << ArenaStatistics.DeallocatedBytes << L" bytes given back" << std::endl;
+}
+#endif
 
 /// @brief Program entry point
 /// @param[in] Argc Command line token count, including program name
@@ -20,16 +46,134 @@ int wmain(
 {
     HRESULT Result = E_FAIL;
 
-    RegistryKey InternalStruct;
+    // the whole tree and its names are built in the arena, and released with it in one step
+    MonotonicArena Arena;
+    NameTable Names{ &Arena };
+    RegistryKey InternalStruct{ &Arena };
+    HiveView HiveStruct;
+    KeyPathPatterns SelectedKeys;
+    KeyPathPatterns ExcludedKeys;
+    SIZE_T BufferSize = Constants::Defaults::RegFileBufferSize;
+    SIZE_T ThreadCount = DefaultThreadCount();
+    bool BufferSizeGiven = false;
+    bool ThreadCountGiven = false;
+    std::wstring IndexPath;
+    HiveIndex Index;
+    std::vector<std::wstring> Operands;
 
     auto Usage = [&]()
     {
         std::wcerr << L"Usage: " << std::endl <<
-            L"\t" << Argv[0] << L" " << Constants::Program::HiveToRegFileSwitch << L" <HiveFile> <RegFile>" << std::endl <<
-            L"\t" << Argv[0] << L" " << Constants::Program::RegFileToHiveSwitch << L" <RegFile> <HiveFile>" << std::endl <<
+            L"\t" << Argv[0] << L" " << Constants::Program::HiveToRegFileSwitch << L" [" << Constants::Program::ThreadCountOption << L" <Count>] [" << Constants::Program::BufferSizeOption << L" <Bytes>]"
+                L" [" << Constants::Program::SubkeyOption << L" <KeyPath>]... [" << Constants::Program::ExcludeOption << L" <KeyPath>]... <HiveFile> <RegFile>" << std::endl <<
+            L"\t" << Argv[0] << L" " << Constants::Program::RegFileToHiveSwitch << L" [" << Constants::Program::ThreadCountOption << L" <Count>] [" << Constants::Program::BufferSizeOption << L" <Bytes>] <RegFile> <HiveFile>" << std::endl <<
+            L"\t" << Argv[0] << L" " << Constants::Program::HiveToHiveSwitch << L" [" << Constants::Program::ThreadCountOption << L" <Count>] <HiveFile> <NewHiveFile>" << std::endl <<
+            L"\t" << Argv[0] << L" " << Constants::Program::GetSwitch << L" [" << Constants::Program::IndexOption << L" <IndexFile>] <HiveFile> <KeyPath> [<ValueName>]" << std::endl <<
+            L"\t" << Argv[0] << L" " << Constants::Program::ListSwitch << L" [" << Constants::Program::IndexOption << L" <IndexFile>] <HiveFile> [<KeyPath>]" << std::endl <<
+            L"\t" << Argv[0] << L" " << Constants::Program::VerifyHiveSwitch << L" [" << Constants::Program::ThreadCountOption << L" <Count>] <HiveFile>" << std::endl <<
             std::endl;
     };
 
+    // reads the decimal value of an option, which must be at least Minimum
+    auto ParseCount = [&](INT& ArgIndex, CONST SIZE_T Minimum, SIZE_T& Count) -> bool
+    {
+        if (ArgIndex + 1 >= Argc)
+        {
+            return false;
+        }
+        ++ArgIndex;
+        WCHAR* End = nullptr;
+        const unsigned long long Value = wcstoull(Argv[ArgIndex], &End, 10);
+        if (End == Argv[ArgIndex] || *End != L'\0' || Value < Minimum || Value > static_cast<SIZE_T>(-1))
+        {
+            return false;
+        }
+        Count = static_cast<SIZE_T>(Value);
+        return true;
+    };
+
+    // reads the key path pattern of an option, relative to the hive root
+    auto ParsePattern = [&](INT& ArgIndex, KeyPathPatterns& Patterns) -> bool
+    {
+        if (ArgIndex + 1 >= Argc)
+        {
+            return false;
+        }
+        ++ArgIndex;
+        return SUCCEEDED(Patterns.Add(Argv[ArgIndex]));
+    };
+
+    // options may appear anywhere after the switch; the other tokens are operands, between MinimalCount and MaximalCount
+    auto ParseArguments = [&](CONST SIZE_T MinimalCount, CONST SIZE_T MaximalCount) -> bool
+    {
+        for (INT ArgIndex = 2; ArgIndex < Argc; ++ArgIndex)
+        {
+            if (Constants::Program::BufferSizeOption == Argv[ArgIndex])
+            {
+                if (!ParseCount(ArgIndex, sizeof(WCHAR), BufferSize))
+                {
+                    return false;
+                }
+                BufferSizeGiven = true;
+            }
+            else if (Constants::Program::ThreadCountOption == Argv[ArgIndex])
+            {
+                if (!ParseCount(ArgIndex, 1, ThreadCount))
+                {
+                    return false;
+                }
+                ThreadCountGiven = true;
+            }
+            else if (Constants::Program::SubkeyOption == Argv[ArgIndex])
+            {
+                if (!ParsePattern(ArgIndex, SelectedKeys))
+                {
+                    return false;
+                }
+            }
+            else if (Constants::Program::ExcludeOption == Argv[ArgIndex])
+            {
+                if (!ParsePattern(ArgIndex, ExcludedKeys))
+                {
+                    return false;
+                }
+            }
+            else if (Constants::Program::IndexOption == Argv[ArgIndex])
+            {
+                if (ArgIndex + 1 >= Argc)
+                {
+                    return false;
+                }
+                IndexPath = Argv[++ArgIndex];
+            }
+            else
+            {
+                Operands.emplace_back(Argv[ArgIndex]);
+            }
+        }
+        return Operands.size() >= MinimalCount && Operands.size() <= MaximalCount;
+    };
+
+    // prints text rendered with .reg file new lines, as UTF-16 or as UTF-8 when meant for scripts
+    auto PrintText = [&](CONST std::wstring& Text, CONST bool Utf8)
+    {
+        // the console gets wide text either way, and translates new lines itself. Elsewhere, wide text is
+        // converted to the encoding of the locale, UTF-8 in practice.
+#ifdef _WIN32
+        static_cast<void>(_setmode(_fileno(stdout), Utf8 ? _O_U8TEXT : _O_U16TEXT));
+#else
+        static_cast<void>(Utf8);
+#endif
+        for (SIZE_T Index = 0; Index < Text.length(); ++Index)
+        {
+            if (Text[Index] != L'\r' || Index + 1 == Text.length() || Text[Index + 1] != L'\n')
+            {
+                std::wcout << Text[Index];
+            }
+        }
+        std::wcout.flush();
+    };
+
     if (Argc <= 1)
     {
         Usage();
@@ -39,23 +183,24 @@ int wmain(
 
     if (Constants::Program::HiveToRegFileSwitch == Argv[1])
     {
-        if (Argc != 4)
+        if (!ParseArguments(2, 2) || !IndexPath.empty())
         {
             Usage();
             Result = E_INVALIDARG;
             goto Cleanup;
         }
 
-        const std::wstring HivePath { Argv[2] };
-        const std::wstring RegPath { Argv[3] };
+        const std::wstring HivePath { Operands[0] };
+        const std::wstring RegPath { Operands[1] };
 
-        Result = HiveToInternal(HivePath, Constants::Defaults::ExportKeyPath, InternalStruct);
+        // export only reads the hive: keys and values are rendered straight from the mapped file
+        Result = HiveStruct.Open(HivePath);
         if (FAILED(Result))
         {
             goto Cleanup;
         }
 
-        Result = InternalToRegfile(InternalStruct, RegPath);
+        Result = HiveViewToRegfile(HiveStruct, Constants::Defaults::ExportKeyPath, SelectedKeys, ExcludedKeys, RegPath, BufferSize, ThreadCount);
         if (FAILED(Result))
         {
             goto Cleanup;
@@ -63,23 +208,28 @@ int wmain(
     }
     else if (Constants::Program::RegFileToHiveSwitch == Argv[1])
     {
-        if (Argc != 4)
+        // key paths only filter hive exports
+        if (!ParseArguments(2, 2) || !SelectedKeys.empty() || !ExcludedKeys.empty() || !IndexPath.empty())
         {
             Usage();
             Result = E_INVALIDARG;
             goto Cleanup;
         }
 
-        const std::wstring RegPath { Argv[2] };
-        const std::wstring HivePath { Argv[3] };
+        const std::wstring RegPath { Operands[0] };
+        const std::wstring HivePath { Operands[1] };
 
-        Result = RegfileToInternal(RegPath, InternalStruct);
+        Result = RegfileToInternal(RegPath, BufferSize, ThreadCount, Names, InternalStruct);
         if (FAILED(Result))
         {
             ReportError(Result, L"Serializing registry file" + RegPath);
             goto Cleanup;
         }
 
+#ifdef _DEBUG
+        PrintArenaStatistics(Arena);
+#endif
+
         Result = InternalToHive(InternalStruct, HivePath);
         if (FAILED(Result))
         {
@@ -87,6 +237,134 @@ int wmain(
             goto Cleanup;
         }
     }
+    else if (Constants::Program::HiveToHiveSwitch == Argv[1])
+    {
+        if (!ParseArguments(2, 2) || !SelectedKeys.empty() || !ExcludedKeys.empty() || !IndexPath.empty() || BufferSizeGiven)
+        {
+            Usage();
+            Result = E_INVALIDARG;
+            goto Cleanup;
+        }
+
+        const std::wstring HivePath { Operands[0] };
+        const std::wstring NewHivePath { Operands[1] };
+
+        // the new hive only holds the cells of the tree, without the free space nor the logs of the old one
+        Result = HiveToInternal(HivePath, Constants::Defaults::ExportKeyPath, ThreadCount, Names, InternalStruct);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Reading hive file " + HivePath);
+            goto Cleanup;
+        }
+
+        Result = InternalToHive(InternalStruct, NewHivePath);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Writing hive file " + NewHivePath);
+            goto Cleanup;
+        }
+    }
+    else if (Constants::Program::GetSwitch == Argv[1] || Constants::Program::ListSwitch == Argv[1])
+    {
+        const bool Get = Constants::Program::GetSwitch == Argv[1];
+
+        // key paths and values are queried as given: patterns only filter hive exports, and a query neither
+        // writes a file nor spreads over threads
+        if (!(Get ? ParseArguments(2, 3) : ParseArguments(1, 2)) || !SelectedKeys.empty() || !ExcludedKeys.empty() ||
+            BufferSizeGiven || ThreadCountGiven)
+        {
+            Usage();
+            Result = E_INVALIDARG;
+            goto Cleanup;
+        }
+
+        const std::wstring HivePath { Operands[0] };
+        const std::wstring KeyPath { Operands.size() > 1 ? Operands[1] : L"" };
+        std::vector<std::wstring> KeyPaths;
+        std::wstring Rendition;
+
+        // the hive is only mapped: --get then reads the cells along the path, whatever the size of the hive
+        Result = HiveStruct.Open(HivePath);
+        if (FAILED(Result))
+        {
+            goto Cleanup;
+        }
+
+        // the index is built once, then read instead of the subkey lists as long as the hive is not written
+        if (!IndexPath.empty())
+        {
+            Result = Index.Load(IndexPath, HiveStruct);
+            if (FAILED(Result))
+            {
+                ReportError(Result, L"Loading index file " + IndexPath);
+                goto Cleanup;
+            }
+        }
+
+        if (Get)
+        {
+            Result = HiveViewKeyToRegText(HiveStruct, Constants::Defaults::ExportKeyPath, KeyPath, Operands.size() == 3 ? &Operands[2] : nullptr,
+                IndexPath.empty() ? nullptr : &Index, Rendition);
+            if (FAILED(Result))
+            {
+                goto Cleanup;
+            }
+        }
+        else
+        {
+            Result = IndexPath.empty() ? HiveStruct.ListKeys(KeyPath, KeyPaths) : Index.ListKeys(KeyPath, KeyPaths);
+            if (FAILED(Result))
+            {
+                ReportError(Result, L"Listing registry key " + KeyPath);
+                goto Cleanup;
+            }
+
+            // the path of the hive root is empty: it would only print a blank line
+            for (const std::wstring& Path : KeyPaths)
+            {
+                if (Path.empty())
+                {
+                    continue;
+                }
+                Rendition += Path;
+                Rendition += Constants::RegFiles::NewLines;
+            }
+        }
+
+        PrintText(Rendition, false);
+    }
+    else if (Constants::Program::VerifyHiveSwitch == Argv[1])
+    {
+        if (!ParseArguments(1, 1) || !SelectedKeys.empty() || !ExcludedKeys.empty() || !IndexPath.empty())
+        {
+            Usage();
+            Result = E_INVALIDARG;
+            goto Cleanup;
+        }
+
+        const std::wstring HivePath { Operands[0] };
+        std::vector<HiveProblem> Problems;
+        std::wstring Report;
+
+        // the hive is checked as mapped, without going through the accessors that stop at the first problem
+        Result = VerifyHive(HivePath, ThreadCount, Problems);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Verifying hive file " + HivePath);
+            goto Cleanup;
+        }
+
+        // the report is meant for scripts: UTF-8 whether it goes to a pipe or a file
+        RenderHiveProblems(HivePath, Problems, Report);
+        PrintText(Report, true);
+
+        if (!Problems.empty())
+        {
+            std::wcerr << L"Hive file " << HivePath << L" has " << Problems.size() << L" structural problems" << std::endl;
+            Result = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto Cleanup;
+        }
+    }
     else
     {
         Usage();
@@ -98,4 +376,41 @@ int wmain(
 
 Cleanup:
     return FAILED(Result) ? EXIT_FAILURE : EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+#ifndef _WIN32
+/// @brief Program entry point on POSIX platforms: the command line is decoded with the encoding of the locale
+/// @param[in] Argc Command line token count, including program name
+/// @param[in] Argv Tokens of the command line (#Argc valid entries)
+/// @retval EXIT_SUCCESS Program execution successful
+/// @retval EXIT_FAILURE Program execution failed
+int main(
+    int Argc,
+    char** Argv
+)
+{
+    std::vector<std::wstring> Arguments;
+    std::vector<LPCWSTR> WideArgv;
+
+    static_cast<void>(std::setlocale(LC_ALL, ""));
+
+    for (int ArgIndex = 0; ArgIndex < Argc; ++ArgIndex)
+    {
+        const size_t Length = std::mbstowcs(nullptr, Argv[ArgIndex], 0);
+        if (Length == static_cast<size_t>(-1))
+        {
+            std::wcerr << L"Command line argument " << ArgIndex << L" is not valid in the encoding of the locale" << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::wstring& Argument = Arguments.emplace_back(Length, L'\0');
+        static_cast<void>(std::mbstowcs(Argument.data(), Argv[ArgIndex], Length));
+    }
+
+    for (const std::wstring& Argument : Arguments)
+    {
+        WideArgv.push_back(Argument.c_str());
+    }
+
+    return wmain(Argc, WideArgv.data());
+}
+#endif
@@ -4,154 +4,130 @@
 
 #include "Conversions.h"
 #include "CommonFunctions.h"
+#include "Constants.h"
+#include "HiveView.h"
+#include "ParallelTasks.h"
 #include <sstream>
 
-/// @brief Create an internal representation of a registry key from the handle to a registry key
-/// @param[in] Hkey the registry key
-/// @param[in] KeyName Name of the key #Hkey is a handle to
-/// @param[out] RegKey Representation of the key
+/// @brief Create an internal representation of a registry key from its key node in a hive image
+/// @param[in] Image Accessor over the hive image
+/// @param[in] Node Key node of the registry key
+/// @param[in] Depth Depth of the key below the hive root, to bound recursion on corrupted hives
+/// @param[in,out] Names Table in which the names of subkeys and values are interned
+/// @param[in,out] NameBuffer Buffer for decoding names, kept across calls to spare allocations
+/// @param[in,out] RegKey Representation of the key. Its name is left untouched.
+/// @param[in,out] Queue Queue of the threads reading the hive, null when reading it in the calling thread only
 /// @return HRESULT semantics
+/// @note Values and subkeys are enumerated in the order RegEnumValueW and RegEnumKeyExW would use.
+/// @note With a queue, the subkeys of a key with many subkeys are created in order, then read by separate tasks
+///       when the queue runs short: the tree is the same whatever the count of threads.
 _Must_inspect_result_
-static HRESULT HkeyToInternal
+static HRESULT KeyNodeToInternal
 (
-    _In_ const HKEY Hkey,
-    _In_ const std::wstring& KeyName,
-    _Out_ RegistryKey& RegKey
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const SIZE_T Depth,
+    _Inout_ NameTable& Names,
+    _Inout_ std::wstring& NameBuffer,
+    _Inout_ RegistryKey& RegKey,
+    _Inout_opt_ WorkQueue* Queue
 )
 {
     HRESULT Result = E_FAIL;
-    DWORD SubkeyCount = 0;
-    DWORD MaximalSubKeyLength = 0;
-    DWORD ValueCount = 0;
-    DWORD MaximalValueNameLength = 0;
-    DWORD MaximalValueLength = 0;
-    LPWSTR SubKeyNameBuffer = NULL;
-    LPWSTR ValueNameBuffer = NULL;
-    PBYTE ValueBuffer = NULL;
-
-    if (Hkey == NULL)
-    {
-        ReportError(E_HANDLE, L"Null HKEY");
-        return E_HANDLE;
-    }
-
-    Result = HRESULT_FROM_WIN32(RegQueryInfoKeyW(Hkey, NULL, 0, NULL, &SubkeyCount, &MaximalSubKeyLength,
-        NULL, &ValueCount, &MaximalValueNameLength, &MaximalValueLength, NULL, NULL));
-    if (FAILED(Result))
-    {
-        ReportError(Result, L"Getting information on HKEY - Current key name: " + KeyName);
-        goto Cleanup;
-    }
-
-    SubKeyNameBuffer = (LPWSTR)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (1 + MaximalSubKeyLength) * sizeof(WCHAR));
-    if (SubKeyNameBuffer == NULL)
-    {
-        Result = HRESULT_FROM_WIN32(GetLastError());
-        ReportError(Result, L"Allocating space for subkey names - Current key name: " + KeyName);
-        goto Cleanup;
-    }
+    const BYTE* ValueList = nullptr;
+    std::vector<DWORD> SubkeyOffsets;
 
-    ValueNameBuffer = (LPWSTR)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (1 + MaximalValueNameLength) * sizeof(WCHAR));
-    if (ValueNameBuffer == NULL)
+    if (Depth > Constants::Hives::MaximalKeyDepth)
     {
-        Result = HRESULT_FROM_WIN32(GetLastError());
-        ReportError(Result, L"Allocating space for value names - Current key name: " + KeyName);
-        goto Cleanup;
+        ReportError(E_UNEXPECTED, L"Maximal key depth exceeded - Current key name: " + RegKey.Name);
+        return E_UNEXPECTED;
     }
 
-    ValueBuffer = (PBYTE)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, MaximalValueLength);
-    if (ValueBuffer == NULL)
+    Result = GetValueList(Image, Node, ValueList);
+    if (FAILED(Result))
     {
-        Result = HRESULT_FROM_WIN32(GetLastError());
-        ReportError(Result, L"Allocating space for values - Current key name: " + KeyName);
-        goto Cleanup;
+        ReportError(Result, L"Getting value list - Current key name: " + RegKey.Name);
+        return Result;
     }
 
-    RegKey.Name = KeyName;
-
-    for (DWORD ValueIndex = 0; ValueIndex < ValueCount; ++ValueIndex)
+    RegKey.Values.reserve(Node.ValueCount);
+    for (DWORD ValueIndex = 0; ValueIndex < Node.ValueCount; ++ValueIndex)
     {
-        DWORD ValueNameLength = MaximalValueNameLength + 1;
-        DWORD ValueType = 0;
-        DWORD DataLength = MaximalValueLength + 1;
-        Result = HRESULT_FROM_WIN32(RegEnumValueW(Hkey, ValueIndex, ValueNameBuffer, &ValueNameLength,
-            NULL, &ValueType, ValueBuffer, &DataLength));
+        HiveValueNode ValueNode;
+        Result = GetValueNode(Image, Regf::ReadDword(ValueList + ValueIndex * sizeof(DWORD)), ValueNode);
         if (FAILED(Result))
         {
             std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Getting value at index " << ValueIndex << L" - Current key name: " << KeyName;
-            ReportError(Result,  ErrorMessageStream.str());
-            goto Cleanup;
+            ErrorMessageStream << L"Getting value at index " << ValueIndex << L" - Current key name: " << RegKey.Name;
+            ReportError(Result, ErrorMessageStream.str());
+            return Result;
         }
 
-        RegistryValue NewValue;
-        NewValue.Name.assign(ValueNameBuffer, ValueNameLength);
-        NewValue.Type = ValueType;
-        NewValue.BinaryValue.assign(ValueBuffer, ValueBuffer + DataLength);
-
-        RegKey.Values.emplace_back(std::move(NewValue));
+        // values are built in place, with the allocator of the tree
+        RegistryValue& NewValue = RegKey.Values.emplace_back();
+        Regf::DecodeName(ValueNode.Name, ValueNode.NameLength, ValueNode.HasCompressedName(), NameBuffer);
+        NewValue.Name = Names.Intern(NameBuffer);
+        NewValue.Type = ValueNode.Type;
+        Result = GetValueData(Image, ValueNode, NewValue.BinaryValue);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Getting data of value " + NewValue.Name + L" - Current key name: " + RegKey.Name);
+            return Result;
+        }
     }
 
-    for (DWORD SubkeyIndex = 0; SubkeyIndex < SubkeyCount; ++SubkeyIndex)
+    Result = GetSubkeyOffsets(Image, Node, SubkeyOffsets);
+    if (FAILED(Result))
     {
-        HKEY HSubkey = NULL;
-        DWORD SubkeyNameLength = MaximalSubKeyLength + 1;
+        ReportError(Result, L"Getting subkey list - Current key name: " + RegKey.Name);
+        return Result;
+    }
+
+    // subkeys are never moved once created, so that tasks may fill them while their siblings are created
+    RegKey.Subkeys.reserve(SubkeyOffsets.size());
+    const bool SplitSubkeys = Queue != nullptr && SubkeyOffsets.size() >= Constants::Hives::ParallelReadSplitSubkeyCount && Queue->IsShort();
 
-        Result = HRESULT_FROM_WIN32(RegEnumKeyExW(Hkey, SubkeyIndex, SubKeyNameBuffer, &SubkeyNameLength, NULL, NULL, NULL, NULL));
+    for (SIZE_T SubkeyIndex = 0; SubkeyIndex < SubkeyOffsets.size(); ++SubkeyIndex)
+    {
+        HiveKeyNode SubkeyNode;
+        Result = GetKeyNode(Image, SubkeyOffsets[SubkeyIndex], SubkeyNode);
         if (FAILED(Result))
         {
             std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Getting subkey name at index " << SubkeyIndex << L" - Current key name: " << KeyName;
+            ErrorMessageStream << L"Getting subkey at index " << SubkeyIndex << L" - Current key name: " << RegKey.Name;
             ReportError(Result, ErrorMessageStream.str());
-            goto Cleanup;
+            return Result;
         }
 
-        Result = HRESULT_FROM_WIN32(RegOpenKeyExW(Hkey, SubKeyNameBuffer, REG_OPTION_OPEN_LINK, KEY_READ, &HSubkey));
-        if (FAILED(Result)) {
-            Result = HRESULT_FROM_WIN32(RegOpenKeyExW(Hkey, SubKeyNameBuffer, 0, KEY_READ, &HSubkey));
-        }
-        if (FAILED(Result))
+        RegistryKey& NewKey = RegKey.Subkeys.emplace_back();
+        Regf::DecodeName(SubkeyNode.Name, SubkeyNode.NameLength, SubkeyNode.HasCompressedName(), NameBuffer);
+        NewKey.Name = Names.Intern(NameBuffer);
+
+        if (SplitSubkeys)
         {
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Opening subkey named " << SubKeyNameBuffer << L" at index " << SubkeyIndex << L" - Current key name: " << KeyName;
-            ReportError(Result, ErrorMessageStream.str());
-            goto Cleanup;
+            const RegistryName KeyName = RegKey.Name;
+            Queue->Push([&Image, SubkeyNode, Depth, &Names, &NewKey, KeyName, Queue]() -> HRESULT
+            {
+                std::wstring TaskNameBuffer;
+                const HRESULT TaskResult = KeyNodeToInternal(Image, SubkeyNode, Depth + 1, Names, TaskNameBuffer, NewKey, Queue);
+                if (FAILED(TaskResult))
+                {
+                    ReportError(TaskResult, L"Getting contents of subkey named " + NewKey.Name + L" - Current key name: " + KeyName);
+                }
+                return TaskResult;
+            });
+            continue;
         }
 
-        std::wstring SubkeyName;
-        SubkeyName.assign(SubKeyNameBuffer, SubkeyNameLength);
-
-        RegistryKey NewKey;
-        Result = HkeyToInternal(HSubkey, SubkeyName, NewKey);
+        Result = KeyNodeToInternal(Image, SubkeyNode, Depth + 1, Names, NameBuffer, NewKey, Queue);
         if (FAILED(Result))
         {
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Getting contents of subkey named " << SubkeyName << L" - Current key name: " << KeyName;
-            ReportError(Result, ErrorMessageStream.str());
-            goto Cleanup;
+            ReportError(Result, L"Getting contents of subkey named " + NewKey.Name + L" - Current key name: " + RegKey.Name);
+            return Result;
         }
-        RegKey.Subkeys.emplace_back(std::move(NewKey));
-
-        RegCloseKey(HSubkey);
-    }
-Cleanup:
-    if (SubKeyNameBuffer)
-    {
-        HeapFree(GetProcessHeap(), 0, (LPVOID)SubKeyNameBuffer);
-        SubKeyNameBuffer = NULL;
-    }
-    if (ValueNameBuffer)
-    {
-        HeapFree(GetProcessHeap(), 0, (LPVOID)ValueNameBuffer);
-        ValueNameBuffer = NULL;
-    }
-    if (ValueBuffer)
-    {
-        HeapFree(GetProcessHeap(), 0, (LPVOID)ValueBuffer);
-        ValueBuffer = NULL;
     }
 
-    return Result;
+    return S_OK;
 }
 
 // non-static function: documented in header.
@@ -160,30 +136,34 @@ HRESULT HiveToInternal
 (
     _In_ const std::wstring& HiveFilePath,
     _In_ const std::wstring& RootName,
+    _In_ const SIZE_T ThreadCount,
+    _Inout_ NameTable& Names,
     _Out_ RegistryKey& RegKey
 )
 {
     HRESULT Result = E_FAIL;
-    HKEY HiveKey = NULL;
+    HiveView View;
+    std::wstring NameBuffer;
 
-    Result = HRESULT_FROM_WIN32(RegLoadAppKeyW(HiveFilePath.c_str(), &HiveKey, KEY_READ, REG_PROCESS_APPKEY, 0));
+    Result = View.Open(HiveFilePath);
     if (FAILED(Result))
     {
-        ReportError(Result, L"Loading hive file " + HiveFilePath);
-        goto Cleanup;
+        return Result;
     }
 
-    Result = HkeyToInternal(HiveKey, RootName, RegKey);
+    RegKey = RegistryKey{ RegKey.get_allocator() };
+    RegKey.Name = Names.Intern(RootName);
 
-Cleanup:
-    if (HiveKey != NULL)
+    if (ThreadCount <= 1)
     {
-        RegCloseKey(HiveKey);
-        HiveKey = NULL;
-
-        DeleteHiveLogFiles(HiveFilePath);
+        return KeyNodeToInternal(View.Image(), View.RootKey(), 0, Names, NameBuffer, RegKey, nullptr);
     }
 
-
-    return Result;
-}
\ No newline at end of file
+    // the root key splits its subkeys at once, since the queue is empty; their tasks split further as threads go idle
+    WorkQueue Queue{ ThreadCount };
+    Queue.Push([&]() -> HRESULT
+    {
+        return KeyNodeToInternal(View.Image(), View.RootKey(), 0, Names, NameBuffer, RegKey, &Queue);
+    });
+    return Queue.Run();
+}
@@ -0,0 +1,731 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "HiveVerify.h"
+#include "CommonFunctions.h"
+#include "Constants.h"
+#include "HiveLog.h"
+#include "MappedFile.h"
+#include "ParallelTasks.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+/// Hive image being checked
+struct HiveVerification {
+    /// Beginning of the first hive bin
+    const BYTE* Bins = nullptr;
+
+    /// Size of the hive bins data that is walked
+    SIZE_T BinsDataSize = 0;
+
+    /// Minor version of the hive
+    DWORD MinorVersion = 0;
+
+    /// One bit per cell alignment unit of the hive bins data, set at the beginning of each allocated cell.
+    /// Hive bins are aligned on whole bytes of the map, so that each hive bin is mapped by a single thread.
+    std::vector<BYTE> AllocatedCells;
+};
+
+/// @brief Format an offset for problem descriptions
+/// @param[in] Offset Offset of a cell, relative to the first hive bin
+/// @return Offset in hexadecimal
+static std::wstring DescribeOffset
+(
+    _In_ const DWORD Offset
+)
+{
+    std::wostringstream DescriptionStream;
+    DescriptionStream << L"0x" << std::hex << std::setw(8) << std::setfill(L'0') << Offset;
+    return DescriptionStream.str();
+}
+
+/// @brief Record a problem
+/// @param[in,out] Problems Problems found so far
+/// @param[in] Offset Offset of the hive bin or cell holding the problem, Regf::Cell::NullOffset for the base block
+/// @param[in] Check Name of the failed check
+/// @param[in] Detail Description of the problem
+static void AddProblem
+(
+    _Inout_ std::vector<HiveProblem>& Problems,
+    _In_ const DWORD Offset,
+    _In_ const std::wstring& Check,
+    _In_ const std::wstring& Detail
+)
+{
+    Problems.push_back(HiveProblem{ Offset, Check, Detail });
+}
+
+/// @brief Get an allocated cell from the map of allocated cells
+/// @param[in] Hive Hive being checked, with its cells mapped
+/// @param[in] CellOffset Offset of the cell
+/// @param[out] CellData Beginning of the cell data
+/// @param[out] CellDataSize Size of the cell data
+/// @return true if an allocated cell begins at #CellOffset
+static bool GetAllocatedCell
+(
+    _In_ const HiveVerification& Hive,
+    _In_ const DWORD CellOffset,
+    _Out_ const BYTE*& CellData,
+    _Out_ SIZE_T& CellDataSize
+)
+{
+    CellData = nullptr;
+    CellDataSize = 0;
+
+    if (CellOffset % Regf::Cell::Alignment != 0 || CellOffset >= Hive.BinsDataSize)
+    {
+        return false;
+    }
+
+    const SIZE_T Unit = CellOffset / Regf::Cell::Alignment;
+    if ((Hive.AllocatedCells[Unit / 8] & (1u << (Unit % 8))) == 0)
+    {
+        return false;
+    }
+
+    // cells are only mapped when their size fits in their hive bin
+    const BYTE* Cell = Hive.Bins + CellOffset;
+    CellData = Cell + Regf::Cell::HeaderSize;
+    CellDataSize = static_cast<SIZE_T>(-static_cast<int64_t>(static_cast<LONG>(Regf::ReadDword(Cell)))) - Regf::Cell::HeaderSize;
+    return true;
+}
+
+/// @brief Check that an offset points to an allocated cell of a given kind
+/// @param[in] Hive Hive being checked, with its cells mapped
+/// @param[in] Owner Offset of the cell holding the offset, for the problem
+/// @param[in] Check Name of the check, for the problem
+/// @param[in] Target Offset to check
+/// @param[in] Signature Expected signature of the target cell
+/// @param[in] MinimalSize Minimal size of the target cell data
+/// @param[out] CellData Beginning of the target cell data
+/// @param[out] CellDataSize Size of the target cell data
+/// @param[in,out] Problems Problems found so far
+/// @return true if #Target is an allocated cell of the expected kind
+static bool CheckReference
+(
+    _In_ const HiveVerification& Hive,
+    _In_ const DWORD Owner,
+    _In_ const std::wstring& Check,
+    _In_ const DWORD Target,
+    _In_ const WORD Signature,
+    _In_ const SIZE_T MinimalSize,
+    _Out_ const BYTE*& CellData,
+    _Out_ SIZE_T& CellDataSize,
+    _Inout_ std::vector<HiveProblem>& Problems
+)
+{
+    if (!GetAllocatedCell(Hive, Target, CellData, CellDataSize))
+    {
+        AddProblem(Problems, Owner, Check, L"Offset " + DescribeOffset(Target) + L" is not an allocated cell");
+        return false;
+    }
+
+    if (CellDataSize < std::max<SIZE_T>(MinimalSize, sizeof(WORD)) || Regf::ReadWord(CellData) != Signature)
+    {
+        AddProblem(Problems, Owner, Check, L"Cell " + DescribeOffset(Target) + L" is not of the expected kind");
+        return false;
+    }
+
+    return true;
+}
+
+/// @brief Walk the cells of a hive bin, and map its allocated cells
+/// @param[in,out] Hive Hive being checked, whose map is filled for the hive bin
+/// @param[in] BinOffset Offset of the hive bin
+/// @param[in] BinSize Size of the hive bin
+/// @param[in,out] Problems Problems of the hive bin
+/// @note The walk stops at the first cell with an invalid size, as the next cells cannot be found.
+static void MapBinCells
+(
+    _Inout_ HiveVerification& Hive,
+    _In_ const SIZE_T BinOffset,
+    _In_ const SIZE_T BinSize,
+    _Inout_ std::vector<HiveProblem>& Problems
+)
+{
+    SIZE_T CellOffset = BinOffset + Regf::Bin::HeaderSize;
+
+    while (CellOffset < BinOffset + BinSize)
+    {
+        const LONG RawSize = static_cast<LONG>(Regf::ReadDword(Hive.Bins + CellOffset));
+        const SIZE_T CellSize = static_cast<SIZE_T>(RawSize < 0 ? -static_cast<int64_t>(RawSize) : RawSize);
+
+        if (CellSize < Regf::Cell::Alignment || CellSize % Regf::Cell::Alignment != 0 || CellSize > BinOffset + BinSize - CellOffset)
+        {
+            AddProblem(Problems, static_cast<DWORD>(CellOffset), L"Cell.Size", L"Cell size " + std::to_wstring(CellSize) +
+                L" does not fit in hive bin " + DescribeOffset(static_cast<DWORD>(BinOffset)));
+            return;
+        }
+
+        if (RawSize < 0)
+        {
+            const SIZE_T Unit = CellOffset / Regf::Cell::Alignment;
+            Hive.AllocatedCells[Unit / 8] |= static_cast<BYTE>(1u << (Unit % 8));
+        }
+        CellOffset += CellSize;
+    }
+}
+
+/// @brief Check the name hint of an lf subkey list element
+/// @param[in] Hint Name hint of the element: the first characters of the name, one byte each, null-padded
+/// @param[in] Name Decoded name of the subkey
+/// @return Whether the hint matches the name, regardless of case
+/// @note A hint beginning with a null byte is not used for lookups, and always matches: it is the hint of names with
+///       a character beyond Latin-1 among their first ones.
+static bool MatchesNameHint
+(
+    _In_ const BYTE* Hint,
+    _In_ const std::wstring& Name
+)
+{
+    if (Hint[0] == 0)
+    {
+        return true;
+    }
+
+    for (SIZE_T Index = 0; Index < Regf::SubkeyList::HashElementSize - sizeof(DWORD); ++Index)
+    {
+        const WORD Expected = Index < Name.length() ? static_cast<WORD>(Name[Index]) : 0;
+        if (Expected > 0xFF || Regf::UpcaseCodeUnit(Hint[Index]) != Regf::UpcaseCodeUnit(Expected))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief Check the subkey list of a key node
+/// @param[in] Hive Hive being checked, with its cells mapped
+/// @param[in] KeyOffset Offset of the key node
+/// @param[in] SubkeyCount Count of subkeys of the key node
+/// @param[in] ListOffset Offset of the subkey list of the key node
+/// @param[in,out] Problems Problems found so far
+/// @note Subkeys must point back to the key node, and their names must be strictly increasing through all leaves.
+///       The hashes of lh leaves and the name hints of lf leaves must match the names.
+static void VerifySubkeyList
+(
+    _In_ const HiveVerification& Hive,
+    _In_ const DWORD KeyOffset,
+    _In_ const DWORD SubkeyCount,
+    _In_ const DWORD ListOffset,
+    _Inout_ std::vector<HiveProblem>& Problems
+)
+{
+    const BYTE* List = nullptr;
+    SIZE_T ListSize = 0;
+    std::vector<std::pair<DWORD, const BYTE*>> Leaves;
+    std::wstring PreviousName;
+    std::wstring Name;
+    bool HasPreviousName = false;
+    DWORD FoundCount = 0;
+
+    if (!GetAllocatedCell(Hive, ListOffset, List, ListSize) || ListSize < Regf::SubkeyList::ElementsOffset)
+    {
+        AddProblem(Problems, KeyOffset, L"KeyNode.SubkeyList", L"Offset " + DescribeOffset(ListOffset) + L" is not an allocated subkey list");
+        return;
+    }
+
+    if (Regf::ReadWord(List) == Regf::Cell::IndexRootSignature)
+    {
+        const WORD LeafCount = Regf::ReadWord(List + Regf::SubkeyList::CountOffset);
+        if (LeafCount * Regf::SubkeyList::IndexElementSize > ListSize - Regf::SubkeyList::ElementsOffset)
+        {
+            AddProblem(Problems, ListOffset, L"SubkeyList.Count", L"Leaf count exceeds index root");
+            return;
+        }
+
+        for (WORD LeafIndex = 0; LeafIndex < LeafCount; ++LeafIndex)
+        {
+            const DWORD LeafOffset = Regf::ReadDword(List + Regf::SubkeyList::ElementsOffset + LeafIndex * Regf::SubkeyList::IndexElementSize);
+            const BYTE* Leaf = nullptr;
+            SIZE_T LeafSize = 0;
+            if (!GetAllocatedCell(Hive, LeafOffset, Leaf, LeafSize) || LeafSize < Regf::SubkeyList::ElementsOffset ||
+                (Regf::ReadWord(Leaf) != Regf::Cell::IndexLeafSignature && Regf::ReadWord(Leaf) != Regf::Cell::FastLeafSignature &&
+                 Regf::ReadWord(Leaf) != Regf::Cell::HashLeafSignature))
+            {
+                AddProblem(Problems, ListOffset, L"SubkeyList.Element", L"Offset " + DescribeOffset(LeafOffset) + L" is not an allocated subkey list leaf");
+                continue;
+            }
+            Leaves.emplace_back(LeafOffset, Leaf);
+        }
+    }
+    else if (Regf::ReadWord(List) == Regf::Cell::IndexLeafSignature || Regf::ReadWord(List) == Regf::Cell::FastLeafSignature ||
+        Regf::ReadWord(List) == Regf::Cell::HashLeafSignature)
+    {
+        Leaves.emplace_back(ListOffset, List);
+    }
+    else
+    {
+        AddProblem(Problems, KeyOffset, L"KeyNode.SubkeyList", L"Cell " + DescribeOffset(ListOffset) + L" is not a subkey list");
+        return;
+    }
+
+    for (const std::pair<DWORD, const BYTE*>& Leaf : Leaves)
+    {
+        const WORD Signature = Regf::ReadWord(Leaf.second);
+        const WORD Count = Regf::ReadWord(Leaf.second + Regf::SubkeyList::CountOffset);
+        const SIZE_T ElementSize = Signature == Regf::Cell::IndexLeafSignature ? Regf::SubkeyList::IndexElementSize : Regf::SubkeyList::HashElementSize;
+        const BYTE* LeafData = nullptr;
+        SIZE_T LeafSize = 0;
+
+        static_cast<void>(GetAllocatedCell(Hive, Leaf.first, LeafData, LeafSize));
+        if (Count * ElementSize > LeafSize - Regf::SubkeyList::ElementsOffset)
+        {
+            AddProblem(Problems, Leaf.first, L"SubkeyList.Count", L"Element count exceeds subkey list leaf");
+            continue;
+        }
+        FoundCount += Count;
+
+        for (WORD ElementIndex = 0; ElementIndex < Count; ++ElementIndex)
+        {
+            const BYTE* Element = Leaf.second + Regf::SubkeyList::ElementsOffset + ElementIndex * ElementSize;
+            const DWORD SubkeyOffset = Regf::ReadDword(Element);
+            const BYTE* Subkey = nullptr;
+            SIZE_T SubkeySize = 0;
+
+            if (!CheckReference(Hive, Leaf.first, L"SubkeyList.Element", SubkeyOffset, Regf::Cell::KeyNodeSignature, Regf::KeyNode::NameOffset, Subkey, SubkeySize, Problems))
+            {
+                continue;
+            }
+
+            if (Regf::ReadDword(Subkey + Regf::KeyNode::ParentOffset) != KeyOffset)
+            {
+                AddProblem(Problems, Leaf.first, L"SubkeyList.Parent", L"Subkey " + DescribeOffset(SubkeyOffset) + L" has another parent");
+            }
+
+            // names that exceed their cell are reported with their key node
+            const WORD NameLength = Regf::ReadWord(Subkey + Regf::KeyNode::NameLengthOffset);
+            const bool Compressed = (Regf::ReadWord(Subkey + Regf::KeyNode::FlagsOffset) & Regf::KeyNode::CompressedNameFlag) != 0;
+            if (Regf::KeyNode::NameOffset + NameLength > SubkeySize)
+            {
+                continue;
+            }
+
+            if (Signature == Regf::Cell::HashLeafSignature &&
+                Regf::ReadDword(Element + sizeof(DWORD)) != Regf::NameHash(Subkey + Regf::KeyNode::NameOffset, NameLength, Compressed))
+            {
+                AddProblem(Problems, Leaf.first, L"SubkeyList.Hash", L"Hash of subkey " + DescribeOffset(SubkeyOffset) + L" does not match its name");
+            }
+
+            Regf::DecodeName(Subkey + Regf::KeyNode::NameOffset, NameLength, Compressed, Name);
+            if (Signature == Regf::Cell::FastLeafSignature && !MatchesNameHint(Element + sizeof(DWORD), Name))
+            {
+                AddProblem(Problems, Leaf.first, L"SubkeyList.Hint", L"Name hint of subkey " + DescribeOffset(SubkeyOffset) + L" does not match its name");
+            }
+            if (HasPreviousName && Regf::CompareNames(PreviousName, Name) >= 0)
+            {
+                AddProblem(Problems, Leaf.first, L"SubkeyList.Order", L"Subkey " + DescribeOffset(SubkeyOffset) + L" does not sort after the previous subkey");
+            }
+            std::swap(PreviousName, Name);
+            HasPreviousName = true;
+        }
+    }
+
+    if (FoundCount != SubkeyCount)
+    {
+        AddProblem(Problems, KeyOffset, L"KeyNode.SubkeyCount", L"Subkey count " + std::to_wstring(SubkeyCount) + L" differs from the " +
+            std::to_wstring(FoundCount) + L" subkeys of list " + DescribeOffset(ListOffset));
+    }
+}
+
+/// @brief Check a key node and the cells it points to, save its subkeys
+/// @param[in] Hive Hive being checked, with its cells mapped
+/// @param[in] Offset Offset of the key node
+/// @param[in] RootCellOffset Offset of the root key node, which has no parent
+/// @param[in] Cell Beginning of the cell data
+/// @param[in] CellSize Size of the cell data
+/// @param[in,out] Problems Problems found so far
+static void VerifyKeyNode
+(
+    _In_ const HiveVerification& Hive,
+    _In_ const DWORD Offset,
+    _In_ const DWORD RootCellOffset,
+    _In_ const BYTE* Cell,
+    _In_ const SIZE_T CellSize,
+    _Inout_ std::vector<HiveProblem>& Problems
+)
+{
+    const BYTE* Target = nullptr;
+    SIZE_T TargetSize = 0;
+
+    if (CellSize < Regf::KeyNode::NameOffset)
+    {
+        AddProblem(Problems, Offset, L"KeyNode.Size", L"Key node is truncated");
+        return;
+    }
+
+    if (Regf::KeyNode::NameOffset + Regf::ReadWord(Cell + Regf::KeyNode::NameLengthOffset) > CellSize)
+    {
+        AddProblem(Problems, Offset, L"KeyNode.Name", L"Name exceeds cell");
+    }
+
+    if (Offset != RootCellOffset)
+    {
+        static_cast<void>(CheckReference(Hive, Offset, L"KeyNode.Parent", Regf::ReadDword(Cell + Regf::KeyNode::ParentOffset),
+            Regf::Cell::KeyNodeSignature, Regf::KeyNode::NameOffset, Target, TargetSize, Problems));
+    }
+
+    static_cast<void>(CheckReference(Hive, Offset, L"KeyNode.Security", Regf::ReadDword(Cell + Regf::KeyNode::SecurityOffset),
+        Regf::Cell::SecuritySignature, Regf::Security::DescriptorOffset, Target, TargetSize, Problems));
+
+    const WORD ClassNameLength = Regf::ReadWord(Cell + Regf::KeyNode::ClassNameLengthOffset);
+    const DWORD ClassNameOffset = Regf::ReadDword(Cell + Regf::KeyNode::ClassNameOffset);
+    if (ClassNameLength > 0 && (!GetAllocatedCell(Hive, ClassNameOffset, Target, TargetSize) || ClassNameLength > TargetSize))
+    {
+        AddProblem(Problems, Offset, L"KeyNode.ClassName", L"Offset " + DescribeOffset(ClassNameOffset) + L" is not an allocated cell holding the class name");
+    }
+
+    const DWORD ValueCount = Regf::ReadDword(Cell + Regf::KeyNode::ValueCountOffset);
+    const DWORD ValueListOffset = Regf::ReadDword(Cell + Regf::KeyNode::ValueListOffset);
+    if (ValueCount > 0)
+    {
+        const BYTE* ValueList = nullptr;
+        SIZE_T ValueListSize = 0;
+        if (!GetAllocatedCell(Hive, ValueListOffset, ValueList, ValueListSize))
+        {
+            AddProblem(Problems, Offset, L"KeyNode.ValueList", L"Offset " + DescribeOffset(ValueListOffset) + L" is not an allocated cell");
+        }
+        else if (ValueCount > ValueListSize / sizeof(DWORD))
+        {
+            AddProblem(Problems, Offset, L"KeyNode.ValueCount", L"Value count " + std::to_wstring(ValueCount) + L" exceeds value list " + DescribeOffset(ValueListOffset));
+        }
+        else
+        {
+            for (DWORD ValueIndex = 0; ValueIndex < ValueCount; ++ValueIndex)
+            {
+                static_cast<void>(CheckReference(Hive, ValueListOffset, L"ValueList.Element", Regf::ReadDword(ValueList + ValueIndex * sizeof(DWORD)),
+                    Regf::Cell::ValueSignature, Regf::Value::NameOffset, Target, TargetSize, Problems));
+            }
+        }
+    }
+
+    const DWORD SubkeyCount = Regf::ReadDword(Cell + Regf::KeyNode::SubkeyCountOffset);
+    if (SubkeyCount > 0)
+    {
+        VerifySubkeyList(Hive, Offset, SubkeyCount, Regf::ReadDword(Cell + Regf::KeyNode::SubkeyListOffset), Problems);
+    }
+}
+
+/// @brief Check a value and its data cells
+/// @param[in] Hive Hive being checked, with its cells mapped
+/// @param[in] Offset Offset of the value
+/// @param[in] Cell Beginning of the cell data
+/// @param[in] CellSize Size of the cell data
+/// @param[in,out] Problems Problems found so far
+static void VerifyValue
+(
+    _In_ const HiveVerification& Hive,
+    _In_ const DWORD Offset,
+    _In_ const BYTE* Cell,
+    _In_ const SIZE_T CellSize,
+    _Inout_ std::vector<HiveProblem>& Problems
+)
+{
+    const BYTE* Data = nullptr;
+    SIZE_T DataCellSize = 0;
+
+    if (CellSize < Regf::Value::NameOffset)
+    {
+        AddProblem(Problems, Offset, L"Value.Size", L"Value is truncated");
+        return;
+    }
+
+    if (Regf::Value::NameOffset + Regf::ReadWord(Cell + Regf::Value::NameLengthOffset) > CellSize)
+    {
+        AddProblem(Problems, Offset, L"Value.Name", L"Name exceeds cell");
+    }
+
+    const DWORD RawDataSize = Regf::ReadDword(Cell + Regf::Value::DataSizeOffset);
+    const DWORD DataSize = RawDataSize & ~Regf::Value::InlineDataFlag;
+    const DWORD DataOffset = Regf::ReadDword(Cell + Regf::Value::DataOffset);
+
+    if ((RawDataSize & Regf::Value::InlineDataFlag) != 0)
+    {
+        if (DataSize > Regf::Value::InlineDataMaximalSize)
+        {
+            AddProblem(Problems, Offset, L"Value.Data", L"Inline data size " + std::to_wstring(DataSize) + L" exceeds data offset");
+        }
+        return;
+    }
+
+    if (DataSize == 0)
+    {
+        return;
+    }
+
+    if (DataSize <= Regf::BigData::SegmentSize || Hive.MinorVersion < Regf::BaseBlock::BigDataMinorVersion)
+    {
+        if (!GetAllocatedCell(Hive, DataOffset, Data, DataCellSize))
+        {
+            AddProblem(Problems, Offset, L"Value.Data", L"Offset " + DescribeOffset(DataOffset) + L" is not an allocated cell");
+        }
+        else if (DataSize > DataCellSize)
+        {
+            AddProblem(Problems, Offset, L"Value.Data", L"Data size " + std::to_wstring(DataSize) + L" exceeds data cell " + DescribeOffset(DataOffset));
+        }
+        return;
+    }
+
+    if (!CheckReference(Hive, Offset, L"Value.Data", DataOffset, Regf::Cell::BigDataSignature, Regf::BigData::SegmentListOffset + sizeof(DWORD), Data, DataCellSize, Problems))
+    {
+        return;
+    }
+
+    const WORD SegmentCount = Regf::ReadWord(Data + Regf::BigData::SegmentCountOffset);
+    const DWORD SegmentListOffset = Regf::ReadDword(Data + Regf::BigData::SegmentListOffset);
+    const BYTE* SegmentList = nullptr;
+    SIZE_T SegmentListSize = 0;
+
+    if (!GetAllocatedCell(Hive, SegmentListOffset, SegmentList, SegmentListSize))
+    {
+        AddProblem(Problems, DataOffset, L"BigData.SegmentList", L"Offset " + DescribeOffset(SegmentListOffset) + L" is not an allocated cell");
+        return;
+    }
+    if (SegmentCount > SegmentListSize / sizeof(DWORD))
+    {
+        AddProblem(Problems, DataOffset, L"BigData.SegmentCount", L"Segment count " + std::to_wstring(SegmentCount) + L" exceeds segment list " + DescribeOffset(SegmentListOffset));
+        return;
+    }
+    if (SegmentCount < (DataSize + Regf::BigData::SegmentSize - 1) / Regf::BigData::SegmentSize)
+    {
+        AddProblem(Problems, DataOffset, L"BigData.SegmentCount", L"Segment count " + std::to_wstring(SegmentCount) + L" is too small for data size " + std::to_wstring(DataSize));
+    }
+
+    DWORD Remaining = DataSize;
+    for (WORD SegmentIndex = 0; SegmentIndex < SegmentCount && Remaining > 0; ++SegmentIndex)
+    {
+        const DWORD SegmentOffset = Regf::ReadDword(SegmentList + SegmentIndex * sizeof(DWORD));
+        const DWORD Expected = std::min(Remaining, Regf::BigData::SegmentSize);
+        const BYTE* Segment = nullptr;
+        SIZE_T SegmentSize = 0;
+
+        if (!GetAllocatedCell(Hive, SegmentOffset, Segment, SegmentSize))
+        {
+            AddProblem(Problems, SegmentListOffset, L"BigData.Segment", L"Offset " + DescribeOffset(SegmentOffset) + L" is not an allocated cell");
+        }
+        else if (SegmentSize < Expected)
+        {
+            AddProblem(Problems, SegmentListOffset, L"BigData.Segment", L"Segment " + DescribeOffset(SegmentOffset) + L" is shorter than " + std::to_wstring(Expected) + L" bytes");
+        }
+        Remaining -= Expected;
+    }
+}
+
+/// @brief Check the key nodes and values of a hive bin
+/// @param[in] Hive Hive being checked, with all its cells mapped
+/// @param[in] RootCellOffset Offset of the root key node
+/// @param[in] BinOffset Offset of the hive bin
+/// @param[in] BinSize Size of the hive bin
+/// @param[in,out] Problems Problems of the hive bin
+/// @note Other cells are checked through the key nodes and values pointing to them.
+static void VerifyBinCells
+(
+    _In_ const HiveVerification& Hive,
+    _In_ const DWORD RootCellOffset,
+    _In_ const SIZE_T BinOffset,
+    _In_ const SIZE_T BinSize,
+    _Inout_ std::vector<HiveProblem>& Problems
+)
+{
+    for (SIZE_T CellOffset = BinOffset + Regf::Bin::HeaderSize; CellOffset < BinOffset + BinSize; CellOffset += Regf::Cell::Alignment)
+    {
+        const BYTE* Cell = nullptr;
+        SIZE_T CellSize = 0;
+
+        if (!GetAllocatedCell(Hive, static_cast<DWORD>(CellOffset), Cell, CellSize) || CellSize < sizeof(WORD))
+        {
+            continue;
+        }
+
+        if (Regf::ReadWord(Cell) == Regf::Cell::KeyNodeSignature)
+        {
+            VerifyKeyNode(Hive, static_cast<DWORD>(CellOffset), RootCellOffset, Cell, CellSize, Problems);
+        }
+        else if (Regf::ReadWord(Cell) == Regf::Cell::ValueSignature)
+        {
+            VerifyValue(Hive, static_cast<DWORD>(CellOffset), Cell, CellSize, Problems);
+        }
+    }
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT VerifyHive
+(
+    _In_ const std::wstring& HiveFilePath,
+    _In_ const SIZE_T ThreadCount,
+    _Out_ std::vector<HiveProblem>& Problems
+)
+{
+    HRESULT Result = E_FAIL;
+    MappedFile File;
+    std::vector<BYTE> GrownImage;
+    const BYTE* Data = nullptr;
+    SIZE_T Size = 0;
+    HiveVerification Hive;
+    std::vector<std::pair<SIZE_T, SIZE_T>> Bins;
+    std::vector<std::vector<HiveProblem>> BinProblems;
+
+    Problems.clear();
+
+    Result = File.Open(HiveFilePath);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Loading hive file " + HiveFilePath);
+        return Result;
+    }
+    Data = File.Data();
+    Size = File.Size();
+
+    if (Size < Regf::BaseBlock::Size)
+    {
+        AddProblem(Problems, Regf::Cell::NullOffset, L"BaseBlock.Size", L"Hive is smaller than its base block");
+        return S_OK;
+    }
+    if (Regf::ReadDword(Data + Regf::BaseBlock::SignatureOffset) != Regf::BaseBlock::Signature)
+    {
+        AddProblem(Problems, Regf::Cell::NullOffset, L"BaseBlock.Signature", L"Hive does not begin with regf signature");
+        return S_OK;
+    }
+
+    // conversions replay the logs of dirty hives: what is left dirty is reported below
+    if (IsHiveImageDirty(Data, Size))
+    {
+        Result = File.Open(HiveFilePath, true);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Loading dirty hive file " + HiveFilePath);
+            return Result;
+        }
+
+        Result = ReplayHiveLogs(HiveFilePath, File, GrownImage, Data, Size);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Replaying transaction logs of hive file " + HiveFilePath);
+            return Result;
+        }
+    }
+
+    if (Regf::ReadDword(Data + Regf::BaseBlock::ChecksumOffset) != Regf::BaseBlockChecksum(Data))
+    {
+        AddProblem(Problems, Regf::Cell::NullOffset, L"BaseBlock.Checksum", L"Base block checksum mismatch");
+    }
+    if (Regf::ReadDword(Data + Regf::BaseBlock::PrimarySequenceOffset) != Regf::ReadDword(Data + Regf::BaseBlock::SecondarySequenceOffset))
+    {
+        AddProblem(Problems, Regf::Cell::NullOffset, L"BaseBlock.Sequence", L"Sequence numbers differ, and no transaction log completes the last write");
+    }
+    if (Regf::ReadDword(Data + Regf::BaseBlock::MajorVersionOffset) != Regf::BaseBlock::MajorVersion)
+    {
+        AddProblem(Problems, Regf::Cell::NullOffset, L"BaseBlock.Version", L"Unsupported major version " + std::to_wstring(Regf::ReadDword(Data + Regf::BaseBlock::MajorVersionOffset)));
+    }
+    if (Regf::ReadDword(Data + Regf::BaseBlock::FileTypeOffset) != Regf::BaseBlock::PrimaryFileType)
+    {
+        AddProblem(Problems, Regf::Cell::NullOffset, L"BaseBlock.FileType", L"File is not a primary hive file");
+    }
+
+    // the bins that fit in the file are still checked when the base block has a wrong size
+    Hive.Bins = Data + Regf::BaseBlock::Size;
+    Hive.BinsDataSize = Regf::ReadDword(Data + Regf::BaseBlock::BinsDataSizeOffset);
+    Hive.MinorVersion = Regf::ReadDword(Data + Regf::BaseBlock::MinorVersionOffset);
+    if (Hive.BinsDataSize % Regf::Bin::Alignment != 0 || Hive.BinsDataSize > Size - Regf::BaseBlock::Size)
+    {
+        AddProblem(Problems, Regf::Cell::NullOffset, L"BaseBlock.BinsDataSize", L"Hive bins data size " + std::to_wstring(Hive.BinsDataSize) +
+            L" is not a multiple of the hive bin alignment within the file");
+        Hive.BinsDataSize = std::min(Hive.BinsDataSize, Size - Regf::BaseBlock::Size);
+        Hive.BinsDataSize -= Hive.BinsDataSize % Regf::Bin::Alignment;
+    }
+
+    // hive bins are found one after the other through their headers, which are all that is read sequentially
+    for (SIZE_T BinOffset = 0; BinOffset < Hive.BinsDataSize; )
+    {
+        const BYTE* Bin = Hive.Bins + BinOffset;
+        const SIZE_T BinSize = Regf::ReadDword(Bin + Regf::Bin::SizeOffset);
+
+        if (Regf::ReadDword(Bin + Regf::Bin::SignatureOffset) != Regf::Bin::Signature)
+        {
+            AddProblem(Problems, static_cast<DWORD>(BinOffset), L"Bin.Signature", L"Hive bin does not begin with hbin signature");
+            break;
+        }
+        if (Regf::ReadDword(Bin + Regf::Bin::OffsetOffset) != BinOffset)
+        {
+            AddProblem(Problems, static_cast<DWORD>(BinOffset), L"Bin.Offset", L"Hive bin records offset " + DescribeOffset(Regf::ReadDword(Bin + Regf::Bin::OffsetOffset)));
+        }
+        if (BinSize == 0 || BinSize % Regf::Bin::Alignment != 0 || BinSize > Hive.BinsDataSize - BinOffset)
+        {
+            AddProblem(Problems, static_cast<DWORD>(BinOffset), L"Bin.Size", L"Hive bin size " + std::to_wstring(BinSize) + L" does not fit in hive bins data");
+            break;
+        }
+
+        Bins.emplace_back(BinOffset, BinSize);
+        BinOffset += BinSize;
+    }
+
+    Hive.AllocatedCells.resize((Hive.BinsDataSize / Regf::Cell::Alignment + 7) / 8);
+    BinProblems.resize(Bins.size());
+
+    // all cells are mapped before any is checked, as offsets point anywhere in the hive
+    Result = RunParallelTasks(Bins.size(), ThreadCount, [&](SIZE_T BinIndex) -> HRESULT
+    {
+        MapBinCells(Hive, Bins[BinIndex].first, Bins[BinIndex].second, BinProblems[BinIndex]);
+        return S_OK;
+    });
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    const DWORD RootCellOffset = Regf::ReadDword(Data + Regf::BaseBlock::RootCellOffset);
+    Result = RunParallelTasks(Bins.size(), ThreadCount, [&](SIZE_T BinIndex) -> HRESULT
+    {
+        VerifyBinCells(Hive, RootCellOffset, Bins[BinIndex].first, Bins[BinIndex].second, BinProblems[BinIndex]);
+        return S_OK;
+    });
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    const BYTE* Root = nullptr;
+    SIZE_T RootSize = 0;
+    static_cast<void>(CheckReference(Hive, Regf::Cell::NullOffset, L"BaseBlock.RootCell", RootCellOffset,
+        Regf::Cell::KeyNodeSignature, Regf::KeyNode::NameOffset, Root, RootSize, Problems));
+
+    for (std::vector<HiveProblem>& Bin : BinProblems)
+    {
+        Problems.insert(Problems.end(), std::make_move_iterator(Bin.begin()), std::make_move_iterator(Bin.end()));
+    }
+
+    // the base block comes first, as its offset wraps to zero
+    std::stable_sort(Problems.begin(), Problems.end(), [](const HiveProblem& Left, const HiveProblem& Right)
+    {
+        return Left.Offset + 1 < Right.Offset + 1;
+    });
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+void RenderHiveProblems
+(
+    _In_ const std::wstring& HiveFilePath,
+    _In_ const std::vector<HiveProblem>& Problems,
+    _Out_ std::wstring& Output
+)
+{
+    Output.clear();
+
+    for (const HiveProblem& Problem : Problems)
+    {
+        Output += HiveFilePath;
+        Output += L'\t';
+        Output += Problem.Check;
+        Output += L'\t';
+        Output += Problem.Offset == Regf::Cell::NullOffset ? std::wstring{ L"-" } : DescribeOffset(Problem.Offset);
+        Output += L'\t';
+        Output += Problem.Detail;
+        Output += Constants::RegFiles::NewLines;
+    }
+}
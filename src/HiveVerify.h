@@ -0,0 +1,54 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include "RegfFormat.h"
+#include <string>
+#include <vector>
+
+/// Problem found in the structure of a hive
+struct HiveProblem {
+    /// Offset of the hive bin or cell holding the problem, relative to the first hive bin.
+    /// Regf::Cell::NullOffset for the base block.
+    DWORD Offset = Regf::Cell::NullOffset;
+
+    /// Name of the failed check, as Structure.Field (e.g. SubkeyList.Order)
+    std::wstring Check;
+
+    /// Description of the problem. Names found in the hive are left out, only offsets are given.
+    std::wstring Detail;
+};
+
+/// @brief Check the structure of a hive file
+/// @param[in] HiveFilePath Path to the registry hive
+/// @param[in] ThreadCount Maximal count of threads checking hive bins
+/// @param[out] Problems Problems found, sorted by offset, the base block first
+/// @return HRESULT semantics: S_OK once the hive was checked, even if it has problems
+/// @note Checked are the base block (signature, checksum, sequence numbers, version, type, size), the hive bin
+///       headers, the cell sizes, and every offset held by key nodes and values, which must point to allocated
+///       cells of the expected kind: parent, subkey lists (count, sort order, hashes, name hints), value lists (count),
+///       security, class name, value data and big data segments.
+/// @note Hive bins are walked by their headers, then their cells are mapped and checked by #ThreadCount threads.
+///       The problems do not depend on the count of threads.
+/// @note A dirty hive is checked once its transaction logs are replayed in memory, as when it is converted.
+_Must_inspect_result_
+HRESULT VerifyHive
+(
+    _In_ const std::wstring& HiveFilePath,
+    _In_ const SIZE_T ThreadCount,
+    _Out_ std::vector<HiveProblem>& Problems
+);
+
+/// @brief Render the problems of a hive as tab-separated lines
+/// @param[in] HiveFilePath Path to the registry hive, in the first column of each line
+/// @param[in] Problems Problems of the hive
+/// @param[out] Output One line per problem: hive path, check, offset (0x%08x, or - for the base block), description
+void RenderHiveProblems
+(
+    _In_ const std::wstring& HiveFilePath,
+    _In_ const std::vector<HiveProblem>& Problems,
+    _Out_ std::wstring& Output
+);
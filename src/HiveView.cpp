@@ -0,0 +1,245 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "HiveView.h"
+#include "CommonFunctions.h"
+#include "Constants.h"
+#include "HiveLog.h"
+#include <algorithm>
+#include <utility>
+
+/// @brief Append the paths of the subkeys of a key, and of the keys below them
+/// @param[in] Image Accessor over the hive image
+/// @param[in] Node Key node of the key
+/// @param[in] Depth Depth of the key below the hive root, to bound recursion on corrupted hives
+/// @param[in] KeyPath Path to the key relative to the hive root
+/// @param[in,out] KeyPaths Paths to which the paths of the subkeys are appended
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT ListSubkeys
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const SIZE_T Depth,
+    _In_ const std::wstring& KeyPath,
+    _Inout_ std::vector<std::wstring>& KeyPaths
+)
+{
+    HRESULT Result = E_FAIL;
+    std::vector<DWORD> SubkeyOffsets;
+    std::vector<std::pair<std::wstring, HiveKeyNode>> Subkeys;
+
+    if (Depth > Constants::Hives::MaximalKeyDepth)
+    {
+        ReportError(E_UNEXPECTED, L"Key tree is too deep - Current key path: " + KeyPath);
+        return E_UNEXPECTED;
+    }
+
+    Result = GetSubkeyOffsets(Image, Node, SubkeyOffsets);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Getting subkey list - Current key path: " + KeyPath);
+        return Result;
+    }
+
+    for (const DWORD SubkeyOffset : SubkeyOffsets)
+    {
+        std::pair<std::wstring, HiveKeyNode>& Subkey = Subkeys.emplace_back();
+        Result = GetKeyNode(Image, SubkeyOffset, Subkey.second);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Getting subkey - Current key path: " + KeyPath);
+            return Result;
+        }
+        Regf::DecodeName(Subkey.second.Name, Subkey.second.NameLength, Subkey.second.HasCompressedName(), Subkey.first);
+        if (!KeyPath.empty())
+        {
+            Subkey.first.insert(0, KeyPath + Constants::RegFiles::PathSeparator);
+        }
+    }
+
+    // subkey lists are sorted already, save in corrupted hives
+    std::sort(Subkeys.begin(), Subkeys.end(), [](const std::pair<std::wstring, HiveKeyNode>& Left, const std::pair<std::wstring, HiveKeyNode>& Right)
+    {
+        return Regf::CompareNames(Left.first, Right.first) < 0;
+    });
+
+    for (const std::pair<std::wstring, HiveKeyNode>& Subkey : Subkeys)
+    {
+        KeyPaths.push_back(Subkey.first);
+        Result = ListSubkeys(Image, Subkey.second, Depth + 1, Subkey.first, KeyPaths);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveView::Open
+(
+    _In_ const std::wstring& HiveFilePath
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* Data = nullptr;
+    SIZE_T Size = 0;
+
+    GrownImage.clear();
+
+    Result = File.Open(HiveFilePath);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Loading hive file " + HiveFilePath);
+        return Result;
+    }
+    Data = File.Data();
+    Size = File.Size();
+
+    if (IsHiveImageDirty(Data, Size))
+    {
+        // clean hives keep a read-only mapping, that commits no memory
+        Result = File.Open(HiveFilePath, true);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Loading dirty hive file " + HiveFilePath);
+            return Result;
+        }
+
+        Result = ReplayHiveLogs(HiveFilePath, File, GrownImage, Data, Size);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Replaying transaction logs of hive file " + HiveFilePath);
+            return Result;
+        }
+        if (Result == S_FALSE)
+        {
+            // only a log could have repaired a base block that fails its checksum
+            if (Regf::ReadDword(Data + Regf::BaseBlock::ChecksumOffset) != Regf::BaseBlockChecksum(Data))
+            {
+                Result = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                ReportError(Result, L"Base block of hive file " + HiveFilePath + L" is corrupted, and no transaction log can repair it");
+                return Result;
+            }
+            ReportWarning(L"Hive file " + HiveFilePath + L" is dirty, but has no transaction log to replay: it is read as is");
+        }
+    }
+
+    Result = OpenHiveImage(Data, Size, Accessor);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Reading base block of hive file " + HiveFilePath);
+        return Result;
+    }
+
+    Result = GetKeyNode(Accessor, Accessor.RootCellOffset, Root);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Reading root key of hive file " + HiveFilePath);
+        return Result;
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveView::OpenKey
+(
+    _In_ const std::wstring_view KeyPath,
+    _Out_ HiveKeyNode& Key,
+    _Out_opt_ std::wstring* StoredPath
+) const
+{
+    HRESULT Result = E_FAIL;
+    SIZE_T NameStart = 0;
+    std::wstring NameBuffer;
+
+    Key = Root;
+    if (StoredPath != nullptr)
+    {
+        StoredPath->clear();
+    }
+
+    if (KeyPath.empty())
+    {
+        return S_OK;
+    }
+
+    while (true)
+    {
+        const SIZE_T NameEnd = KeyPath.find(Constants::RegFiles::PathSeparator, NameStart);
+        const std::wstring_view Name = KeyPath.substr(NameStart, NameEnd == KeyPath.npos ? KeyPath.npos : NameEnd - NameStart);
+        if (Name.empty())
+        {
+            return E_INVALIDARG;
+        }
+
+        HiveKeyNode Subkey;
+        Result = FindSubkey(Accessor, Key, Name, Subkey);
+        if (FAILED(Result))
+        {
+            Key = HiveKeyNode{};
+            if (StoredPath != nullptr)
+            {
+                StoredPath->clear();
+            }
+            return Result;
+        }
+        Key = Subkey;
+
+        if (StoredPath != nullptr)
+        {
+            Regf::DecodeName(Key.Name, Key.NameLength, Key.HasCompressedName(), NameBuffer);
+            if (!StoredPath->empty())
+            {
+                *StoredPath += Constants::RegFiles::PathSeparator;
+            }
+            *StoredPath += NameBuffer;
+        }
+
+        if (NameEnd == KeyPath.npos)
+        {
+            break;
+        }
+        NameStart = NameEnd + 1;
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveView::ListKeys
+(
+    _In_ const std::wstring_view KeyPath,
+    _Out_ std::vector<std::wstring>& KeyPaths
+) const
+{
+    HRESULT Result = E_FAIL;
+    HiveKeyNode Key;
+    std::wstring StoredPath;
+
+    KeyPaths.clear();
+
+    // paths are listed as stored, as the index lists them
+    Result = OpenKey(KeyPath, Key, &StoredPath);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    KeyPaths.push_back(StoredPath);
+    Result = ListSubkeys(Accessor, Key, 0, StoredPath, KeyPaths);
+    if (FAILED(Result))
+    {
+        KeyPaths.clear();
+        return Result;
+    }
+
+    return S_OK;
+}
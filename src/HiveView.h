@@ -0,0 +1,87 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include "HiveImage.h"
+#include "MappedFile.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Read-only view of a hive file mapped in memory.
+/// Keys and values are handled through their decoded cells (#HiveKeyNode, #HiveValueNode), which point into the
+/// mapping: names and data are only decoded when they are used, and are not copied save for big data.
+/// @note A view may be read by several threads at once.
+class HiveView {
+public:
+    HiveView() = default;
+
+    HiveView(const HiveView&) = delete;
+    HiveView& operator=(const HiveView&) = delete;
+
+    /// @brief Map a hive file and locate its root key
+    /// @param[in] HiveFilePath Path to the registry hive
+    /// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if the base block fails its checksum and no
+    ///         transaction log can repair it
+    /// @note The hive file is neither loaded by the system nor modified.
+    /// @note When the hive is dirty, as when copied from a running system, its transaction logs are replayed
+    ///       with #ReplayHiveLogs into a copy-on-write mapping: the view is consistent, and no file is modified.
+    ///       Without a log to replay, a hive whose base block is sound is read as is.
+    _Must_inspect_result_
+    HRESULT Open
+    (
+        _In_ const std::wstring& HiveFilePath
+    );
+
+    /// @brief Get the accessor over the hive image, valid as long as the view
+    const HiveImage& Image() const { return Accessor; }
+
+    /// @brief Get the key node of the hive root
+    const HiveKeyNode& RootKey() const { return Root; }
+
+    /// @brief Resolve the path to a key
+    /// @param[in] KeyPath Path to the key relative to the hive root, with names separated by backslashes.
+    ///                    Empty for the hive root.
+    /// @param[out] Key Key node of the key
+    /// @param[out] StoredPath Path to the key with the names as stored in the hive, which may differ in case from
+    ///                        #KeyPath. Optional.
+    /// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no such key,
+    ///         E_INVALIDARG if #KeyPath has an empty name
+    /// @note Each name is looked up with #FindSubkey: the siblings of the keys along the path are not enumerated.
+    _Must_inspect_result_
+    HRESULT OpenKey
+    (
+        _In_ const std::wstring_view KeyPath,
+        _Out_ HiveKeyNode& Key,
+        _Out_opt_ std::wstring* StoredPath = nullptr
+    ) const;
+
+    /// @brief List the paths of a key and of all the keys below it
+    /// @param[in] KeyPath Path to the key relative to the hive root, empty for the hive root
+    /// @param[out] KeyPaths Paths relative to the hive root, each key followed by its subkeys sorted by name.
+    ///                      Names are as stored in the hive, whatever their case in #KeyPath.
+    /// @return HRESULT semantics: HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no such key
+    /// @note The whole subtree is walked: #HiveIndex::ListKeys lists it from an index instead.
+    _Must_inspect_result_
+    HRESULT ListKeys
+    (
+        _In_ const std::wstring_view KeyPath,
+        _Out_ std::vector<std::wstring>& KeyPaths
+    ) const;
+
+private:
+    /// Mapping of the hive file
+    MappedFile File;
+
+    /// Copy of the hive file, only when replaying its logs grew it beyond the file
+    std::vector<BYTE> GrownImage;
+
+    /// Accessor over the mapping
+    HiveImage Accessor;
+
+    /// Key node of the hive root
+    HiveKeyNode Root;
+};
@@ -0,0 +1,122 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "InputFile.h"
+#include "CommonFunctions.h"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+InputFile::~InputFile()
+{
+    Close();
+}
+
+_Must_inspect_result_
+HRESULT InputFile::Open
+(
+    _In_ const std::wstring& FilePath
+)
+{
+    HRESULT Result = E_FAIL;
+
+    Close();
+
+#ifdef _WIN32
+    FileHandle = CreateFileW(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+    {
+        Result = HRESULT_FROM_WIN32(GetLastError());
+        ReportError(Result, L"Could not open file " + FilePath + L" for reading");
+        return Result;
+    }
+#else
+    FileDescriptor = open(PathToUtf8(FilePath).c_str(), O_RDONLY | O_CLOEXEC);
+    if (FileDescriptor == -1)
+    {
+        Result = HRESULT_FROM_WIN32(errno);
+        ReportError(Result, L"Could not open file " + FilePath + L" for reading");
+        return Result;
+    }
+#endif
+
+    return S_OK;
+}
+
+_Must_inspect_result_
+HRESULT InputFile::Read
+(
+    _Out_ void* Buffer,
+    _In_ const SIZE_T Size,
+    _Out_ SIZE_T& BytesRead
+)
+{
+    HRESULT Result = E_FAIL;
+
+    BytesRead = 0;
+
+#ifdef _WIN32
+    if (FileHandle == INVALID_HANDLE_VALUE)
+    {
+        ReportError(E_HANDLE, L"Invalid parameter");
+        return E_HANDLE;
+    }
+
+    const DWORD BytesToRead = static_cast<DWORD>(std::min<SIZE_T>(Size, MAXDWORD));
+    DWORD BytesReadFromFile = 0;
+    if (!ReadFile(FileHandle, Buffer, BytesToRead, &BytesReadFromFile, NULL))
+    {
+        Result = HRESULT_FROM_WIN32(GetLastError());
+        ReportError(Result, L"Could not read from input file");
+        return Result;
+    }
+    BytesRead = BytesReadFromFile;
+#else
+    if (FileDescriptor == -1)
+    {
+        ReportError(E_HANDLE, L"Invalid parameter");
+        return E_HANDLE;
+    }
+
+    while (true)
+    {
+        const ssize_t BytesReadFromFile = read(FileDescriptor, Buffer, Size);
+        if (BytesReadFromFile < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Result = HRESULT_FROM_WIN32(errno);
+            ReportError(Result, L"Could not read from input file");
+            return Result;
+        }
+        BytesRead = static_cast<SIZE_T>(BytesReadFromFile);
+        break;
+    }
+#endif
+
+    return S_OK;
+}
+
+void InputFile::Close()
+{
+#ifdef _WIN32
+    if (FileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(FileHandle);
+        FileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (FileDescriptor != -1)
+    {
+        close(FileDescriptor);
+        FileDescriptor = -1;
+    }
+#endif
+}
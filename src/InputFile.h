@@ -0,0 +1,52 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <string>
+
+/// File opened for sequential reading
+class InputFile {
+public:
+    InputFile() = default;
+    ~InputFile();
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    /// @brief Open an existing file for reading
+    /// @param[in] FilePath Path to the file
+    /// @return HRESULT semantics
+    _Must_inspect_result_
+    HRESULT Open
+    (
+        _In_ const std::wstring& FilePath
+    );
+
+    /// @brief Read the next bytes of the file
+    /// @param[out] Buffer Destination of the bytes
+    /// @param[in] Size Maximal count of bytes to read
+    /// @param[out] BytesRead Count of bytes actually read. May be less than #Size; zero means end of file.
+    /// @return HRESULT semantics
+    _Must_inspect_result_
+    HRESULT Read
+    (
+        _Out_ void* Buffer,
+        _In_ const SIZE_T Size,
+        _Out_ SIZE_T& BytesRead
+    );
+
+    /// @brief Close the file, if any
+    void Close();
+
+private:
+#ifdef _WIN32
+    /// Handle to the opened file
+    HANDLE FileHandle = INVALID_HANDLE_VALUE;
+#else
+    /// Descriptor of the opened file
+    int FileDescriptor = -1;
+#endif
+};
@@ -4,193 +4,846 @@
 
 #include "Conversions.h"
 #include "CommonFunctions.h"
-#include <sstream>
-#include <iomanip>
 #include "Constants.h"
-#include <windows.h>
-#include <winternl.h>
-
-static HMODULE NtDllModuleHandle = nullptr;
-static NTSTATUS(*NtSetValueKey)(
-    _In_     HANDLE          KeyHandle,
-    _In_     PUNICODE_STRING ValueName,
-    _In_opt_ ULONG           TitleIndex,
-    _In_     ULONG           Type,
-    _In_opt_ PVOID           Data,
-    _In_     ULONG           DataSize
-) = nullptr;
+#include "FlatRegistryTree.h"
+#include "OutputFile.h"
+#include "RegfFormat.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
 
+/// Self-relative security descriptor shared by all keys of generated hives.
+/// Owner is Administrators, group is SYSTEM, and full access is granted to SYSTEM, Administrators and Everyone,
+/// inherited by subkeys. Access to the hive itself is controlled by the permissions of the hive file.
+static const BYTE DefaultSecurityDescriptor[] = {
+    // revision, control (SE_SELF_RELATIVE | SE_DACL_PRESENT), owner, group, SACL and DACL offsets
+    0x01, 0x00, 0x04, 0x80, 0x5C, 0x00, 0x00, 0x00, 0x6C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00,
+    // DACL header: revision, size, 3 ACEs
+    0x02, 0x00, 0x48, 0x00, 0x03, 0x00, 0x00, 0x00,
+    // ACCESS_ALLOWED_ACE, CONTAINER_INHERIT_ACE, KEY_ALL_ACCESS, S-1-5-18 (SYSTEM)
+    0x00, 0x02, 0x14, 0x00, 0x3F, 0x00, 0x0F, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x12, 0x00, 0x00, 0x00,
+    // ACCESS_ALLOWED_ACE, CONTAINER_INHERIT_ACE, KEY_ALL_ACCESS, S-1-5-32-544 (Administrators)
+    0x00, 0x02, 0x18, 0x00, 0x3F, 0x00, 0x0F, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 0x20, 0x02, 0x00, 0x00,
+    // ACCESS_ALLOWED_ACE, CONTAINER_INHERIT_ACE, KEY_ALL_ACCESS, S-1-1-0 (Everyone)
+    0x00, 0x02, 0x14, 0x00, 0x3F, 0x00, 0x0F, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+    // owner: S-1-5-32-544 (Administrators)
+    0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 0x20, 0x02, 0x00, 0x00,
+    // group: S-1-5-18 (SYSTEM)
+    0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x12, 0x00, 0x00, 0x00,
+};
+
+/// Offsets of the cells describing a registry key
+struct KeyCells {
+    /// Key node (nk) cell
+    DWORD KeyNode = Regf::Cell::NullOffset;
+
+    /// Value list cell, if the key has values
+    DWORD ValueList = Regf::Cell::NullOffset;
+
+    /// Subkey list cell (lh leaf or ri index root), if the key has subkeys
+    DWORD SubkeyList = Regf::Cell::NullOffset;
+};
+
+/// Offsets of the cells describing a registry value
+struct ValueCells {
+    /// Value (vk) cell
+    DWORD Value = Regf::Cell::NullOffset;
+
+    /// Data cell or big data (db) cell, if the data is not stored inline
+    DWORD Data = Regf::Cell::NullOffset;
+};
+
+/// State of the hive writer.
+/// The flat tree is scanned twice in the exact same order: the layout pass only assigns cell offsets, then the
+/// emission pass fills the cells, which are known to land at the same offsets, and writes hive bins sequentially.
+struct HiveWriterState {
+    /// Whether this is the emission pass
+    bool Emitting = false;
+
+    /// Destination of the emission pass
+    OutputFile* File = nullptr;
+
+    /// Last write time of all keys, as a FILETIME
+    ULONGLONG Timestamp = 0;
+
+    /// Offset of the current hive bin, relative to the hive bins data
+    ULONGLONG BinOffset = 0;
+
+    /// Size of the current hive bin, 0 when no bin is opened
+    ULONGLONG BinSize = 0;
+
+    /// Offset of the next cell in the current hive bin
+    ULONGLONG NextCellOffset = 0;
+
+    /// Contents of the current hive bin, during the emission pass
+    std::vector<BYTE> Bin;
+
+    /// Offset of the security (sk) cell shared by all keys
+    DWORD SecurityOffset = Regf::Cell::NullOffset;
+
+    /// Cells of all keys, indexed as the keys of the flat tree, filled by the layout pass
+    std::vector<KeyCells> Keys;
+
+    /// Cells of all values, indexed as the values of the flat tree, filled by the layout pass
+    std::vector<ValueCells> Values;
+
+    /// Scratch buffer for encoded names
+    std::vector<BYTE> NameBuffer;
+
+    /// Scratch buffer for the indexes of the subkeys of a key, sorted as in subkey lists
+    std::vector<SIZE_T> SortedSubkeys;
+};
+
+/// @brief Get the current time as a FILETIME
+/// @return Count of 100-nanosecond intervals since January 1, 1601 (UTC)
+static ULONGLONG CurrentFileTime()
+{
+    static const ULONGLONG UnixEpochAsFileTime = 116444736000000000ull;
+    const auto SinceUnixEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return UnixEpochAsFileTime + static_cast<ULONGLONG>(std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10000000>>>(SinceUnixEpoch).count());
+}
+
+/// @brief Get the path of a key of a flat tree, for error messages
+/// @param[in] Tree Flat registry tree
+/// @param[in] KeyIndex Index of the key
+/// @return Names of the key and of its ancestors, from the root key, separated by backslashes
+static std::wstring KeyPathOf
+(
+    _In_ const FlatRegistryTree& Tree,
+    _In_ const SIZE_T KeyIndex
+)
+{
+    std::wstring Path{ Tree.KeyName(KeyIndex) };
+    for (SIZE_T Parent = Tree.Keys[KeyIndex].Parent; Parent != SIZE_MAX; Parent = Tree.Keys[Parent].Parent)
+    {
+        Path = std::wstring{ Tree.KeyName(Parent) } + L"\\" + Path;
+    }
+    return Path;
+}
+
+/// @brief Tell whether a key is to be created as a symbolic link
+/// @param[in] Tree Flat registry tree
+/// @param[in] KeyIndex Index of the key
+/// @return Whether the key only holds a REG_LINK value named SymbolicLinkValue
+static bool IsSymbolicLink
+(
+    _In_ const FlatRegistryTree& Tree,
+    _In_ const SIZE_T KeyIndex
+)
+{
+    const FlatRegistryKey& Key = Tree.Keys[KeyIndex];
+    return Key.ValueCount == 1 && Key.SubtreeEnd == KeyIndex + 1 && Tree.Values[Key.FirstValue].Type == REG_LINK &&
+           Tree.ValueName(Key.FirstValue) == Constants::Hives::SymbolicLinkValue;
+}
+
+/// @brief Close the current hive bin, turning its unused space into a free cell, and write it during the emission pass
+/// @param[in,out] State Writer state
+/// @return HRESULT semantics
 _Must_inspect_result_
-static HRESULT LoadNtDllFunctions() {
-    if (NtDllModuleHandle == nullptr) {
-        NtDllModuleHandle = LoadLibraryExW(L"ntdll.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32);
-        if (NtDllModuleHandle == nullptr) {
-            ReportError(HRESULT_FROM_WIN32(GetLastError()), L"Loading ntdll.dll");
-            return HRESULT_FROM_WIN32(GetLastError());
+static HRESULT CloseBin
+(
+    _Inout_ HiveWriterState& State
+)
+{
+    HRESULT Result = E_FAIL;
+
+    if (State.BinSize == 0)
+    {
+        return S_OK;
+    }
+
+    if (State.Emitting)
+    {
+        const ULONGLONG FreeSize = State.BinOffset + State.BinSize - State.NextCellOffset;
+        if (FreeSize != 0)
+        {
+            Regf::WriteDword(&State.Bin[static_cast<SIZE_T>(State.NextCellOffset - State.BinOffset)], static_cast<DWORD>(FreeSize));
+        }
+
+        Result = State.File->Write(State.Bin.data(), State.Bin.size());
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Writing hive bin");
+            return Result;
         }
     }
-    if (NtSetValueKey == nullptr) {
-        NtSetValueKey = (decltype(NtSetValueKey)) GetProcAddress(NtDllModuleHandle, "NtSetValueKey");
-        if (NtSetValueKey == nullptr) {
-            ReportError(HRESULT_FROM_WIN32(GetLastError()), L"Getting address of NtSetValueKey in ntdll.dll"); 
-            return HRESULT_FROM_WIN32(GetLastError());
+
+    State.BinOffset += State.BinSize;
+    State.NextCellOffset = State.BinOffset;
+    State.BinSize = 0;
+    return S_OK;
+}
+
+/// @brief Reserve the next cell, opening a new hive bin when it does not fit in the current one
+/// @param[in,out] State Writer state
+/// @param[in] DataSize Size of the cell data
+/// @param[out] CellOffset Offset of the cell
+/// @param[out] CellData During the emission pass, zeroed cell data to fill; null during the layout pass
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT PlaceCell
+(
+    _Inout_ HiveWriterState& State,
+    _In_ const SIZE_T DataSize,
+    _Out_ DWORD& CellOffset,
+    _Out_ BYTE*& CellData
+)
+{
+    HRESULT Result = E_FAIL;
+    const ULONGLONG CellSize = (static_cast<ULONGLONG>(DataSize) + Regf::Cell::HeaderSize + Regf::Cell::Alignment - 1) & ~static_cast<ULONGLONG>(Regf::Cell::Alignment - 1);
+
+    CellOffset = Regf::Cell::NullOffset;
+    CellData = nullptr;
+
+    if (State.BinSize == 0 || State.NextCellOffset + CellSize > State.BinOffset + State.BinSize)
+    {
+        Result = CloseBin(State);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+
+        const ULONGLONG NewBinSize = (Regf::Bin::HeaderSize + CellSize + Regf::Bin::Alignment - 1) & ~static_cast<ULONGLONG>(Regf::Bin::Alignment - 1);
+        if (State.BinOffset + NewBinSize > MAXDWORD - Regf::BaseBlock::Size)
+        {
+            Result = HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+            ReportError(Result, L"Hive would be larger than 4GB");
+            return Result;
         }
+
+        State.BinSize = NewBinSize;
+        State.NextCellOffset = State.BinOffset + Regf::Bin::HeaderSize;
+
+        if (State.Emitting)
+        {
+            State.Bin.assign(static_cast<SIZE_T>(NewBinSize), 0);
+            Regf::WriteDword(&State.Bin[Regf::Bin::SignatureOffset], Regf::Bin::Signature);
+            Regf::WriteDword(&State.Bin[Regf::Bin::OffsetOffset], static_cast<DWORD>(State.BinOffset));
+            Regf::WriteDword(&State.Bin[Regf::Bin::SizeOffset], static_cast<DWORD>(NewBinSize));
+            Regf::WriteQword(&State.Bin[Regf::Bin::TimestampOffset], State.Timestamp);
+        }
+    }
+
+    CellOffset = static_cast<DWORD>(State.NextCellOffset);
+    State.NextCellOffset += CellSize;
+
+    if (State.Emitting)
+    {
+        BYTE* Cell = &State.Bin[static_cast<SIZE_T>(CellOffset - State.BinOffset)];
+        Regf::WriteDword(Cell, static_cast<DWORD>(-static_cast<LONG>(CellSize)));
+        CellData = Cell + Regf::Cell::HeaderSize;
+    }
+
+    return S_OK;
+}
+
+/// @brief Place the security (sk) cell shared by all keys
+/// @param[in,out] State Writer state
+/// @return HRESULT semantics
+/// @note The layout pass must be complete for the reference count to be known during the emission pass.
+_Must_inspect_result_
+static HRESULT SecurityToCell
+(
+    _Inout_ HiveWriterState& State
+)
+{
+    HRESULT Result = E_FAIL;
+    BYTE* CellData = nullptr;
+
+    Result = PlaceCell(State, Regf::Security::DescriptorOffset + sizeof(DefaultSecurityDescriptor), State.SecurityOffset, CellData);
+    if (FAILED(Result))
+    {
+        return Result;
     }
+
+    if (CellData != nullptr)
+    {
+        // sole security cell: it links to itself
+        Regf::WriteWord(CellData, Regf::Cell::SecuritySignature);
+        Regf::WriteDword(CellData + Regf::Security::FlinkOffset, State.SecurityOffset);
+        Regf::WriteDword(CellData + Regf::Security::BlinkOffset, State.SecurityOffset);
+        Regf::WriteDword(CellData + Regf::Security::ReferenceCountOffset, static_cast<DWORD>(State.Keys.size()));
+        Regf::WriteDword(CellData + Regf::Security::DescriptorSizeOffset, sizeof(DefaultSecurityDescriptor));
+        std::copy(std::cbegin(DefaultSecurityDescriptor), std::cend(DefaultSecurityDescriptor), CellData + Regf::Security::DescriptorOffset);
+    }
+
     return S_OK;
 }
 
-/// @brief Fill an empty HKEY with internal structures representing a registry key and dependencies
-/// @param[in] RegKey Registry key to dump into the HKEY
-/// @param[in] KeyHandle Handle to the key
+/// @brief Place the cells of a registry value: vk cell, then data cell or big data segments
+/// @param[in,out] State Writer state
+/// @param[in] Tree Flat registry tree
+/// @param[in] ValueIndex Index of the value in the flat tree
 /// @return HRESULT semantics
 _Must_inspect_result_
-static HRESULT InternalToHkey(
-    _In_ const RegistryKey& RegKey,
-    _In_ const HKEY KeyHandle
+static HRESULT ValueToCells
+(
+    _Inout_ HiveWriterState& State,
+    _In_ const FlatRegistryTree& Tree,
+    _In_ const SIZE_T ValueIndex
 )
 {
     HRESULT Result = E_FAIL;
-    HKEY SubkeyHandle = NULL;
+    const std::wstring_view Name = Tree.ValueName(ValueIndex);
+    const BYTE* Data = Tree.ValueData(ValueIndex);
+    const SIZE_T DataSize = Tree.Values[ValueIndex].DataSize;
+    DWORD CellOffset = Regf::Cell::NullOffset;
+    BYTE* CellData = nullptr;
 
-    if (KeyHandle == NULL)
+    const bool CompressedName = Regf::EncodeName(Name, State.NameBuffer);
+    if (State.NameBuffer.size() > USHRT_MAX)
     {
-        ReportError(E_HANDLE, L"Invalid Parameter");
-        return E_HANDLE;
+        ReportError(E_INVALIDARG, L"Name is too long (name: " + std::wstring{ Name } + L")");
+        return E_INVALIDARG;
+    }
+    if (DataSize > static_cast<SIZE_T>(USHRT_MAX) * Regf::BigData::SegmentSize)
+    {
+        ReportError(E_INVALIDARG, L"Binary value is too long (name: " + std::wstring{ Name } + L")");
+        return E_INVALIDARG;
+    }
+
+    Result = PlaceCell(State, Regf::Value::NameOffset + State.NameBuffer.size(), CellOffset, CellData);
+    if (FAILED(Result))
+    {
+        return Result;
     }
 
-    for (auto &Value : RegKey.Values)
+    if (!State.Emitting)
+    {
+        State.Values[ValueIndex].Value = CellOffset;
+    }
+    else
     {
-        if (NtSetValueKey == nullptr)
+        Regf::WriteWord(CellData, Regf::Cell::ValueSignature);
+        Regf::WriteWord(CellData + Regf::Value::NameLengthOffset, static_cast<WORD>(State.NameBuffer.size()));
+        if (DataSize <= Regf::Value::InlineDataMaximalSize)
         {
-            Result = LoadNtDllFunctions();
+            Regf::WriteDword(CellData + Regf::Value::DataSizeOffset, static_cast<DWORD>(DataSize) | Regf::Value::InlineDataFlag);
+            std::copy(Data, Data + DataSize, CellData + Regf::Value::DataOffset);
+        }
+        else
+        {
+            Regf::WriteDword(CellData + Regf::Value::DataSizeOffset, static_cast<DWORD>(DataSize));
+            Regf::WriteDword(CellData + Regf::Value::DataOffset, State.Values[ValueIndex].Data);
+        }
+        Regf::WriteDword(CellData + Regf::Value::TypeOffset, Tree.Values[ValueIndex].Type);
+        Regf::WriteWord(CellData + Regf::Value::FlagsOffset, CompressedName ? Regf::Value::CompressedNameFlag : 0);
+        std::copy(State.NameBuffer.cbegin(), State.NameBuffer.cend(), CellData + Regf::Value::NameOffset);
+    }
+
+    if (DataSize <= Regf::Value::InlineDataMaximalSize)
+    {
+        return S_OK;
+    }
+
+    if (DataSize <= Regf::BigData::SegmentSize)
+    {
+        Result = PlaceCell(State, DataSize, CellOffset, CellData);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+        if (CellData != nullptr)
+        {
+            std::copy(Data, Data + DataSize, CellData);
+        }
+    }
+    else
+    {
+        // segments first, then the segment list, then the db cell referring to it
+        std::vector<DWORD> SegmentOffsets;
+        for (SIZE_T SegmentStart = 0; SegmentStart < DataSize; SegmentStart += Regf::BigData::SegmentSize)
+        {
+            const SIZE_T SegmentSize = std::min<SIZE_T>(Regf::BigData::SegmentSize, DataSize - SegmentStart);
+            Result = PlaceCell(State, SegmentSize, CellOffset, CellData);
             if (FAILED(Result))
             {
-                ReportError(Result, L"Loading ntdll functions");
-                goto Cleanup;
+                return Result;
             }
-            if (NtSetValueKey == nullptr)
+            if (CellData != nullptr)
             {
-                Result = E_UNEXPECTED;
-                ReportError(Result, L"Loading ntdll functions");
-                goto Cleanup;
+                std::copy_n(Data + SegmentStart, SegmentSize, CellData);
             }
+            SegmentOffsets.push_back(CellOffset);
         }
-        
-        if (Value.Name.size() >= USHRT_MAX / sizeof(WCHAR))
+
+        Result = PlaceCell(State, SegmentOffsets.size() * sizeof(DWORD), CellOffset, CellData);
+        if (FAILED(Result))
         {
-            ReportError(E_UNEXPECTED, L"Name is too long (name: " + Value.Name + L")");
-            Result = E_UNEXPECTED;
-            goto Cleanup;
+            return Result;
         }
-        if (Value.BinaryValue.size() > MAXDWORD)
+        if (CellData != nullptr)
         {
-            ReportError(E_UNEXPECTED, L"Binary value is too long (name: " + Value.Name + L")");
-            Result = E_UNEXPECTED;
-            goto Cleanup;
+            for (SIZE_T SegmentIndex = 0; SegmentIndex < SegmentOffsets.size(); ++SegmentIndex)
+            {
+                Regf::WriteDword(CellData + SegmentIndex * sizeof(DWORD), SegmentOffsets[SegmentIndex]);
+            }
+        }
+        const DWORD SegmentListOffset = CellOffset;
+
+        Result = PlaceCell(State, Regf::BigData::SegmentListOffset + sizeof(DWORD), CellOffset, CellData);
+        if (FAILED(Result))
+        {
+            return Result;
         }
-        UNICODE_STRING ValueName = {};
-        ValueName.Buffer = (PWSTR)Value.Name.c_str();
-        ValueName.Length = (USHORT)Value.Name.size() * sizeof(*Value.Name.c_str());
-        ValueName.MaximumLength = ValueName.Length;
-        NTSTATUS Status = NtSetValueKey(KeyHandle, &ValueName, 0ul, Value.Type, (PVOID)Value.BinaryValue.data(), static_cast<ULONG>(Value.BinaryValue.size()));
-        if (NT_SUCCESS(Status) == FALSE)
+        if (CellData != nullptr)
         {
-            Result = HRESULT_FROM_NT(Status);
-            ReportError(Result, L"Could not set value " + Value.Name + L" of key " + RegKey.Name);
-            goto Cleanup;
+            Regf::WriteWord(CellData, Regf::Cell::BigDataSignature);
+            Regf::WriteWord(CellData + Regf::BigData::SegmentCountOffset, static_cast<WORD>(SegmentOffsets.size()));
+            Regf::WriteDword(CellData + Regf::BigData::SegmentListOffset, SegmentListOffset);
         }
     }
 
-    for (auto &Key : RegKey.Subkeys)
+    if (!State.Emitting)
     {
-        if (SubkeyHandle != NULL)
+        State.Values[ValueIndex].Data = CellOffset;
+    }
+
+    return S_OK;
+}
+
+/// @brief Place the cells of a registry key, in depth-first order: nk cell, value list, values, then subkey list.
+///        The cells of its subkeys are placed by the next keys of the flat tree.
+/// @param[in,out] State Writer state
+/// @param[in] Tree Flat registry tree
+/// @param[in] KeyIndex Index of the key in the flat tree
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT KeyToCells
+(
+    _Inout_ HiveWriterState& State,
+    _In_ const FlatRegistryTree& Tree,
+    _In_ const SIZE_T KeyIndex
+)
+{
+    HRESULT Result = E_FAIL;
+    const FlatRegistryKey& Key = Tree.Keys[KeyIndex];
+    const std::wstring_view KeyName = Tree.KeyName(KeyIndex);
+    const DWORD ParentOffset = Key.Parent == SIZE_MAX ? Regf::Cell::NullOffset : State.Keys[Key.Parent].KeyNode;
+    DWORD CellOffset = Regf::Cell::NullOffset;
+    BYTE* CellData = nullptr;
+
+    if (Key.Depth > Constants::Hives::MaximalKeyDepth)
+    {
+        ReportError(E_INVALIDARG, L"Maximal key depth exceeded - Current key name: " + std::wstring{ KeyName });
+        return E_INVALIDARG;
+    }
+
+    // subkeys are found by skipping whole subtrees, and subkey lists are sorted by uppercase name
+    State.SortedSubkeys.clear();
+    for (SIZE_T SubkeyIndex = KeyIndex + 1; SubkeyIndex < Key.SubtreeEnd; SubkeyIndex = Tree.Keys[SubkeyIndex].SubtreeEnd)
+    {
+        State.SortedSubkeys.push_back(SubkeyIndex);
+    }
+    std::sort(State.SortedSubkeys.begin(), State.SortedSubkeys.end(), [&Tree](const SIZE_T Left, const SIZE_T Right)
+    {
+        return Regf::CompareNames(Tree.KeyName(Left), Tree.KeyName(Right)) < 0;
+    });
+
+    const bool CompressedName = Regf::EncodeName(KeyName, State.NameBuffer);
+    if (State.NameBuffer.size() > USHRT_MAX)
+    {
+        ReportError(E_INVALIDARG, L"Name is too long (name: " + std::wstring{ KeyName } + L")");
+        return E_INVALIDARG;
+    }
+
+    Result = PlaceCell(State, Regf::KeyNode::NameOffset + State.NameBuffer.size(), CellOffset, CellData);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    if (!State.Emitting)
+    {
+        State.Keys[KeyIndex].KeyNode = CellOffset;
+    }
+    else
+    {
+        const KeyCells& Cells = State.Keys[KeyIndex];
+        WORD Flags = CompressedName ? Regf::KeyNode::CompressedNameFlag : 0;
+        DWORD MaxSubkeyNameLength = 0;
+        DWORD MaxValueNameLength = 0;
+        DWORD MaxValueDataSize = 0;
+
+        if (Key.Depth == 0)
+        {
+            Flags |= Regf::KeyNode::HiveEntryFlag | Regf::KeyNode::NoDeleteFlag;
+        }
+        if (IsSymbolicLink(Tree, KeyIndex))
         {
-            RegCloseKey(SubkeyHandle);
-            SubkeyHandle = NULL;
+            Flags |= Regf::KeyNode::SymbolicLinkFlag;
+        }
+        for (const SIZE_T SubkeyIndex : State.SortedSubkeys)
+        {
+            MaxSubkeyNameLength = std::max(MaxSubkeyNameLength, static_cast<DWORD>(Regf::Utf16Length(Tree.KeyName(SubkeyIndex)) * sizeof(WORD)));
+        }
+        for (SIZE_T ValueIndex = Key.FirstValue; ValueIndex < Key.FirstValue + Key.ValueCount; ++ValueIndex)
+        {
+            MaxValueNameLength = std::max(MaxValueNameLength, static_cast<DWORD>(Regf::Utf16Length(Tree.ValueName(ValueIndex)) * sizeof(WORD)));
+            MaxValueDataSize = std::max(MaxValueDataSize, static_cast<DWORD>(Tree.Values[ValueIndex].DataSize));
         }
 
-        if (Key.Values.size() == 1 && Key.Subkeys.size() == 0 && Key.Values[0].Type == REG_LINK && Key.Values[0].Name == Constants::Hives::SymbolicLinkValue)
+        Regf::WriteWord(CellData, Regf::Cell::KeyNodeSignature);
+        Regf::WriteWord(CellData + Regf::KeyNode::FlagsOffset, Flags);
+        Regf::WriteQword(CellData + Regf::KeyNode::TimestampOffset, State.Timestamp);
+        Regf::WriteDword(CellData + Regf::KeyNode::ParentOffset, ParentOffset);
+        Regf::WriteDword(CellData + Regf::KeyNode::SubkeyCountOffset, static_cast<DWORD>(State.SortedSubkeys.size()));
+        Regf::WriteDword(CellData + Regf::KeyNode::SubkeyListOffset, Cells.SubkeyList);
+        Regf::WriteDword(CellData + Regf::KeyNode::VolatileSubkeyListOffset, Regf::Cell::NullOffset);
+        Regf::WriteDword(CellData + Regf::KeyNode::ValueCountOffset, static_cast<DWORD>(Key.ValueCount));
+        Regf::WriteDword(CellData + Regf::KeyNode::ValueListOffset, Cells.ValueList);
+        Regf::WriteDword(CellData + Regf::KeyNode::SecurityOffset, State.SecurityOffset);
+        Regf::WriteDword(CellData + Regf::KeyNode::ClassNameOffset, Regf::Cell::NullOffset);
+        Regf::WriteDword(CellData + Regf::KeyNode::MaxSubkeyNameLengthOffset, MaxSubkeyNameLength);
+        Regf::WriteDword(CellData + Regf::KeyNode::MaxValueNameLengthOffset, MaxValueNameLength);
+        Regf::WriteDword(CellData + Regf::KeyNode::MaxValueDataSizeOffset, MaxValueDataSize);
+        Regf::WriteWord(CellData + Regf::KeyNode::NameLengthOffset, static_cast<WORD>(State.NameBuffer.size()));
+        std::copy(State.NameBuffer.cbegin(), State.NameBuffer.cend(), CellData + Regf::KeyNode::NameOffset);
+    }
+
+    if (Key.ValueCount != 0)
+    {
+        Result = PlaceCell(State, Key.ValueCount * sizeof(DWORD), CellOffset, CellData);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+        if (!State.Emitting)
         {
-            Result = HRESULT_FROM_WIN32(RegCreateKeyExW(KeyHandle, Key.Name.c_str(), 0, NULL, REG_OPTION_NON_VOLATILE | REG_OPTION_CREATE_LINK,
-                KEY_ALL_ACCESS, NULL, &SubkeyHandle, NULL));
+            State.Keys[KeyIndex].ValueList = CellOffset;
         }
         else
         {
-            Result = HRESULT_FROM_WIN32(RegCreateKeyExW(KeyHandle, Key.Name.c_str(), 0, NULL, REG_OPTION_NON_VOLATILE,
-                KEY_ALL_ACCESS, NULL, &SubkeyHandle, NULL));
+            for (SIZE_T ValueIndex = 0; ValueIndex < Key.ValueCount; ++ValueIndex)
+            {
+                Regf::WriteDword(CellData + ValueIndex * sizeof(DWORD), State.Values[Key.FirstValue + ValueIndex].Value);
+            }
         }
 
-        if (FAILED(Result))
+        for (SIZE_T ValueIndex = Key.FirstValue; ValueIndex < Key.FirstValue + Key.ValueCount; ++ValueIndex)
         {
-            ReportError(Result, L"Could not create subkey " + Key.Name + L" of key " + RegKey.Name);
-            goto Cleanup;
+            Result = ValueToCells(State, Tree, ValueIndex);
+            if (FAILED(Result))
+            {
+                ReportError(Result, L"Could not set value " + std::wstring{ Tree.ValueName(ValueIndex) } + L" of key " + std::wstring{ KeyName });
+                return Result;
+            }
         }
+    }
 
-        Result = InternalToHkey(Key, SubkeyHandle);
+    if (!State.SortedSubkeys.empty())
+    {
+        if (!State.Emitting)
+        {
+            for (SIZE_T SortedIndex = 0; SortedIndex < State.SortedSubkeys.size(); ++SortedIndex)
+            {
+                const std::wstring_view SubkeyName = Tree.KeyName(State.SortedSubkeys[SortedIndex]);
+                if (SubkeyName.empty())
+                {
+                    ReportError(E_INVALIDARG, L"Empty subkey name - Current key name: " + std::wstring{ KeyName });
+                    return E_INVALIDARG;
+                }
+                if (SortedIndex > 0 && Regf::CompareNames(Tree.KeyName(State.SortedSubkeys[SortedIndex - 1]), SubkeyName) == 0)
+                {
+                    ReportError(E_INVALIDARG, L"Duplicate subkey " + std::wstring{ SubkeyName } + L" - Current key name: " + std::wstring{ KeyName });
+                    return E_INVALIDARG;
+                }
+            }
+        }
 
+        std::vector<DWORD> LeafOffsets;
+        for (SIZE_T LeafStart = 0; LeafStart < State.SortedSubkeys.size(); LeafStart += Regf::SubkeyList::MaximalLeafCount)
+        {
+            const SIZE_T LeafCount = std::min<SIZE_T>(Regf::SubkeyList::MaximalLeafCount, State.SortedSubkeys.size() - LeafStart);
+            Result = PlaceCell(State, Regf::SubkeyList::ElementsOffset + LeafCount * Regf::SubkeyList::HashElementSize, CellOffset, CellData);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            LeafOffsets.push_back(CellOffset);
+
+            if (CellData != nullptr)
+            {
+                // nk cells of subkeys were placed by the layout pass, after this key
+                Regf::WriteWord(CellData, Regf::Cell::HashLeafSignature);
+                Regf::WriteWord(CellData + Regf::SubkeyList::CountOffset, static_cast<WORD>(LeafCount));
+                for (SIZE_T ElementIndex = 0; ElementIndex < LeafCount; ++ElementIndex)
+                {
+                    const SIZE_T SubkeyIndex = State.SortedSubkeys[LeafStart + ElementIndex];
+                    const bool CompressedSubkeyName = Regf::EncodeName(Tree.KeyName(SubkeyIndex), State.NameBuffer);
+                    BYTE* Element = CellData + Regf::SubkeyList::ElementsOffset + ElementIndex * Regf::SubkeyList::HashElementSize;
+                    Regf::WriteDword(Element, State.Keys[SubkeyIndex].KeyNode);
+                    Regf::WriteDword(Element + sizeof(DWORD), Regf::NameHash(State.NameBuffer.data(), State.NameBuffer.size(), CompressedSubkeyName));
+                }
+            }
+        }
+
+        if (LeafOffsets.size() > 1)
+        {
+            if (LeafOffsets.size() > USHRT_MAX)
+            {
+                ReportError(E_INVALIDARG, L"Too many subkeys - Current key name: " + std::wstring{ KeyName });
+                return E_INVALIDARG;
+            }
+
+            Result = PlaceCell(State, Regf::SubkeyList::ElementsOffset + LeafOffsets.size() * Regf::SubkeyList::IndexElementSize, CellOffset, CellData);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            if (CellData != nullptr)
+            {
+                Regf::WriteWord(CellData, Regf::Cell::IndexRootSignature);
+                Regf::WriteWord(CellData + Regf::SubkeyList::CountOffset, static_cast<WORD>(LeafOffsets.size()));
+                for (SIZE_T LeafIndex = 0; LeafIndex < LeafOffsets.size(); ++LeafIndex)
+                {
+                    Regf::WriteDword(CellData + Regf::SubkeyList::ElementsOffset + LeafIndex * Regf::SubkeyList::IndexElementSize, LeafOffsets[LeafIndex]);
+                }
+            }
+        }
+
+        if (!State.Emitting)
+        {
+            State.Keys[KeyIndex].SubkeyList = CellOffset;
+        }
+    }
+
+    return S_OK;
+}
+
+/// @brief Place all cells of a hive: the security cell, then the keys of the flat tree in order
+/// @param[in,out] State Writer state
+/// @param[in] Tree Flat registry tree
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT HiveToCells
+(
+    _Inout_ HiveWriterState& State,
+    _In_ const FlatRegistryTree& Tree
+)
+{
+    HRESULT Result = E_FAIL;
+
+    Result = SecurityToCell(State);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    for (SIZE_T KeyIndex = 0; KeyIndex < Tree.Keys.size(); ++KeyIndex)
+    {
+        Result = KeyToCells(State, Tree, KeyIndex);
         if (FAILED(Result))
         {
-            ReportError(Result, L"Could not render subkey " + Key.Name + L" of key " + RegKey.Name);
-            goto Cleanup;
+            ReportError(Result, L"Could not render key " + KeyPathOf(Tree, KeyIndex));
+            return Result;
         }
     }
 
-    Result = S_OK;
-Cleanup:
-    if (SubkeyHandle != NULL)
+    return CloseBin(State);
+}
+
+/// Sizes of a registry tree, as stored in a flat tree
+struct FlatTreeSizes {
+    /// Count of keys
+    SIZE_T KeyCount = 0;
+
+    /// Count of values
+    SIZE_T ValueCount = 0;
+
+    /// Total length of the names of keys and values, in code units
+    SIZE_T NameLength = 0;
+
+    /// Total size of the data of values, in bytes
+    SIZE_T DataSize = 0;
+};
+
+/// @brief Measure the subtree of a registry key, checking its depth
+/// @param[in] RegKey Representation of the registry key
+/// @param[in] Depth Depth of the key below the root key
+/// @param[in,out] Sizes Sizes to which the subtree is added
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT MeasureSubtree
+(
+    _In_ const RegistryKey& RegKey,
+    _In_ const SIZE_T Depth,
+    _Inout_ FlatTreeSizes& Sizes
+)
+{
+    HRESULT Result = E_FAIL;
+
+    if (Depth > Constants::Hives::MaximalKeyDepth)
     {
-        RegCloseKey(SubkeyHandle);
-        SubkeyHandle = NULL;
+        ReportError(E_INVALIDARG, L"Maximal key depth exceeded - Current key name: " + RegKey.Name);
+        return E_INVALIDARG;
+    }
+
+    Sizes.KeyCount += 1;
+    Sizes.NameLength += std::wstring_view{ RegKey.Name }.length();
+    for (const RegistryValue& Value : RegKey.Values)
+    {
+        Sizes.ValueCount += 1;
+        Sizes.NameLength += std::wstring_view{ Value.Name }.length();
+        Sizes.DataSize += Value.BinaryValue.size();
+    }
+
+    for (const RegistryKey& Subkey : RegKey.Subkeys)
+    {
+        Result = MeasureSubtree(Subkey, Depth + 1, Sizes);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
     }
 
-    return Result;
+    return S_OK;
 }
 
+/// @brief Append the subtree of a registry key to a flat tree
+/// @param[in] RegKey Representation of the registry key
+/// @param[in] Parent Index of the parent key in the flat tree, or SIZE_MAX for the root key
+/// @param[in,out] Tree Flat registry tree
+/// @note The depth of the subtree must have been checked by #MeasureSubtree.
+static void SubtreeToFlat
+(
+    _In_ const RegistryKey& RegKey,
+    _In_ const SIZE_T Parent,
+    _Inout_ FlatRegistryTree& Tree
+)
+{
+    const SIZE_T KeyIndex = Tree.OpenKey(RegKey.Name, Parent);
+
+    for (const RegistryValue& Value : RegKey.Values)
+    {
+        Tree.AppendValue(Value.Name, Value.Type, Value.BinaryValue.data(), Value.BinaryValue.size());
+    }
+
+    for (const RegistryKey& Subkey : RegKey.Subkeys)
+    {
+        SubtreeToFlat(Subkey, KeyIndex, Tree);
+    }
+
+    Tree.CloseKey(KeyIndex);
+}
 
 // non-static function: documented in header.
 _Must_inspect_result_
-HRESULT InternalToHive
+HRESULT InternalToFlat
 (
     _In_ const RegistryKey& RegKey,
+    _Out_ FlatRegistryTree& Tree
+)
+{
+    HRESULT Result = E_FAIL;
+    FlatTreeSizes Sizes;
+
+    Tree.Clear();
+
+    // the arrays and blobs are allocated once, as they may hold gigabytes
+    Result = MeasureSubtree(RegKey, 0, Sizes);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+    Tree.Reserve(Sizes.KeyCount, Sizes.ValueCount, Sizes.NameLength, Sizes.DataSize);
+
+    SubtreeToFlat(RegKey, SIZE_MAX, Tree);
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT FlatToHive
+(
+    _In_ const FlatRegistryTree& Tree,
     _In_ const std::wstring& OutputFilePath
 )
 {
     HRESULT Result = E_FAIL;
-    HKEY HiveKey = NULL;
+    HiveWriterState State;
+    OutputFile HiveFile;
+    std::vector<BYTE> BaseBlock(Regf::BaseBlock::Size, 0);
 
-    if (!DeleteFileW(OutputFilePath.c_str()))
+    if (Tree.Keys.empty() || Tree.Keys[0].SubtreeEnd != Tree.Keys.size())
     {
-        if (GetLastError() != ERROR_FILE_NOT_FOUND)
-        {
-            Result = HRESULT_FROM_WIN32(GetLastError());
-            ReportError(Result, L"Could not delete hive file " + OutputFilePath);
-            goto Cleanup;
-        }
+        ReportError(E_INVALIDARG, L"A hive holds a single tree, with a root key");
+        return E_INVALIDARG;
     }
 
-    Result = HRESULT_FROM_WIN32(RegLoadAppKeyW(OutputFilePath.c_str(), &HiveKey, KEY_ALL_ACCESS, REG_PROCESS_APPKEY, 0));
+    State.Timestamp = CurrentFileTime();
+    State.Keys.resize(Tree.Keys.size());
+    State.Values.resize(Tree.Values.size());
+
+    // layout pass: every cell offset is known afterwards
+    Result = HiveToCells(State, Tree);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Could not render registry tree to hive");
+        return Result;
+    }
+
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::SignatureOffset], Regf::BaseBlock::Signature);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::PrimarySequenceOffset], 1);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::SecondarySequenceOffset], 1);
+    Regf::WriteQword(&BaseBlock[Regf::BaseBlock::TimestampOffset], State.Timestamp);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::MajorVersionOffset], Regf::BaseBlock::MajorVersion);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::MinorVersionOffset], Regf::BaseBlock::WrittenMinorVersion);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::FileTypeOffset], Regf::BaseBlock::PrimaryFileType);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::FileFormatOffset], Regf::BaseBlock::DirectMemoryLoadFormat);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::RootCellOffset], State.Keys[0].KeyNode);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::BinsDataSizeOffset], static_cast<DWORD>(State.BinOffset));
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::ClusteringFactorOffset], 1);
+    Regf::WriteDword(&BaseBlock[Regf::BaseBlock::ChecksumOffset], Regf::BaseBlockChecksum(BaseBlock.data()));
+
+    Result = HiveFile.Create(OutputFilePath);
     if (FAILED(Result))
     {
-        ReportError(Result, L"Could not create empty hive file " + OutputFilePath);
-        goto Cleanup;
+        ReportError(Result, L"Could not create hive file " + OutputFilePath);
+        return Result;
     }
 
-    Result = InternalToHkey(RegKey, HiveKey);
+    Result = HiveFile.Write(BaseBlock.data(), BaseBlock.size());
     if (FAILED(Result))
     {
-        ReportError(Result, L"Could not render internal structure to hive");
+        ReportError(Result, L"Could not write base block to hive file " + OutputFilePath);
+        return Result;
     }
 
-    Result = S_OK;
+    // emission pass: cells land at the offsets computed by the layout pass
+    State.Emitting = true;
+    State.File = &HiveFile;
+    State.BinOffset = 0;
+    State.BinSize = 0;
+    State.NextCellOffset = 0;
 
-Cleanup:
-    if (HiveKey != NULL)
+    Result = HiveToCells(State, Tree);
+    if (FAILED(Result))
     {
-        RegCloseKey(HiveKey);
-        HiveKey = NULL;
+        ReportError(Result, L"Could not render registry tree to hive");
+        return Result;
+    }
+
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT InternalToHive
+(
+    _In_ const RegistryKey& RegKey,
+    _In_ const std::wstring& OutputFilePath
+)
+{
+    HRESULT Result = E_FAIL;
+    FlatRegistryTree Tree;
 
-        DeleteHiveLogFiles(OutputFilePath);
+    Result = InternalToFlat(RegKey, Tree);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Could not flatten internal structure");
+        return Result;
     }
 
-    return Result;
-}
\ No newline at end of file
+    return FlatToHive(Tree, OutputFilePath);
+}
@@ -5,393 +5,977 @@
 #include "Constants.h"
 #include "Conversions.h"
 #include "CommonFunctions.h"
+#include "HexCodec.h"
+#include "HiveView.h"
+#include "KeyPathPatterns.h"
+#include "OutputSink.h"
+#include "ParallelTasks.h"
+#include "RegfFormat.h"
+#include "StructuralScan.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <sstream>
 #include <iomanip>
 
-/// @brief Append binary contents of a std::wstring to an opened file
-/// @param[in] OutFileHandle Handle to the file
-/// @param[in] String Input string
-/// @note The string buffer is dumped to the file “as is”.
-///       Null characters may be appended to the file if the string buffer includes some of them.
+/// @brief Render the contents of a registry value in a .reg file
+/// @param[in,out] Output Rendition of the .reg file, to which the contents are appended
+/// @param[in] FirstLineSizeSoFar How many characters have already been written on the line when dumping
+///                               the name of the value and the equal sign.
+///                               This is used for mimicking .reg format line breaks before lines over 80 characters
+/// @param[in] Type Type of the registry value
+/// @param[in] ValueData Data of the registry value
+/// @param[in] DataSize Size of the data of the registry value, in bytes
+/// @return HRESULT semantics
 _Must_inspect_result_
-static HRESULT WriteStringBufferToFile
+static HRESULT RenderBinaryValue
 (
-    _In_ const HANDLE OutFileHandle,
-    _In_ const std::wstring String
+    _Inout_ std::wstring& Output,
+    _In_ const SIZE_T FirstLineSizeSoFar,
+    _In_ const DWORD Type,
+    _In_ const BYTE* ValueData,
+    _In_ const SIZE_T DataSize
 )
 {
-    HRESULT Result = E_FAIL;
+    EncodeHexRendition(Output, FirstLineSizeSoFar, Type, ValueData, DataSize);
+    Output += Constants::RegFiles::NewLines;
+    return S_OK;
+}
 
-    if (String.length() >= MAXDWORD / sizeof(decltype(String)::traits_type::char_type))
+/// @brief Render the contents of a REG_DWORD registry value in a .reg file
+/// @param[in,out] Output Rendition of the .reg file, to which the contents are appended
+/// @param[in] FirstLineSizeSoFar Use for fallback to #RenderBinaryValue
+/// @param[in] Type Type of the registry value
+/// @param[in] ValueData Data of the registry value
+/// @param[in] DataSize Size of the data of the registry value, in bytes
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT RenderDwordValue
+(
+    _Inout_ std::wstring& Output,
+    _In_ const SIZE_T FirstLineSizeSoFar,
+    _In_ const DWORD Type,
+    _In_ const BYTE* ValueData,
+    _In_ const SIZE_T DataSize
+)
+{
+    if (Type != REG_DWORD)
     {
-        Result = HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
-        ReportError(Result, L"Writing data that is too large");
-        return Result;
+        ReportError(E_HANDLE, L"Invalid parameter");
+        return E_INVALIDARG;
     }
 
-    if (OutFileHandle == NULL || OutFileHandle == INVALID_HANDLE_VALUE)
+    if (DataSize != sizeof(DWORD))
     {
-        ReportError(E_HANDLE, L"Invalid parameter");
-        return E_HANDLE;
+        return RenderBinaryValue(Output, FirstLineSizeSoFar, Type, ValueData, DataSize);
+    }
+
+    std::wostringstream DwordRenditionStream;
+    DwordRenditionStream << L"dword:";
+    DwordRenditionStream << std::hex << std::setw(8) << std::setfill(L'0') << Regf::ReadDword(ValueData);
+    DwordRenditionStream << Constants::RegFiles::NewLines;
+
+    Output += DwordRenditionStream.str();
+    return S_OK;
+}
+
+/// @brief Append a string to a .reg file rendition, escaped as reg export does
+/// @param[in,out] Output Rendition of the .reg file, to which the escaped string is appended
+/// @param[in] Text String to escape
+/// @param[in] Classes #StructuralClasses to escape: backslashes and double quotes are preceded by a backslash,
+///                    line feeds by a carriage return. Carriage returns are never escaped.
+/// @return Count of code units appended
+/// @note The escaped length is measured first, so that the string is escaped in place, in a single pass.
+///       Strings with nothing to escape are copied as a whole.
+static SIZE_T AppendEscapedString
+(
+    _Inout_ std::wstring& Output,
+    _In_ const std::wstring_view& Text,
+    _In_ const DWORD Classes
+)
+{
+    SIZE_T Special = FindStructuralChar(Text, 0, Classes);
+    if (Special == Text.npos)
+    {
+        Output.append(Text);
+        return Text.length();
     }
 
+    SIZE_T EscapedLength = Text.length();
+    for (SIZE_T Position = Special; Position != Text.npos; Position = FindStructuralChar(Text, Position + 1, Classes))
     {
-        const DWORD BytesToWrite = static_cast<DWORD>(String.length() * sizeof(decltype(String)::traits_type::char_type));
-        DWORD BytesWritten = 0;
+        if (Text[Position] != L'\r')
+        {
+            EscapedLength += 1;
+        }
+    }
 
-        if (!WriteFile(OutFileHandle, (LPCVOID)String.c_str(), BytesToWrite, &BytesWritten, NULL))
+    const SIZE_T Start = Output.length();
+    Output.resize(Start + EscapedLength);
+
+    WCHAR* Cursor = &Output[Start];
+    SIZE_T Position = 0;
+    while (Special != Text.npos)
+    {
+        Cursor = std::copy(Text.data() + Position, Text.data() + Special, Cursor);
+        if (Text[Special] == L'\n')
         {
-            Result = HRESULT_FROM_WIN32(GetLastError());
-            ReportError(Result, L"Could not write to output file");
-            return Result;
+            *Cursor++ = L'\r';
         }
-        if (BytesWritten != BytesToWrite)
+        else if (Text[Special] != L'\r')
         {
-            Result = E_UNEXPECTED;
-            ReportError(Result, L"Bytes not fully written to file");
-            return Result;
+            *Cursor++ = L'\\';
         }
+        *Cursor++ = Text[Special];
+
+        Position = Special + 1;
+        Special = FindStructuralChar(Text, Position, Classes);
     }
-    return S_OK;
+    std::copy(Text.data() + Position, Text.data() + Text.length(), Cursor);
+
+    return EscapedLength;
 }
 
-/// @brief Render the contents of a registry value in a .reg file
-/// @param[in] OutFileHandle Handle to the file
-/// @param[in] FirstLineSizeSoFar How many characters have already been written on the line when dumping
-///                               the name of the value and the equal sign.
-///                               This is used for mimicking .reg format line breaks before lines over 80 characters
-/// @param[in] RegValue Representation of the registry value
+/// @brief Render the contents of a REG_SZ registry value in a .reg file
+/// @param[in,out] Output Rendition of the .reg file, to which the contents are appended
+/// @param[in] FirstLineSizeSoFar Use for fallback to #RenderBinaryValue
+/// @param[in] Type Type of the registry value
+/// @param[in] ValueData Data of the registry value
+/// @param[in] DataSize Size of the data of the registry value, in bytes
 /// @return HRESULT semantics
+/// @note This falls back to binary rendition if the REG_SZ does not meet requirements such as:
+///       - REG_SZ values should be terminated by a null character
+///       - REG_SZ values may not contain other null characters
+///       - REG_SZ value sizes should be a multiple of 2 as they store UTF-16 code units.
 _Must_inspect_result_
-static HRESULT RenderBinaryValue
+static HRESULT RenderStringValue
 (
-    _In_ const HANDLE OutFileHandle,
+    _Inout_ std::wstring& Output,
     _In_ const SIZE_T FirstLineSizeSoFar,
-    _In_ const RegistryValue& RegValue
+    _In_ const DWORD Type,
+    _In_ const BYTE* ValueData,
+    _In_ const SIZE_T DataSize
 )
 {
-    HRESULT Result = E_FAIL;
-    SIZE_T CurLineSizeSoFar = FirstLineSizeSoFar;
-    if (OutFileHandle == NULL || OutFileHandle == INVALID_HANDLE_VALUE)
+    if (Type != REG_SZ)
+    {
+        ReportError(E_HANDLE, L"Invalid parameter");
+        return E_INVALIDARG;
+    }
+
+    if (DataSize % sizeof(WORD) != 0)
+    {
+        return RenderBinaryValue(Output, FirstLineSizeSoFar, Type, ValueData, DataSize);
+    }
+
+#if WCHAR_MAX > 0xFFFF
+    // wide strings hold UTF-32: the data is decoded first
+    std::wstring DecodedValue;
+    Regf::DecodeUtf16(ValueData, DataSize, DecodedValue);
+    const std::wstring_view WstringValue { DecodedValue };
+#else
+    const std::wstring_view WstringValue { reinterpret_cast<const WCHAR*>(ValueData), DataSize / sizeof(WCHAR) };
+#endif
+    if (   WstringValue.empty()
+        || WstringValue.find(L'\0') != WstringValue.length() - 1
+       )
+    {
+        return RenderBinaryValue(Output, FirstLineSizeSoFar, Type, ValueData, DataSize);
+    }
+
+    // Now we can render the value as REG_SZ, without its null character
+    Output += L'"';
+    AppendEscapedString(Output, WstringValue.substr(0, WstringValue.length() - 1), StructuralClasses::Backslashes | StructuralClasses::Quotes | StructuralClasses::NewLines);
+    Output += L'"';
+    Output += Constants::RegFiles::NewLines;
+    return S_OK;
+}
+
+/// @brief Render a registry value and its contents in a .reg file
+/// @param[in,out] Output Rendition of the .reg file, to which the value is appended
+/// @param[in] Name Name of the registry value
+/// @param[in] Type Type of the registry value
+/// @param[in] ValueData Data of the registry value
+/// @param[in] DataSize Size of the data of the registry value, in bytes
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT RenderRegistryValue
+(
+    _Inout_ std::wstring& Output,
+    _In_ const std::wstring_view Name,
+    _In_ const DWORD Type,
+    _In_ const BYTE* ValueData,
+    _In_ const SIZE_T DataSize
+)
+{
+    SIZE_T FirstLineSizeSoFar = 0;
+
+    if (Name.empty())
+    {
+        Output += Constants::RegFiles::DefaultValue;
+        Output += Constants::RegFiles::ValueNameSeparator;
+        FirstLineSizeSoFar = 2;
+    }
+    else
+    {
+        Output += L'"';
+        FirstLineSizeSoFar = AppendEscapedString(Output, Name, StructuralClasses::Backslashes | StructuralClasses::Quotes | StructuralClasses::NewLines) + 3;
+        Output += L"\"=";
+    }
+
+    if (Type == REG_DWORD)
     {
-        return E_HANDLE;
+        return RenderDwordValue(Output, FirstLineSizeSoFar, Type, ValueData, DataSize);
     }
+    if (Type == REG_SZ)
+    {
+        return RenderStringValue(Output, FirstLineSizeSoFar, Type, ValueData, DataSize);
+    }
+    return RenderBinaryValue(Output, FirstLineSizeSoFar, Type, ValueData, DataSize);
+}
+
+/// @brief Append the name of a key to the escaped path to its parent
+/// @param[in,out] EscapedPath Escaped path to the parent key, empty for the root key. Becomes the escaped path to the key.
+/// @param[in] Name Name of the key
+/// @return Length of the escaped path to the parent key, to which #EscapedPath is truncated when leaving the key
+static SIZE_T PushKeyPath
+(
+    _Inout_ std::wstring& EscapedPath,
+    _In_ const std::wstring_view Name
+)
+{
+    const SIZE_T ParentLength = EscapedPath.length();
+    if (ParentLength != 0)
+    {
+        EscapedPath += Constants::RegFiles::PathSeparator;
+    }
+    AppendEscapedString(EscapedPath, Name, StructuralClasses::NewLines);
+    return ParentLength;
+}
+
+/// @brief Render the line opening a registry key in a .reg file
+/// @param[in,out] Output Rendition of the .reg file, to which the line is appended
+/// @param[in] EscapedPath Escaped path to the key
+static void RenderKeyPath
+(
+    _Inout_ std::wstring& Output,
+    _In_ const std::wstring_view EscapedPath
+)
+{
+    Output += Constants::RegFiles::KeyOpening;
+    Output += EscapedPath;
+    Output += Constants::RegFiles::KeyClosing;
+    Output += Constants::RegFiles::NewLines;
+}
+
+/// @brief Estimate the length of the rendition of a value
+/// @param[in] NameLength Length of the name of the value
+/// @param[in] DataSize Size of the data of the value, in bytes
+/// @return Estimated count of code units
+static SIZE_T EstimateValueRenditionLength
+(
+    _In_ const SIZE_T NameLength,
+    _In_ const SIZE_T DataSize
+)
+{
+    // hexadecimal renditions take a little more than 3 code units per byte
+    return NameLength + 8 + DataSize * 3;
+}
+
+/// @brief Render tasks in order into a .reg file
+/// @param[in] OutputFilePath Path of the desired output file
+/// @param[in] BufferSize Size in bytes of the buffer through which the file is written
+/// @param[in] ThreadCount Count of threads rendering the tasks
+/// @param[in] TaskCount Count of tasks, indexed from 0 in the order of the file
+/// @param[in] RenderTask Function appending the rendition of the task of a given index to a buffer
+/// @return HRESULT semantics
+/// @note The preamble is rendered first. With several threads, tasks are rendered by batches into intermediate buffers,
+///       that are written in task order, so that the file does not depend on #ThreadCount.
+_Must_inspect_result_
+static HRESULT RenderTasksToFile
+(
+    _In_ const std::wstring& OutputFilePath,
+    _In_ const SIZE_T BufferSize,
+    _In_ const SIZE_T ThreadCount,
+    _In_ const SIZE_T TaskCount,
+    _In_ const std::function<HRESULT(std::wstring& Output, SIZE_T TaskIndex)>& RenderTask
+)
+{
+    HRESULT Result = E_FAIL;
+    OutputSink Sink;
+    std::vector<std::wstring> Renditions;
 
-    std::wostringstream BinaryRenditionStream;
-    BinaryRenditionStream << Constants::RegFiles::HexPrefix;
-    if (RegValue.Type != REG_BINARY)
+    Result = Sink.Create(OutputFilePath, BufferSize);
+    if (FAILED(Result))
     {
-        BinaryRenditionStream << Constants::RegFiles::HexTypeSpecOpening << std::hex << RegValue.Type << Constants::RegFiles::HexTypeSpecClosing;
+        goto Cleanup;
     }
-    BinaryRenditionStream << Constants::RegFiles::HexSuffix;
 
-    CurLineSizeSoFar += BinaryRenditionStream.str().length();
+    Sink.Buffer() += Constants::RegFiles::Preamble;
+
+    if (ThreadCount <= 1)
+    {
+        // nothing to gain from intermediate buffers: tasks are rendered straight into the output buffer
+        for (SIZE_T TaskIndex = 0; TaskIndex < TaskCount; ++TaskIndex)
+        {
+            Result = RenderTask(Sink.Buffer(), TaskIndex);
+            if (FAILED(Result))
+            {
+                ReportError(Result, L"Could not render registry key");
+                goto Cleanup;
+            }
 
-    for (std::vector<BYTE>::const_iterator CurByteIt = RegValue.BinaryValue.cbegin(); CurByteIt != RegValue.BinaryValue.cend(); ++CurByteIt)
+            Result = Sink.FlushCompleteBlocks();
+            if (FAILED(Result))
+            {
+                goto Cleanup;
+            }
+        }
+    }
+    else
     {
-        BinaryRenditionStream << std::hex << std::setfill(L'0') << std::setw(2) << *CurByteIt;
-        CurLineSizeSoFar += 2;
-        if (CurByteIt + 1 != RegValue.BinaryValue.cend())
+        // tasks are rendered by batches, so that only a bounded part of the rendition is held in memory
+        Renditions.resize(ThreadCount * Constants::RegFiles::ParallelRenderTasksPerThread);
+        for (SIZE_T BatchStart = 0; BatchStart < TaskCount; BatchStart += Renditions.size())
         {
-            BinaryRenditionStream << Constants::RegFiles::HexByteSeparator;
-            CurLineSizeSoFar += 1;
-            if (CurLineSizeSoFar > Constants::RegFiles::HexWrappingLimit - 4)
+            const SIZE_T BatchSize = std::min(Renditions.size(), TaskCount - BatchStart);
+
+            Result = RunParallelTasks(BatchSize, ThreadCount, [&](SIZE_T TaskIndex) -> HRESULT
+            {
+                Renditions[TaskIndex].clear();
+                return RenderTask(Renditions[TaskIndex], BatchStart + TaskIndex);
+            });
+            if (FAILED(Result))
+            {
+                ReportError(Result, L"Could not render registry key");
+                goto Cleanup;
+            }
+
+            // renditions are written in depth-first order, exactly as a serial rendering would
+            for (SIZE_T TaskIndex = 0; TaskIndex < BatchSize; ++TaskIndex)
             {
-                // adding "xx,\" would go over 80 characters, reg export typically breaks line here.
-                BinaryRenditionStream << Constants::RegFiles::HexByteNewLine;
-                for (SIZE_T SpaceCount = 0; SpaceCount < Constants::RegFiles::HexNewLineLeadingSpaces; ++SpaceCount)
+                Sink.Buffer() += Renditions[TaskIndex];
+
+                Result = Sink.FlushCompleteBlocks();
+                if (FAILED(Result))
                 {
-                    BinaryRenditionStream << Constants::RegFiles::LeadingSpace;
+                    goto Cleanup;
                 }
-                CurLineSizeSoFar = Constants::RegFiles::HexNewLineLeadingSpaces;
             }
         }
     }
 
-    BinaryRenditionStream << Constants::RegFiles::NewLines;
-
-    Result = WriteStringBufferToFile(OutFileHandle, BinaryRenditionStream.str());
+    Result = Sink.Flush();
     if (FAILED(Result))
     {
-        ReportError(Result, L"Could not write to output file");
-        return Result;
+        goto Cleanup;
     }
 
-    return S_OK;
+    Result = S_OK;
+
+Cleanup:
+    Sink.Close();
+
+    return Result;
 }
 
-/// @brief Render the contents of a REG_DWORD registry value in a .reg file
-/// @param[in] OutFileHandle Handle to the file
-/// @param[in] FirstLineSizeSoFar Use for fallback to #RenderBinaryValue
-/// @param[in] RegValue Representation of the registry value
+/// Part of a hive view that is rendered independently of the other parts
+struct HiveViewRenderTask {
+    /// Key node of the key to render
+    HiveKeyNode Node;
+
+    /// Depth of the key below the hive root, to bound recursion on corrupted hives
+    SIZE_T Depth;
+
+    /// Index of the task rendering the parent key, or SIZE_MAX for an exported key
+    SIZE_T ParentTask;
+
+    /// Whether the subkeys of the key are rendered by this task, or by the following ones
+    bool WithSubkeys;
+
+    /// Whether only the path of the key is rendered, as the parent of selected keys
+    bool PathOnly;
+
+    /// Progress of the exclusion patterns along the path to the key
+    KeyPathPatterns::Progress Exclusions;
+
+    /// Escaped path to the key
+    std::wstring EscapedPath;
+};
+
+/// @brief Render a value of a hive view in a .reg file
+/// @param[in,out] Output Rendition of the .reg file, to which the value is appended
+/// @param[in] Image Accessor over the hive image
+/// @param[in] ValueNode Value node of the registry value
+/// @param[in] EscapedPath Escaped path to the key of the value, for error messages
+/// @param[in,out] NameBuffer Buffer for decoding names, kept across calls to spare allocations
+/// @param[in,out] DataBuffer Buffer for big value data, kept across calls to spare allocations
 /// @return HRESULT semantics
 _Must_inspect_result_
-static HRESULT RenderDwordValue
+static HRESULT RenderHiveValue
 (
-    _In_ const HANDLE OutFileHandle,
-    _In_ const SIZE_T FirstLineSizeSoFar,
-    _In_ const RegistryValue& RegValue
+    _Inout_ std::wstring& Output,
+    _In_ const HiveImage& Image,
+    _In_ const HiveValueNode& ValueNode,
+    _In_ const std::wstring& EscapedPath,
+    _Inout_ std::wstring& NameBuffer,
+    _Inout_ ValueData& DataBuffer
 )
 {
-    if (OutFileHandle == NULL || OutFileHandle == INVALID_HANDLE_VALUE)
+    HRESULT Result = E_FAIL;
+    const BYTE* Data = nullptr;
+
+    Regf::DecodeName(ValueNode.Name, ValueNode.NameLength, ValueNode.HasCompressedName(), NameBuffer);
+    Result = GetValueDataView(Image, ValueNode, Data, DataBuffer);
+    if (FAILED(Result))
     {
-        ReportError(E_HANDLE, L"Invalid parameter");
-        return E_HANDLE;
+        ReportError(Result, L"Getting data of value " + NameBuffer + L" - Current key path: " + EscapedPath);
+        return Result;
     }
 
-    if (RegValue.Type != REG_DWORD)
+    Result = RenderRegistryValue(Output, NameBuffer, ValueNode.Type, Data, ValueNode.DataSize);
+    if (FAILED(Result))
     {
-        ReportError(E_HANDLE, L"Invalid parameter");
-        return E_INVALIDARG;
+        ReportError(Result, L"Could not render registry value" + NameBuffer);
+        return Result;
     }
 
-    if (RegValue.BinaryValue.size() != sizeof(DWORD))
+    return S_OK;
+}
+
+/// @brief Render a key of a hive view and its values in a .reg file, without its subkeys
+/// @param[in,out] Output Rendition of the .reg file, to which the key is appended
+/// @param[in] Image Accessor over the hive image
+/// @param[in] Node Key node of the registry key
+/// @param[in] EscapedPath Escaped path to this key
+/// @param[in,out] NameBuffer Buffer for decoding names, kept across calls to spare allocations
+/// @param[in,out] DataBuffer Buffer for big value data, kept across calls to spare allocations
+/// @return HRESULT semantics
+/// @note Names are decoded one at a time, and data is rendered from the image itself, save for big data.
+_Must_inspect_result_
+static HRESULT RenderHiveKeyAndValues
+(
+    _Inout_ std::wstring& Output,
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const std::wstring& EscapedPath,
+    _Inout_ std::wstring& NameBuffer,
+    _Inout_ ValueData& DataBuffer
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* ValueList = nullptr;
+
+    Result = GetValueList(Image, Node, ValueList);
+    if (FAILED(Result))
     {
-        return RenderBinaryValue(OutFileHandle, FirstLineSizeSoFar, RegValue);
+        ReportError(Result, L"Getting value list - Current key path: " + EscapedPath);
+        return Result;
     }
 
-    std::wostringstream DwordRenditionStream;
-    DwordRenditionStream << L"dword:";
-    DwordRenditionStream << std::hex << std::setw(8) << std::setfill(L'0') << *(DWORD*)(RegValue.BinaryValue.data());
-    DwordRenditionStream << Constants::RegFiles::NewLines;
+    RenderKeyPath(Output, EscapedPath);
+
+    for (DWORD ValueIndex = 0; ValueIndex < Node.ValueCount; ++ValueIndex)
+    {
+        HiveValueNode ValueNode;
+
+        Result = GetValueNode(Image, Regf::ReadDword(ValueList + ValueIndex * sizeof(DWORD)), ValueNode);
+        if (FAILED(Result))
+        {
+            std::wostringstream ErrorMessageStream;
+            ErrorMessageStream << L"Getting value at index " << ValueIndex << L" - Current key path: " << EscapedPath;
+            ReportError(Result, ErrorMessageStream.str());
+            return Result;
+        }
+
+        Result = RenderHiveValue(Output, Image, ValueNode, EscapedPath, NameBuffer, DataBuffer);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+    }
 
-    return WriteStringBufferToFile(OutFileHandle, DwordRenditionStream.str());
+    Output += Constants::RegFiles::NewLines;
 
+    return S_OK;
 }
 
-/// @brief Render the contents of a REG_SZ registry value in a .reg file
-/// @param[in] OutFileHandle Handle to the file
-/// @param[in] FirstLineSizeSoFar Use for fallback to #RenderBinaryValue
-/// @param[in] RegValue Representation of the registry value
+/// @brief Render a key of a hive view and its values and subkeys in a .reg file
+/// @param[in,out] Output Rendition of the .reg file, to which the key is appended
+/// @param[in] Image Accessor over the hive image
+/// @param[in] Node Key node of the registry key
+/// @param[in] Depth Depth of the key below the hive root, to bound recursion on corrupted hives
+/// @param[in] ExcludedKeys Patterns of the keys that are not rendered, with their subkeys
+/// @param[in] Exclusions Progress of #ExcludedKeys along the path to the key
+/// @param[in,out] EscapedPath Escaped path to this key. The names of subkeys are appended to it
+///                            while they are rendered, and removed afterwards.
+/// @param[in,out] NameBuffer Buffer for decoding names, kept across calls to spare allocations
+/// @param[in,out] DataBuffer Buffer for big value data, kept across calls to spare allocations
 /// @return HRESULT semantics
-/// @note This falls back to binary rendition if the REG_SZ does not meet requirements such as:
-///       - REG_SZ values should be terminated by a null character
-///       - REG_SZ values may not contain other null characters
-///       - REG_SZ value sizes should be a multiple of 2 as they store WCHAR-based values.
+/// @note Keys and values are rendered in the order RegEnumKeyExW and RegEnumValueW would use.
 _Must_inspect_result_
-static HRESULT RenderStringValue
+static HRESULT RenderHiveKey
 (
-    _In_ const HANDLE OutFileHandle,
-    _In_ const SIZE_T FirstLineSizeSoFar,
-    _In_ const RegistryValue& RegValue
+    _Inout_ std::wstring& Output,
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const SIZE_T Depth,
+    _In_ const KeyPathPatterns& ExcludedKeys,
+    _In_ const KeyPathPatterns::Progress& Exclusions,
+    _Inout_ std::wstring& EscapedPath,
+    _Inout_ std::wstring& NameBuffer,
+    _Inout_ ValueData& DataBuffer
 )
 {
-    std::wstring WstringValue;
-    if (OutFileHandle == NULL || OutFileHandle == INVALID_HANDLE_VALUE)
-    {
-        ReportError(E_HANDLE, L"Invalid parameter");
-        return E_HANDLE;
-    }
+    HRESULT Result = E_FAIL;
+    std::vector<DWORD> SubkeyOffsets;
+    KeyPathPatterns::Progress SubkeyExclusions;
 
-    if (RegValue.Type != REG_SZ)
+    if (Depth > Constants::Hives::MaximalKeyDepth)
     {
-        ReportError(E_HANDLE, L"Invalid parameter");
-        return E_INVALIDARG;
+        ReportError(E_UNEXPECTED, L"Maximal key depth exceeded - Current key path: " + EscapedPath);
+        return E_UNEXPECTED;
     }
 
-    if (RegValue.BinaryValue.size() % sizeof(WCHAR) != 0)
+    Result = RenderHiveKeyAndValues(Output, Image, Node, EscapedPath, NameBuffer, DataBuffer);
+    if (FAILED(Result))
     {
-        return RenderBinaryValue(OutFileHandle, FirstLineSizeSoFar, RegValue);
+        return Result;
     }
 
-    WstringValue.assign((PWCHAR) RegValue.BinaryValue.data(), RegValue.BinaryValue.size() / sizeof(WCHAR));
-    if (WstringValue.empty())
+    Result = GetSubkeyOffsets(Image, Node, SubkeyOffsets);
+    if (FAILED(Result))
     {
-        return RenderBinaryValue(OutFileHandle, FirstLineSizeSoFar, RegValue);
+        ReportError(Result, L"Getting subkey list - Current key path: " + EscapedPath);
+        return Result;
     }
 
-    if (   WstringValue.empty()
-        || WstringValue.back() != L'\0'
-        || std::count(WstringValue.cbegin(), WstringValue.cend() - 1, L'\0') != 0
-       )
+    for (SIZE_T SubkeyIndex = 0; SubkeyIndex < SubkeyOffsets.size(); ++SubkeyIndex)
     {
-        return RenderBinaryValue(OutFileHandle, FirstLineSizeSoFar, RegValue);
-    }
+        HiveKeyNode SubkeyNode;
+        Result = GetKeyNode(Image, SubkeyOffsets[SubkeyIndex], SubkeyNode);
+        if (FAILED(Result))
+        {
+            std::wostringstream ErrorMessageStream;
+            ErrorMessageStream << L"Getting subkey at index " << SubkeyIndex << L" - Current key path: " << EscapedPath;
+            ReportError(Result, ErrorMessageStream.str());
+            return Result;
+        }
 
-    // Now we can render the value as REG_SZ: Remove null character
-    WstringValue.pop_back();
+        Regf::DecodeName(SubkeyNode.Name, SubkeyNode.NameLength, SubkeyNode.HasCompressedName(), NameBuffer);
+        if (ExcludedKeys.Advance(Exclusions, NameBuffer, SubkeyExclusions))
+        {
+            continue;
+        }
 
-    GlobalStringSubstitute(WstringValue, L"\\", L"\\\\");
-    GlobalStringSubstitute(WstringValue, L"\"", L"\\\"");
-    GlobalStringSubstitute(WstringValue, L"\n", L"\r\n");
+        const SIZE_T ParentLength = PushKeyPath(EscapedPath, NameBuffer);
+        Result = RenderHiveKey(Output, Image, SubkeyNode, Depth + 1, ExcludedKeys, SubkeyExclusions, EscapedPath, NameBuffer, DataBuffer);
+        if (FAILED(Result))
+        {
+            ReportError(Result, L"Could not render registry key" + EscapedPath);
+            return Result;
+        }
+        EscapedPath.resize(ParentLength);
+    }
 
-    std::wostringstream StringRenditionStream;
-    StringRenditionStream <<  L"\"" << WstringValue  << L"\"" << Constants::RegFiles::NewLines;
-    return WriteStringBufferToFile(OutFileHandle, StringRenditionStream.str());
+    return S_OK;
 }
 
-/// @brief Render a registry value and its contents in a .reg file
-/// @param[in] OutFileHandle Handle to the file
-/// @param[in] RegValue Representation of the registry value
+/// @brief Estimate the length of the rendition of a key of a hive view and its values, without its subkeys
+/// @param[in] Image Accessor over the hive image
+/// @param[in] Node Key node of the registry key
+/// @param[out] Length Estimated count of code units
 /// @return HRESULT semantics
+/// @note Only the value cells are read: names are not decoded and data is not visited.
 _Must_inspect_result_
-HRESULT RenderRegistryValue
+static HRESULT EstimateHiveKeyRenditionLength
 (
-    _In_ const HANDLE OutFileHandle,
-    _In_ const RegistryValue& RegValue
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _Out_ SIZE_T& Length
 )
 {
     HRESULT Result = E_FAIL;
-    SIZE_T FirstLineSizeSoFar = 0;
-    if (OutFileHandle == NULL || OutFileHandle == INVALID_HANDLE_VALUE)
+    const BYTE* ValueList = nullptr;
+
+    Length = Node.NameLength + 8;
+
+    Result = GetValueList(Image, Node, ValueList);
+    if (FAILED(Result))
     {
-        ReportError(E_HANDLE, L"Invalid parameter");
-        return E_HANDLE;
+        return Result;
     }
 
-    std::wstring EscapedName = RegValue.Name;
-    GlobalStringSubstitute(EscapedName, L"\\", L"\\\\");
-    GlobalStringSubstitute(EscapedName, L"\"", L"\\\"");
-    GlobalStringSubstitute(EscapedName, L"\n", L"\r\n");
-    std::wostringstream Str;
-    if (EscapedName.empty())
+    for (DWORD ValueIndex = 0; ValueIndex < Node.ValueCount; ++ValueIndex)
     {
-        Str << Constants::RegFiles::DefaultValue << Constants::RegFiles::ValueNameSeparator;
+        HiveValueNode ValueNode;
+        Result = GetValueNode(Image, Regf::ReadDword(ValueList + ValueIndex * sizeof(DWORD)), ValueNode);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+        Length += EstimateValueRenditionLength(ValueNode.NameLength, ValueNode.DataSize);
     }
-    else
+
+    return S_OK;
+}
+
+/// @brief Cut the tree of a hive view into rendering tasks, in the order of the .reg file
+/// @param[in] Image Accessor over the hive image
+/// @param[in] Node Key node of the registry key
+/// @param[in] Depth Depth of the key below the hive root, to bound recursion on corrupted hives
+/// @param[in] ParentTask Index of the task rendering the parent key, or SIZE_MAX for an exported key
+/// @param[in] ExcludedKeys Patterns of the keys that are not rendered, with their subkeys
+/// @param[in] Exclusions Progress of #ExcludedKeys along the path to the key
+/// @param[in,out] NameBuffer Buffer for decoding names, kept across calls to spare allocations
+/// @param[in,out] Tasks Rendering tasks. The tasks rendering the key and its subkeys are appended, without their paths.
+/// @param[out] Length Estimated length of the rendition of the key and its subkeys
+/// @return HRESULT semantics
+/// @note A subtree whose rendition is short enough is rendered by a single task. Otherwise, a task renders the key
+///       and its values only, and the subtrees of its subkeys are cut likewise. Names of subkeys are only decoded where
+///       an exclusion pattern may match.
+_Must_inspect_result_
+static HRESULT PlanHiveRenderTasks
+(
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const SIZE_T Depth,
+    _In_ const SIZE_T ParentTask,
+    _In_ const KeyPathPatterns& ExcludedKeys,
+    _In_ const KeyPathPatterns::Progress& Exclusions,
+    _Inout_ std::wstring& NameBuffer,
+    _Inout_ std::vector<HiveViewRenderTask>& Tasks,
+    _Out_ SIZE_T& Length
+)
+{
+    HRESULT Result = E_FAIL;
+    const SIZE_T TaskIndex = Tasks.size();
+    std::vector<DWORD> SubkeyOffsets;
+    KeyPathPatterns::Progress SubkeyExclusions;
+
+    Length = 0;
+
+    if (Depth > Constants::Hives::MaximalKeyDepth)
     {
-        Str << L"\"" << EscapedName << L"\"=";
+        ReportError(E_UNEXPECTED, L"Maximal key depth exceeded");
+        return E_UNEXPECTED;
     }
-    Result = WriteStringBufferToFile(OutFileHandle, Str.str());
+
+    Result = EstimateHiveKeyRenditionLength(Image, Node, Length);
     if (FAILED(Result))
     {
-        ReportError(Result, L"Could not write data to file");
         return Result;
     }
 
-    FirstLineSizeSoFar += Str.str().length();
+    Tasks.push_back(HiveViewRenderTask{ Node, Depth, ParentTask, false, false, Exclusions, std::wstring{} });
 
-    if (RegValue.Type == REG_DWORD)
+    Result = GetSubkeyOffsets(Image, Node, SubkeyOffsets);
+    if (FAILED(Result))
     {
-        return RenderDwordValue(OutFileHandle, FirstLineSizeSoFar, RegValue);
+        return Result;
     }
-    if (RegValue.Type == REG_SZ)
+
+    for (const DWORD SubkeyOffset : SubkeyOffsets)
     {
-        return RenderStringValue(OutFileHandle, FirstLineSizeSoFar, RegValue);
+        HiveKeyNode SubkeyNode;
+        SIZE_T SubtreeLength = 0;
+
+        Result = GetKeyNode(Image, SubkeyOffset, SubkeyNode);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+
+        if (!Exclusions.Candidates.empty())
+        {
+            Regf::DecodeName(SubkeyNode.Name, SubkeyNode.NameLength, SubkeyNode.HasCompressedName(), NameBuffer);
+            if (ExcludedKeys.Advance(Exclusions, NameBuffer, SubkeyExclusions))
+            {
+                continue;
+            }
+        }
+
+        Result = PlanHiveRenderTasks(Image, SubkeyNode, Depth + 1, TaskIndex, ExcludedKeys, SubkeyExclusions, NameBuffer, Tasks, SubtreeLength);
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+        Length += SubtreeLength;
+    }
+
+    if (Length <= Constants::RegFiles::ParallelRenderTaskLength)
+    {
+        // the tasks planned for the subkeys are merged into this one
+        Tasks.resize(TaskIndex + 1);
+        Tasks[TaskIndex].WithSubkeys = true;
     }
-    return RenderBinaryValue(OutFileHandle, FirstLineSizeSoFar, RegValue);
+
+    return S_OK;
 }
 
-/// @brief Render a registry key and its values and subkeys in a .reg file
-/// @param[in] OutFileHandle Handle to the file
-/// @param[in] RegKey Representation of the registry key
-/// @param[in] PathSoFar Path to this key
+/// @brief Look for the selected keys below a key of a hive view, and plan their rendering
+/// @param[in] Image Accessor over the hive image
+/// @param[in] Node Key node of the registry key
+/// @param[in] Depth Depth of the key below the hive root, to bound recursion on corrupted hives
+/// @param[in] SelectedKeys Patterns of the keys that are rendered, with their subkeys
+/// @param[in] Selections Progress of #SelectedKeys along the path to the key. Must have candidates.
+/// @param[in] ExcludedKeys Patterns of the keys that are not rendered, with their subkeys
+/// @param[in] Exclusions Progress of #ExcludedKeys along the path to the key
+/// @param[in,out] EscapedPath Escaped path to this key. The names of subkeys are appended to it
+///                            while they are visited, and removed afterwards.
+/// @param[in,out] NameBuffer Buffer for decoding names, kept across calls to spare allocations
+/// @param[in,out] Tasks Rendering tasks. The tasks rendering the selected keys and their subkeys are appended,
+///                      the tasks of each selected key starting with one that has its path. Each selected key is
+///                      preceded by tasks rendering only the paths of its ancestors below this key, so that the
+///                      .reg file can be imported again.
 /// @return HRESULT semantics
+/// @note Only the subkeys whose path a selection pattern may still match are visited. The subkeys of a selected key
+///       are rendered along with it, and are not matched against the selection patterns.
 _Must_inspect_result_
-HRESULT RenderRegistryKey
+static HRESULT SelectHiveKeys
 (
-    _In_ const HANDLE OutFileHandle,
-    _In_ const RegistryKey& RegKey,
-    _In_ const std::wstring &PathSoFar
+    _In_ const HiveImage& Image,
+    _In_ const HiveKeyNode& Node,
+    _In_ const SIZE_T Depth,
+    _In_ const KeyPathPatterns& SelectedKeys,
+    _In_ const KeyPathPatterns::Progress& Selections,
+    _In_ const KeyPathPatterns& ExcludedKeys,
+    _In_ const KeyPathPatterns::Progress& Exclusions,
+    _Inout_ std::wstring& EscapedPath,
+    _Inout_ std::wstring& NameBuffer,
+    _Inout_ std::vector<HiveViewRenderTask>& Tasks
 )
 {
     HRESULT Result = E_FAIL;
-    if (OutFileHandle == NULL || OutFileHandle == INVALID_HANDLE_VALUE)
-    {
-        ReportError(E_HANDLE, L"Invalid parameter");
-        return E_HANDLE;
-    }
+    std::vector<DWORD> SubkeyOffsets;
+    KeyPathPatterns::Progress SubkeySelections;
+    KeyPathPatterns::Progress SubkeyExclusions;
 
-    std::wstring NewPath;
-    if (PathSoFar.empty())
+    if (Depth > Constants::Hives::MaximalKeyDepth)
     {
-        NewPath = RegKey.Name;
+        ReportError(E_UNEXPECTED, L"Maximal key depth exceeded - Current key path: " + EscapedPath);
+        return E_UNEXPECTED;
     }
-    else
+
+    Result = GetSubkeyOffsets(Image, Node, SubkeyOffsets);
+    if (FAILED(Result))
     {
-        NewPath = PathSoFar + Constants::RegFiles::PathSeparator + RegKey.Name;
+        ReportError(Result, L"Getting subkey list - Current key path: " + EscapedPath);
+        return Result;
     }
 
-    std::wstring EscapedPath { NewPath };
-    GlobalStringSubstitute(EscapedPath, L"\n", L"\r\n");
-
+    for (SIZE_T SubkeyIndex = 0; SubkeyIndex < SubkeyOffsets.size(); ++SubkeyIndex)
     {
-        std::wostringstream KeySpecStream;
-        KeySpecStream << Constants::RegFiles::KeyOpening << EscapedPath << Constants::RegFiles::KeyClosing << Constants::RegFiles::NewLines;
-
-        Result = WriteStringBufferToFile(OutFileHandle, KeySpecStream.str());
+        HiveKeyNode SubkeyNode;
+        Result = GetKeyNode(Image, SubkeyOffsets[SubkeyIndex], SubkeyNode);
         if (FAILED(Result))
         {
-            ReportError(E_HANDLE, L"Could not write to output file");
+            std::wostringstream ErrorMessageStream;
+            ErrorMessageStream << L"Getting subkey at index " << SubkeyIndex << L" - Current key path: " << EscapedPath;
+            ReportError(Result, ErrorMessageStream.str());
             return Result;
         }
+
+        Regf::DecodeName(SubkeyNode.Name, SubkeyNode.NameLength, SubkeyNode.HasCompressedName(), NameBuffer);
+        if (ExcludedKeys.Advance(Exclusions, NameBuffer, SubkeyExclusions))
+        {
+            continue;
+        }
+
+        const bool Selected = SelectedKeys.Advance(Selections, NameBuffer, SubkeySelections);
+        if (!Selected && SubkeySelections.Candidates.empty())
+        {
+            continue;
+        }
+
+        const SIZE_T ParentLength = PushKeyPath(EscapedPath, NameBuffer);
+        if (Selected)
+        {
+            const SIZE_T TaskIndex = Tasks.size();
+            SIZE_T Length = 0;
+
+            Result = PlanHiveRenderTasks(Image, SubkeyNode, Depth + 1, SIZE_MAX, ExcludedKeys, SubkeyExclusions, NameBuffer, Tasks, Length);
+            if (FAILED(Result))
+            {
+                ReportError(Result, L"Could not plan rendering of registry key " + EscapedPath);
+                return Result;
+            }
+            Tasks[TaskIndex].EscapedPath = EscapedPath;
+        }
+        else
+        {
+            const SIZE_T TaskCount = Tasks.size();
+
+            Tasks.push_back(HiveViewRenderTask{ SubkeyNode, Depth + 1, SIZE_MAX, false, true, SubkeyExclusions, EscapedPath });
+            Result = SelectHiveKeys(Image, SubkeyNode, Depth + 1, SelectedKeys, SubkeySelections, ExcludedKeys, SubkeyExclusions, EscapedPath, NameBuffer, Tasks);
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+            if (Tasks.size() == TaskCount + 1)
+            {
+                // no key was selected below this one: its path is not needed
+                Tasks.pop_back();
+            }
+        }
+        EscapedPath.resize(ParentLength);
     }
 
-    for (const RegistryValue &Value : RegKey.Values)
+    return S_OK;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT HiveViewToRegfile
+(
+    _In_ const HiveView& View,
+    _In_ const std::wstring& RootName,
+    _In_ const KeyPathPatterns& SelectedKeys,
+    _In_ const KeyPathPatterns& ExcludedKeys,
+    _In_ const std::wstring& OutputFilePath,
+    _In_ const SIZE_T BufferSize,
+    _In_ const SIZE_T ThreadCount
+)
+{
+    HRESULT Result = E_FAIL;
+    std::vector<HiveViewRenderTask> Tasks;
+    std::wstring EscapedPath;
+    std::wstring NameBuffer;
+
+    PushKeyPath(EscapedPath, RootName);
+
+    if (SelectedKeys.empty())
     {
-        Result = RenderRegistryValue(OutFileHandle, Value);
+        SIZE_T Length = 0;
+        Result = PlanHiveRenderTasks(View.Image(), View.RootKey(), 0, SIZE_MAX, ExcludedKeys, ExcludedKeys.Start(), NameBuffer, Tasks, Length);
         if (FAILED(Result))
         {
-            ReportError(E_HANDLE, L"Could not render registry value" + Value.Name);
+            ReportError(Result, L"Could not plan rendering of hive");
             return Result;
         }
+        Tasks[0].EscapedPath = EscapedPath;
     }
-
+    else
     {
-        Result = WriteStringBufferToFile(OutFileHandle, Constants::RegFiles::NewLines );
+        // the .reg file has a single root key, of which the selected keys are descendants
+        Tasks.push_back(HiveViewRenderTask{ View.RootKey(), 0, SIZE_MAX, false, true, ExcludedKeys.Start(), EscapedPath });
+        Result = SelectHiveKeys(View.Image(), View.RootKey(), 0, SelectedKeys, SelectedKeys.Start(), ExcludedKeys, ExcludedKeys.Start(), EscapedPath, NameBuffer, Tasks);
         if (FAILED(Result))
         {
-            ReportError(E_HANDLE, L"Could not write to output file");
+            ReportError(Result, L"Could not select keys of hive");
+            return Result;
+        }
+        if (Tasks.size() == 1)
+        {
+            Result = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+            ReportError(Result, L"No key of the hive matches the selected paths");
             return Result;
         }
     }
 
-    for (const RegistryKey &Key : RegKey.Subkeys)
+    // the parent of a task always has a task of its own, that precedes it, and exported keys already have their paths
+    for (HiveViewRenderTask& Task : Tasks)
     {
-        Result = RenderRegistryKey(OutFileHandle, Key, NewPath);
-        if (FAILED(Result))
+        if (Task.ParentTask == SIZE_MAX)
         {
-            ReportError(E_HANDLE, L"Could not render registry key" + Key.Name);
-            return Result;
+            continue;
         }
+        Task.EscapedPath = Tasks[Task.ParentTask].EscapedPath;
+        Regf::DecodeName(Task.Node.Name, Task.Node.NameLength, Task.Node.HasCompressedName(), NameBuffer);
+        PushKeyPath(Task.EscapedPath, NameBuffer);
     }
 
-    return S_OK;
+    return RenderTasksToFile(OutputFilePath, BufferSize, ThreadCount, Tasks.size(), [&](std::wstring& Output, SIZE_T TaskIndex) -> HRESULT
+    {
+        HiveViewRenderTask& Task = Tasks[TaskIndex];
+        std::wstring TaskNameBuffer;
+        ValueData TaskDataBuffer;
+
+        if (Task.PathOnly)
+        {
+            RenderKeyPath(Output, Task.EscapedPath);
+            Output += Constants::RegFiles::NewLines;
+            return S_OK;
+        }
+        if (Task.WithSubkeys)
+        {
+            return RenderHiveKey(Output, View.Image(), Task.Node, Task.Depth, ExcludedKeys, Task.Exclusions, Task.EscapedPath, TaskNameBuffer, TaskDataBuffer);
+        }
+        return RenderHiveKeyAndValues(Output, View.Image(), Task.Node, Task.EscapedPath, TaskNameBuffer, TaskDataBuffer);
+    });
 }
 
 // non-static function: documented in header.
 _Must_inspect_result_
-HRESULT InternalToRegfile
+HRESULT HiveViewKeyToRegText
 (
-    _In_ const RegistryKey& RegKey,
-    _In_ const std::wstring& OutputFilePath
+    _In_ const HiveView& View,
+    _In_ const std::wstring& RootName,
+    _In_ const std::wstring& KeyPath,
+    _In_opt_ const std::wstring* ValueName,
+    _In_opt_ const HiveIndex* Index,
+    _Out_ std::wstring& Output
 )
 {
     HRESULT Result = E_FAIL;
-    HANDLE OutFileHandle = INVALID_HANDLE_VALUE;
+    SIZE_T KeyIndex = 0;
+    HiveKeyNode Node;
+    std::wstring StoredPath;
+    std::wstring EscapedPath;
+    std::wstring NameBuffer;
+    ValueData DataBuffer;
+
+    Output.clear();
 
-    OutFileHandle = CreateFileW(OutputFilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (OutFileHandle == INVALID_HANDLE_VALUE)
+    // the key is named as stored in the hive, whatever the case of the path it was looked up with
+    if (Index == nullptr)
     {
-        Result = HRESULT_FROM_WIN32(GetLastError());
-        ReportError(Result, L"Could not open file " + OutputFilePath + L" for writing");
-        goto Cleanup;
+        Result = View.OpenKey(KeyPath, Node, &StoredPath);
     }
-
+    else
     {
-        Result = WriteStringBufferToFile(OutFileHandle, Constants::RegFiles::Preamble);
-        if (FAILED(Result))
+        Result = Index->FindKey(KeyPath, KeyIndex);
+        if (SUCCEEDED(Result))
         {
-            ReportError(Result, L"Could not write to output file");
-            goto Cleanup;
+            Result = Index->GetKey(KeyIndex, Node);
+        }
+        if (SUCCEEDED(Result))
+        {
+            Result = Index->GetKeyPath(KeyIndex, StoredPath);
         }
     }
-
-    Result = RenderRegistryKey(OutFileHandle, RegKey, std::wstring{});
     if (FAILED(Result))
     {
-        ReportError(Result, L"Could not render registry key");
-        goto Cleanup;
+        ReportError(Result, L"Opening registry key " + KeyPath);
+        return Result;
     }
 
-    Result = S_OK;
+    PushKeyPath(EscapedPath, RootName);
+    if (!StoredPath.empty())
+    {
+        PushKeyPath(EscapedPath, StoredPath);
+    }
 
-Cleanup:
-    if (OutFileHandle != INVALID_HANDLE_VALUE)
+    if (ValueName == nullptr)
     {
-        CloseHandle(OutFileHandle);
-        OutFileHandle = INVALID_HANDLE_VALUE;
+        return RenderHiveKeyAndValues(Output, View.Image(), Node, EscapedPath, NameBuffer, DataBuffer);
     }
 
-    return Result;
-}
\ No newline at end of file
+    HiveValueNode ValueNode;
+    Result = Index == nullptr ? FindValue(View.Image(), Node, *ValueName, ValueNode) : Index->FindValue(KeyIndex, *ValueName, ValueNode);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Getting value " + *ValueName + L" - Current key path: " + EscapedPath);
+        return Result;
+    }
+
+    RenderKeyPath(Output, EscapedPath);
+    Result = RenderHiveValue(Output, View.Image(), ValueNode, EscapedPath, NameBuffer, DataBuffer);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+    Output += Constants::RegFiles::NewLines;
+
+    return S_OK;
+}
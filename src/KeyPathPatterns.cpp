@@ -0,0 +1,143 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "KeyPathPatterns.h"
+#include "Constants.h"
+#include "RegfFormat.h"
+
+/// @brief Uppercase a character of a key name, for case-insensitive matching
+/// @param[in] Char Character to uppercase
+/// @return Uppercase character
+static WCHAR FoldCase
+(
+    _In_ const WCHAR Char
+)
+{
+    if (static_cast<ULONG>(Char) > 0xFFFFu)
+    {
+        return Char;
+    }
+    return static_cast<WCHAR>(Regf::UpcaseCodeUnit(static_cast<WORD>(Char)));
+}
+
+/// @brief Match a key name against a pattern component
+/// @param[in] Pattern Pattern component, possibly with * and ? wildcards
+/// @param[in] Name Name of the key
+/// @return true if #Name matches #Pattern
+/// @note On a mismatch, the last * is retried one character further, so that matching never backtracks further back.
+static bool MatchComponent
+(
+    _In_ const std::wstring_view Pattern,
+    _In_ const std::wstring_view Name
+)
+{
+    SIZE_T PatternIndex = 0;
+    SIZE_T NameIndex = 0;
+    SIZE_T StarIndex = Pattern.npos;
+    SIZE_T StarNameIndex = 0;
+
+    while (NameIndex < Name.length())
+    {
+        if (PatternIndex < Pattern.length() && Pattern[PatternIndex] == Constants::Program::AnyCharactersWildcard)
+        {
+            StarIndex = PatternIndex++;
+            StarNameIndex = NameIndex;
+        }
+        else if (PatternIndex < Pattern.length() &&
+            (Pattern[PatternIndex] == Constants::Program::AnyCharacterWildcard || FoldCase(Pattern[PatternIndex]) == FoldCase(Name[NameIndex])))
+        {
+            ++PatternIndex;
+            ++NameIndex;
+        }
+        else if (StarIndex != Pattern.npos)
+        {
+            PatternIndex = StarIndex + 1;
+            NameIndex = ++StarNameIndex;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (PatternIndex < Pattern.length() && Pattern[PatternIndex] == Constants::Program::AnyCharactersWildcard)
+    {
+        ++PatternIndex;
+    }
+    return PatternIndex == Pattern.length();
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT KeyPathPatterns::Add
+(
+    _In_ const std::wstring_view Pattern
+)
+{
+    std::vector<std::wstring> Components;
+    SIZE_T ComponentStart = 0;
+
+    while (true)
+    {
+        const SIZE_T ComponentEnd = Pattern.find(Constants::RegFiles::PathSeparator, ComponentStart);
+        const std::wstring_view Component = Pattern.substr(ComponentStart, ComponentEnd == Pattern.npos ? Pattern.npos : ComponentEnd - ComponentStart);
+        if (Component.empty())
+        {
+            return E_INVALIDARG;
+        }
+        Components.emplace_back(Component);
+        if (ComponentEnd == Pattern.npos)
+        {
+            break;
+        }
+        ComponentStart = ComponentEnd + 1;
+    }
+
+    Patterns.push_back(std::move(Components));
+    return S_OK;
+}
+
+// non-static function: documented in header.
+KeyPathPatterns::Progress KeyPathPatterns::Start() const
+{
+    Progress Root;
+    for (SIZE_T PatternIndex = 0; PatternIndex < Patterns.size(); ++PatternIndex)
+    {
+        Root.Candidates.push_back(PatternIndex);
+    }
+    return Root;
+}
+
+// non-static function: documented in header.
+bool KeyPathPatterns::Advance
+(
+    _In_ const Progress& Parent,
+    _In_ const std::wstring_view Name,
+    _Out_ Progress& Child
+) const
+{
+    bool Matched = false;
+
+    Child.Depth = Parent.Depth + 1;
+    Child.Candidates.clear();
+
+    for (const SIZE_T PatternIndex : Parent.Candidates)
+    {
+        const std::vector<std::wstring>& Components = Patterns[PatternIndex];
+        if (!MatchComponent(Components[Parent.Depth], Name))
+        {
+            continue;
+        }
+        if (Components.size() == Child.Depth)
+        {
+            Matched = true;
+        }
+        else
+        {
+            Child.Candidates.push_back(PatternIndex);
+        }
+    }
+
+    return Matched;
+}
@@ -0,0 +1,60 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Patterns of registry key paths, relative to the hive root.
+/// Path components are separated by backslashes, and may contain the wildcards * (any sequence of characters)
+/// and ? (any single character). Names are compared case-insensitively, as the configuration manager does.
+/// @note Patterns are matched one key name at a time while walking down a tree, so that the keys that no
+///       pattern may reach are never visited.
+class KeyPathPatterns {
+public:
+    /// Progress of the patterns along the path to a key
+    struct Progress {
+        /// Count of components of the path to the key
+        SIZE_T Depth = 0;
+
+        /// Indices of the patterns that are longer than the path, and whose first #Depth components match it
+        std::vector<SIZE_T> Candidates;
+    };
+
+    /// @brief Add a pattern
+    /// @param[in] Pattern Path pattern relative to the hive root
+    /// @return HRESULT semantics: E_INVALIDARG if #Pattern has an empty component
+    _Must_inspect_result_
+    HRESULT Add
+    (
+        _In_ const std::wstring_view Pattern
+    );
+
+    /// @brief Check whether there is no pattern
+    bool empty() const { return Patterns.empty(); }
+
+    /// @brief Get the progress at the hive root, where all patterns are candidates
+    /// @return Progress at the hive root
+    Progress Start() const;
+
+    /// @brief Advance the progress of the patterns from a key to one of its subkeys
+    /// @param[in] Parent Progress at the parent key
+    /// @param[in] Name Name of the subkey
+    /// @param[out] Child Progress at the subkey
+    /// @return true if a pattern matches the whole path to the subkey
+    /// @note Nothing is matched when #Parent has no candidate, which is the common case: #Child is left empty.
+    bool Advance
+    (
+        _In_ const Progress& Parent,
+        _In_ const std::wstring_view Name,
+        _Out_ Progress& Child
+    ) const;
+
+private:
+    /// Components of each pattern
+    std::vector<std::vector<std::wstring>> Patterns;
+};
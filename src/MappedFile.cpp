@@ -0,0 +1,162 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "MappedFile.h"
+#include "CommonFunctions.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+_Must_inspect_result_
+HRESULT MappedFile::Open
+(
+    _In_ const std::wstring& FilePath,
+    _In_ const bool CopyOnWrite
+)
+{
+    HRESULT Result = E_FAIL;
+
+    Close();
+
+#ifdef _WIN32
+    LARGE_INTEGER FileSize;
+
+    FileHandle = CreateFileW(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+    {
+        Result = HRESULT_FROM_WIN32(GetLastError());
+        ReportError(Result, L"Opening file " + FilePath);
+        goto Cleanup;
+    }
+
+    if (!GetFileSizeEx(FileHandle, &FileSize))
+    {
+        Result = HRESULT_FROM_WIN32(GetLastError());
+        ReportError(Result, L"Getting file size of " + FilePath);
+        goto Cleanup;
+    }
+
+    if (static_cast<ULONGLONG>(FileSize.QuadPart) > static_cast<ULONGLONG>(static_cast<SIZE_T>(-1)))
+    {
+        Result = E_OUTOFMEMORY;
+        ReportError(Result, L"File " + FilePath + L" is too large to be mapped in the address space");
+        goto Cleanup;
+    }
+
+    if (FileSize.QuadPart == 0)
+    {
+        // CreateFileMappingW refuses empty files
+        Result = S_OK;
+        goto Cleanup;
+    }
+
+    MappingHandle = CreateFileMappingW(FileHandle, NULL, CopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    if (MappingHandle == NULL)
+    {
+        Result = HRESULT_FROM_WIN32(GetLastError());
+        ReportError(Result, L"Creating file mapping for " + FilePath);
+        goto Cleanup;
+    }
+
+    MappedData = (BYTE*)MapViewOfFile(MappingHandle, CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (MappedData == NULL)
+    {
+        Result = HRESULT_FROM_WIN32(GetLastError());
+        ReportError(Result, L"Mapping view of " + FilePath);
+        goto Cleanup;
+    }
+    MappedSize = static_cast<SIZE_T>(FileSize.QuadPart);
+    CopiedOnWrite = CopyOnWrite;
+#else
+    struct stat FileStatus;
+
+    FileDescriptor = open(PathToUtf8(FilePath).c_str(), O_RDONLY | O_CLOEXEC);
+    if (FileDescriptor == -1)
+    {
+        Result = HRESULT_FROM_WIN32(errno);
+        ReportError(Result, L"Opening file " + FilePath);
+        goto Cleanup;
+    }
+
+    if (fstat(FileDescriptor, &FileStatus) != 0)
+    {
+        Result = HRESULT_FROM_WIN32(errno);
+        ReportError(Result, L"Getting file size of " + FilePath);
+        goto Cleanup;
+    }
+
+    if (FileStatus.st_size == 0)
+    {
+        // mmap refuses empty lengths
+        Result = S_OK;
+        goto Cleanup;
+    }
+
+    {
+        void* View = mmap(nullptr, static_cast<size_t>(FileStatus.st_size), CopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+        if (View == MAP_FAILED)
+        {
+            Result = HRESULT_FROM_WIN32(errno);
+            ReportError(Result, L"Mapping view of " + FilePath);
+            goto Cleanup;
+        }
+        MappedData = static_cast<BYTE*>(View);
+        MappedSize = static_cast<SIZE_T>(FileStatus.st_size);
+        CopiedOnWrite = CopyOnWrite;
+    }
+#endif
+
+    Result = S_OK;
+
+Cleanup:
+    if (FAILED(Result))
+    {
+        Close();
+    }
+
+    return Result;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (MappedData != NULL)
+    {
+        UnmapViewOfFile((LPCVOID)MappedData);
+    }
+    if (MappingHandle != NULL)
+    {
+        CloseHandle(MappingHandle);
+        MappingHandle = NULL;
+    }
+    if (FileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(FileHandle);
+        FileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (MappedData != nullptr)
+    {
+        munmap(MappedData, MappedSize);
+    }
+    if (FileDescriptor != -1)
+    {
+        close(FileDescriptor);
+        FileDescriptor = -1;
+    }
+#endif
+    MappedData = nullptr;
+    MappedSize = 0;
+    CopiedOnWrite = false;
+}
@@ -0,0 +1,64 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <string>
+
+/// Read-only memory mapping of a whole file, or private copy-on-write mapping
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// @brief Map a file in memory for reading
+    /// @param[in] FilePath Path to the file
+    /// @param[in] CopyOnWrite Whether the mapping may be modified through #MutableData. Modified pages are
+    ///                        copied privately: the file itself is never modified.
+    /// @return HRESULT semantics
+    /// @note An empty file is mapped successfully, with a null #Data
+    _Must_inspect_result_
+    HRESULT Open
+    (
+        _In_ const std::wstring& FilePath,
+        _In_ const bool CopyOnWrite = false
+    );
+
+    /// @brief Unmap the file, if any. Pointers obtained from #Data become invalid.
+    void Close();
+
+    /// @brief Beginning of the mapped file contents
+    const BYTE* Data() const { return MappedData; }
+
+    /// @brief Beginning of the mapped file contents, for modification. Null unless mapped for copy-on-write.
+    BYTE* MutableData() const { return CopiedOnWrite ? MappedData : nullptr; }
+
+    /// @brief Size of the mapped file contents, in bytes
+    SIZE_T Size() const { return MappedSize; }
+
+private:
+    /// Beginning of the mapped view
+    BYTE* MappedData = nullptr;
+
+    /// Whether the view is a copy-on-write mapping
+    bool CopiedOnWrite = false;
+
+    /// Size of the mapped view, in bytes
+    SIZE_T MappedSize = 0;
+
+#ifdef _WIN32
+    /// Handle to the opened file
+    HANDLE FileHandle = INVALID_HANDLE_VALUE;
+
+    /// Handle to the file mapping object
+    HANDLE MappingHandle = NULL;
+#else
+    /// Descriptor of the opened file
+    int FileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,153 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "MonotonicArena.h"
+#include "Constants.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/// Block from which a thread currently carves its allocations
+struct ArenaThreadBlock {
+    /// Identifier of the arena that owns the block, zero if none
+    ULONGLONG ArenaIdentifier = 0;
+
+    /// First free byte of the block
+    BYTE* Cursor = nullptr;
+
+    /// End of the block
+    BYTE* End = nullptr;
+};
+
+/// Current block of the calling thread. Only one arena at a time is served from it.
+static thread_local ArenaThreadBlock CurrentThreadBlock;
+
+/// Source of arena identifiers
+static std::atomic<ULONGLONG> NextArenaIdentifier { 1 };
+
+/// @brief Carve an aligned allocation out of a free range of memory, if it fits
+/// @param[in,out] Cursor Beginning of the free range. Moved past the allocation.
+/// @param[in] End End of the free range
+/// @param[in] Bytes Size of the allocation
+/// @param[in] Alignment Alignment of the allocation, a power of 2
+/// @return Beginning of the allocation, or null if it does not fit
+static void* CarveAllocation
+(
+    _Inout_ BYTE*& Cursor,
+    _In_ const BYTE* End,
+    _In_ const SIZE_T Bytes,
+    _In_ const SIZE_T Alignment
+)
+{
+    const uintptr_t Aligned = (reinterpret_cast<uintptr_t>(Cursor) + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1);
+    if (Aligned > reinterpret_cast<uintptr_t>(End) || reinterpret_cast<uintptr_t>(End) - Aligned < Bytes)
+    {
+        return nullptr;
+    }
+    Cursor = reinterpret_cast<BYTE*>(Aligned + Bytes);
+    return Cursor - Bytes;
+}
+
+MonotonicArena::MonotonicArena() :
+    Identifier(NextArenaIdentifier++)
+{
+}
+
+MonotonicArena::~MonotonicArena()
+{
+    for (BYTE* Block : Blocks)
+    {
+        ::operator delete(Block);
+    }
+}
+
+BYTE* MonotonicArena::AllocateBlock
+(
+    _In_ const SIZE_T Size
+)
+{
+    BYTE* Block = static_cast<BYTE*>(::operator new(Size));
+
+    std::lock_guard<std::mutex> Lock(BlocksLock);
+    try
+    {
+        Blocks.push_back(Block);
+    }
+    catch (...)
+    {
+        ::operator delete(Block);
+        throw;
+    }
+    return Block;
+}
+
+void* MonotonicArena::do_allocate
+(
+    _In_ size_t Bytes,
+    _In_ size_t Alignment
+)
+{
+    ArenaThreadBlock& ThreadBlock = CurrentThreadBlock;
+
+#ifdef _DEBUG
+    AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    AllocatedBytes.fetch_add(Bytes, std::memory_order_relaxed);
+#endif
+
+    // same guarantee as operator new: byte buffers are read as arrays of WCHAR or DWORD elsewhere
+    Alignment = std::max<size_t>(Alignment, alignof(std::max_align_t));
+
+    if (ThreadBlock.ArenaIdentifier == Identifier)
+    {
+        void* Allocation = CarveAllocation(ThreadBlock.Cursor, ThreadBlock.End, Bytes, Alignment);
+        if (Allocation != nullptr)
+        {
+            return Allocation;
+        }
+    }
+
+    // large allocations get a block of their own, so that the current block of the thread is not wasted
+    if (Bytes + Alignment > Constants::Defaults::ArenaBlockSize / 4)
+    {
+        BYTE* Cursor = AllocateBlock(Bytes + Alignment);
+        return CarveAllocation(Cursor, Cursor + Bytes + Alignment, Bytes, Alignment);
+    }
+
+    ThreadBlock.Cursor = AllocateBlock(Constants::Defaults::ArenaBlockSize);
+    ThreadBlock.End = ThreadBlock.Cursor + Constants::Defaults::ArenaBlockSize;
+    ThreadBlock.ArenaIdentifier = Identifier;
+    return CarveAllocation(ThreadBlock.Cursor, ThreadBlock.End, Bytes, Alignment);
+}
+
+void MonotonicArena::do_deallocate
+(
+    _In_ void*,
+    _In_ size_t Bytes,
+    _In_ size_t
+)
+{
+    // memory is only released with the whole arena
+#ifdef _DEBUG
+    DeallocatedBytes.fetch_add(Bytes, std::memory_order_relaxed);
+#else
+    static_cast<void>(Bytes);
+#endif
+}
+
+#ifdef _DEBUG
+// non-static function: documented in header.
+MonotonicArena::Statistics MonotonicArena::GetStatistics() const
+{
+    return Statistics{ AllocationCount.load(), AllocatedBytes.load(), DeallocatedBytes.load() };
+}
+#endif
+
+bool MonotonicArena::do_is_equal
+(
+    _In_ const std::pmr::memory_resource& Other
+) const noexcept
+{
+    return this == &Other;
+}
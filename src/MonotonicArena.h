@@ -0,0 +1,89 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <atomic>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+/// Memory resource that never frees memory before being destroyed, and that may be shared by threads
+/// @note Each thread carves allocations out of a block of its own, so that allocations do not contend.
+///       Deallocations do nothing: all the blocks are released at once when the arena is destroyed.
+class MonotonicArena : public std::pmr::memory_resource {
+public:
+    MonotonicArena();
+    ~MonotonicArena() override;
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+#ifdef _DEBUG
+    /// Allocations served by an arena, counted in debug builds to check that conversions do not duplicate trees
+    struct Statistics {
+        /// Count of allocations
+        SIZE_T AllocationCount;
+
+        /// Total size of the allocations, in bytes
+        SIZE_T AllocatedBytes;
+
+        /// Total size of the allocations given back, in bytes. They stay unusable until the arena is destroyed.
+        SIZE_T DeallocatedBytes;
+    };
+
+    /// @brief Get the allocations served so far
+    /// @return Statistics of the arena
+    Statistics GetStatistics() const;
+#endif
+
+protected:
+    void* do_allocate
+    (
+        _In_ size_t Bytes,
+        _In_ size_t Alignment
+    ) override;
+
+    void do_deallocate
+    (
+        _In_ void* Pointer,
+        _In_ size_t Bytes,
+        _In_ size_t Alignment
+    ) override;
+
+    bool do_is_equal
+    (
+        _In_ const std::pmr::memory_resource& Other
+    ) const noexcept override;
+
+private:
+    /// @brief Allocate a block from the upstream allocator
+    /// @param[in] Size Size of the block in bytes
+    /// @return Beginning of the block
+    BYTE* AllocateBlock
+    (
+        _In_ const SIZE_T Size
+    );
+
+    /// Identifier of the arena, never reused, so that threads recognize the blocks they carve allocations from
+    const ULONGLONG Identifier;
+
+    /// Protects #Blocks
+    std::mutex BlocksLock;
+
+    /// All the blocks of the arena
+    std::vector<BYTE*> Blocks;
+
+#ifdef _DEBUG
+    /// Count of allocations
+    std::atomic<SIZE_T> AllocationCount { 0 };
+
+    /// Total size of the allocations, in bytes
+    std::atomic<SIZE_T> AllocatedBytes { 0 };
+
+    /// Total size of the allocations given back, in bytes
+    std::atomic<SIZE_T> DeallocatedBytes { 0 };
+#endif
+};
@@ -0,0 +1,50 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "NameTable.h"
+#include "Constants.h"
+#include <algorithm>
+#include <functional>
+
+NameTable::NameTable
+(
+    _In_ std::pmr::memory_resource* Resource
+) :
+    Resource(Resource)
+{
+    for (SIZE_T ShardIndex = 0; ShardIndex < Constants::Defaults::NameTableShardCount; ++ShardIndex)
+    {
+        Shards.emplace_back(Resource);
+    }
+}
+
+// non-static function: documented in header.
+RegistryName NameTable::Intern
+(
+    _In_ const std::wstring_view Name
+)
+{
+    if (Name.empty())
+    {
+        return RegistryName{};
+    }
+
+    // the low bits of the hash select the bucket within a shard: the high bits select the shard
+    const SIZE_T Hash = std::hash<std::wstring_view>{}(Name);
+    Shard& NameShard = Shards[(Hash >> (sizeof(SIZE_T) * 8 - 8)) % Shards.size()];
+
+    std::lock_guard<std::mutex> Lock(NameShard.Lock);
+
+    auto Existing = NameShard.Names.find(Name);
+    if (Existing != NameShard.Names.end())
+    {
+        return RegistryName{ &*Existing };
+    }
+
+    WCHAR* Characters = static_cast<WCHAR*>(Resource->allocate(Name.length() * sizeof(WCHAR), alignof(WCHAR)));
+    std::copy(Name.cbegin(), Name.cend(), Characters);
+
+    // elements of unordered sets never move: their addresses make stable handles
+    return RegistryName{ &*NameShard.Names.emplace(Characters, Name.length()).first };
+}
@@ -0,0 +1,128 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <deque>
+#include <memory_resource>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+/// Name of a registry key or value, interned in a #NameTable.
+/// Names interned in the same table are equal if and only if their handles are equal.
+/// @note A default-constructed name is the empty name, which is never stored in a table.
+class RegistryName {
+public:
+    RegistryName() = default;
+
+    /// @brief Get the characters of the name
+    /// @return Characters of the name, valid as long as the table that interned it
+    std::wstring_view View() const
+    {
+        return Entry == nullptr ? std::wstring_view{} : *Entry;
+    }
+
+    operator std::wstring_view() const
+    {
+        return View();
+    }
+
+    /// @brief Check whether the name is empty
+    bool empty() const
+    {
+        return Entry == nullptr;
+    }
+
+    /// @brief Get the length of the name, in code units
+    SIZE_T length() const
+    {
+        return View().length();
+    }
+
+    /// @brief Compare two names interned in the same table
+    bool operator==(const RegistryName& Other) const
+    {
+        return Entry == Other.Entry;
+    }
+
+    bool operator!=(const RegistryName& Other) const
+    {
+        return Entry != Other.Entry;
+    }
+
+private:
+    friend class NameTable;
+
+    explicit RegistryName(const std::wstring_view* Entry) :
+        Entry(Entry)
+    {
+    }
+
+    /// Entry of the name in its table, or null for the empty name
+    const std::wstring_view* Entry = nullptr;
+};
+
+/// @brief Concatenate a string and a name, typically in error messages
+inline std::wstring operator+(std::wstring Left, const RegistryName& Right)
+{
+    return Left.append(Right.View());
+}
+
+/// @brief Concatenate a string and a name, typically in error messages
+inline std::wstring operator+(const WCHAR* Left, const RegistryName& Right)
+{
+    return std::wstring{ Left }.append(Right.View());
+}
+
+/// @brief Write a name to a stream, typically in error messages
+inline std::wostream& operator<<(std::wostream& Stream, const RegistryName& Name)
+{
+    return Stream << Name.View();
+}
+
+/// Set of the distinct names of a registry tree, so that each name is stored once whatever the count of keys
+/// and values bearing it.
+/// @note Names may be interned by several threads at once: the table is split into shards that are locked separately.
+class NameTable {
+public:
+    /// @brief Create an empty table
+    /// @param[in] Resource Memory resource holding the interned names, typically the #MonotonicArena of the tree
+    explicit NameTable(std::pmr::memory_resource* Resource = std::pmr::get_default_resource());
+
+    NameTable(const NameTable&) = delete;
+    NameTable& operator=(const NameTable&) = delete;
+
+    /// @brief Get the interned name equal to a string, interning it if needed
+    /// @param[in] Name Characters of the name
+    /// @return Interned name, valid as long as the table
+    RegistryName Intern
+    (
+        _In_ const std::wstring_view Name
+    );
+
+private:
+    /// Part of the table, holding the names whose hash selects it
+    struct Shard {
+        explicit Shard(std::pmr::memory_resource* Resource) :
+            Names(Resource)
+        {
+        }
+
+        /// Protects #Names
+        std::mutex Lock;
+
+        /// Interned names. Their characters are stored in the memory resource of the table.
+        std::pmr::unordered_set<std::wstring_view> Names;
+    };
+
+    /// Memory resource holding the names
+    std::pmr::memory_resource* Resource;
+
+    /// Shards of the table, which are not movable
+    std::deque<Shard> Shards;
+};
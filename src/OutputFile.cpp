@@ -0,0 +1,138 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "OutputFile.h"
+#include "CommonFunctions.h"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+OutputFile::~OutputFile()
+{
+    Close();
+}
+
+_Must_inspect_result_
+HRESULT OutputFile::Create
+(
+    _In_ const std::wstring& FilePath
+)
+{
+    HRESULT Result = E_FAIL;
+
+    Close();
+
+#ifdef _WIN32
+    FileHandle = CreateFileW(FilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+    {
+        Result = HRESULT_FROM_WIN32(GetLastError());
+        ReportError(Result, L"Could not open file " + FilePath + L" for writing");
+        return Result;
+    }
+#else
+    FileDescriptor = open(PathToUtf8(FilePath).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (FileDescriptor == -1)
+    {
+        Result = HRESULT_FROM_WIN32(errno);
+        ReportError(Result, L"Could not open file " + FilePath + L" for writing");
+        return Result;
+    }
+#endif
+
+    return S_OK;
+}
+
+_Must_inspect_result_
+HRESULT OutputFile::Write
+(
+    _In_ const void* Data,
+    _In_ const SIZE_T Size
+)
+{
+    HRESULT Result = E_FAIL;
+    const BYTE* Remaining = static_cast<const BYTE*>(Data);
+    SIZE_T RemainingSize = Size;
+
+#ifdef _WIN32
+    if (FileHandle == INVALID_HANDLE_VALUE)
+    {
+        ReportError(E_HANDLE, L"Invalid parameter");
+        return E_HANDLE;
+    }
+
+    while (RemainingSize != 0)
+    {
+        const DWORD BytesToWrite = static_cast<DWORD>(std::min<SIZE_T>(RemainingSize, MAXDWORD));
+        DWORD BytesWritten = 0;
+
+        if (!WriteFile(FileHandle, (LPCVOID)Remaining, BytesToWrite, &BytesWritten, NULL))
+        {
+            Result = HRESULT_FROM_WIN32(GetLastError());
+            ReportError(Result, L"Could not write to output file");
+            return Result;
+        }
+        if (BytesWritten == 0)
+        {
+            Result = E_UNEXPECTED;
+            ReportError(Result, L"Bytes not fully written to file");
+            return Result;
+        }
+        Remaining += BytesWritten;
+        RemainingSize -= BytesWritten;
+    }
+#else
+    if (FileDescriptor == -1)
+    {
+        ReportError(E_HANDLE, L"Invalid parameter");
+        return E_HANDLE;
+    }
+
+    while (RemainingSize != 0)
+    {
+        const ssize_t BytesWritten = write(FileDescriptor, Remaining, RemainingSize);
+        if (BytesWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Result = HRESULT_FROM_WIN32(errno);
+            ReportError(Result, L"Could not write to output file");
+            return Result;
+        }
+        if (BytesWritten == 0)
+        {
+            Result = E_UNEXPECTED;
+            ReportError(Result, L"Bytes not fully written to file");
+            return Result;
+        }
+        Remaining += BytesWritten;
+        RemainingSize -= static_cast<SIZE_T>(BytesWritten);
+    }
+#endif
+
+    return S_OK;
+}
+
+void OutputFile::Close()
+{
+#ifdef _WIN32
+    if (FileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(FileHandle);
+        FileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (FileDescriptor != -1)
+    {
+        close(FileDescriptor);
+        FileDescriptor = -1;
+    }
+#endif
+}
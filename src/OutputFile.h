@@ -0,0 +1,51 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <string>
+
+/// File opened for sequential writing
+class OutputFile {
+public:
+    OutputFile() = default;
+    ~OutputFile();
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    /// @brief Create a file for writing
+    /// @param[in] FilePath Path to the file
+    /// @return HRESULT semantics
+    /// @note #FilePath is overwritten if it already exists
+    _Must_inspect_result_
+    HRESULT Create
+    (
+        _In_ const std::wstring& FilePath
+    );
+
+    /// @brief Append bytes at the end of the file
+    /// @param[in] Data Bytes to write
+    /// @param[in] Size Count of bytes to write
+    /// @return HRESULT semantics
+    _Must_inspect_result_
+    HRESULT Write
+    (
+        _In_ const void* Data,
+        _In_ const SIZE_T Size
+    );
+
+    /// @brief Close the file, if any
+    void Close();
+
+private:
+#ifdef _WIN32
+    /// Handle to the opened file
+    HANDLE FileHandle = INVALID_HANDLE_VALUE;
+#else
+    /// Descriptor of the opened file
+    int FileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,86 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "OutputSink.h"
+#include "Constants.h"
+#include "CommonFunctions.h"
+#include "RegfFormat.h"
+#include <algorithm>
+
+_Must_inspect_result_
+HRESULT OutputSink::Create
+(
+    _In_ const std::wstring& FilePath,
+    _In_ const SIZE_T BufferSize
+)
+{
+    HRESULT Result = E_FAIL;
+
+    Close();
+
+    Result = File.Create(FilePath);
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    this->BufferSize = std::max<SIZE_T>(BufferSize, Constants::Defaults::OutputBlockSize);
+    Pending.reserve(this->BufferSize / sizeof(WCHAR));
+
+    return S_OK;
+}
+
+_Must_inspect_result_
+HRESULT OutputSink::FlushCompleteBlocks()
+{
+    const SIZE_T PendingSize = Pending.length() * sizeof(WCHAR);
+
+    if (PendingSize < BufferSize)
+    {
+        return S_OK;
+    }
+
+    // whole blocks only: block boundaries are also code unit boundaries
+    const SIZE_T SizeToWrite = PendingSize - PendingSize % Constants::Defaults::OutputBlockSize;
+
+    return WritePending(SizeToWrite / sizeof(WCHAR));
+}
+
+_Must_inspect_result_
+HRESULT OutputSink::Flush()
+{
+    return WritePending(Pending.length());
+}
+
+_Must_inspect_result_
+HRESULT OutputSink::WritePending
+(
+    _In_ const SIZE_T Count
+)
+{
+    HRESULT Result = E_FAIL;
+
+#if WCHAR_MAX > 0xFFFF
+    // wide strings hold UTF-32: the file gets the same UTF-16LE text as on Windows
+    Encoded.clear();
+    Regf::AppendUtf16(std::wstring_view{ Pending }.substr(0, Count), Encoded);
+    Result = File.Write(Encoded.data(), Encoded.size());
+#else
+    Result = File.Write(Pending.data(), Count * sizeof(WCHAR));
+#endif
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    Pending.erase(0, Count);
+
+    return S_OK;
+}
+
+void OutputSink::Close()
+{
+    File.Close();
+    Pending.clear();
+}
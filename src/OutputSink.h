@@ -0,0 +1,78 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include "OutputFile.h"
+#include <string>
+#include <vector>
+
+/// Text file written through a large buffer, so that many small fragments end up in few large writes.
+/// The file is written as UTF-16LE, whatever the size of wide characters.
+class OutputSink {
+public:
+    OutputSink() = default;
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    /// @brief Create a file for writing
+    /// @param[in] FilePath Path to the file
+    /// @param[in] BufferSize Size in bytes above which the buffer is written to the file
+    /// @return HRESULT semantics
+    /// @note #FilePath is overwritten if it already exists
+    _Must_inspect_result_
+    HRESULT Create
+    (
+        _In_ const std::wstring& FilePath,
+        _In_ const SIZE_T BufferSize
+    );
+
+    /// @brief Access the buffer, to which text is appended directly
+    /// @return Pending text, not yet written to the file
+    /// @note Call #FlushCompleteBlocks once in a while, so that the buffer does not grow indefinitely
+    std::wstring& Buffer()
+    {
+        return Pending;
+    }
+
+    /// @brief Write the buffer to the file if it is full, by whole blocks
+    /// @return HRESULT semantics
+    /// @note Text past the last complete block stays in the buffer
+    _Must_inspect_result_
+    HRESULT FlushCompleteBlocks();
+
+    /// @brief Write the whole buffer to the file
+    /// @return HRESULT semantics
+    _Must_inspect_result_
+    HRESULT Flush();
+
+    /// @brief Close the file, if any. Text still in the buffer is discarded.
+    void Close();
+
+private:
+    /// @brief Write the first code units of the buffer to the file, as UTF-16LE, and remove them from the buffer
+    /// @param[in] Count Count of code units to write
+    /// @return HRESULT semantics
+    _Must_inspect_result_
+    HRESULT WritePending
+    (
+        _In_ const SIZE_T Count
+    );
+
+    /// Underlying file
+    OutputFile File;
+
+    /// Text not yet written to #File
+    std::wstring Pending;
+
+    /// Size in bytes above which #Pending is written to #File
+    SIZE_T BufferSize = 0;
+
+#if WCHAR_MAX > 0xFFFF
+    /// UTF-16LE encoding of the text being written, where wide strings hold UTF-32
+    std::vector<BYTE> Encoded;
+#endif
+};
@@ -0,0 +1,153 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "ParallelTasks.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// non-static function: documented in header.
+SIZE_T DefaultThreadCount()
+{
+    return std::max<SIZE_T>(1u, std::thread::hardware_concurrency());
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT RunParallelTasks
+(
+    _In_ const SIZE_T TaskCount,
+    _In_ const SIZE_T ThreadCount,
+    _In_ const std::function<HRESULT(SIZE_T TaskIndex)>& Task
+)
+{
+    std::vector<HRESULT> Results(TaskCount, S_OK);
+    std::atomic<SIZE_T> NextTaskIndex{ 0 };
+    std::atomic<bool> TaskFailed{ false };
+    std::vector<std::thread> Workers;
+
+    auto RunTasks = [&]()
+    {
+        while (!TaskFailed.load(std::memory_order_relaxed))
+        {
+            const SIZE_T TaskIndex = NextTaskIndex.fetch_add(1);
+            if (TaskIndex >= TaskCount)
+            {
+                break;
+            }
+            Results[TaskIndex] = Task(TaskIndex);
+            if (FAILED(Results[TaskIndex]))
+            {
+                TaskFailed.store(true, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // the calling thread is one of the workers
+    const SIZE_T WorkerCount = std::min(ThreadCount, TaskCount);
+    for (SIZE_T WorkerIndex = 1; WorkerIndex < WorkerCount; ++WorkerIndex)
+    {
+        Workers.emplace_back(RunTasks);
+    }
+    RunTasks();
+    for (std::thread& Worker : Workers)
+    {
+        Worker.join();
+    }
+
+    for (const HRESULT Result : Results)
+    {
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+    }
+    return S_OK;
+}
+
+WorkQueue::WorkQueue
+(
+    _In_ const SIZE_T ThreadCount
+) :
+    ThreadCount(std::max<SIZE_T>(1u, ThreadCount))
+{
+}
+
+// non-static function: documented in header.
+void WorkQueue::Push
+(
+    _Inout_ Task&& NewTask
+)
+{
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        Tasks.push_back(std::move(NewTask));
+    }
+    Changed.notify_one();
+}
+
+// non-static function: documented in header.
+bool WorkQueue::IsShort()
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Tasks.size() < ThreadCount;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT WorkQueue::Run()
+{
+    std::vector<std::thread> Workers;
+
+    auto RunTasks = [&]()
+    {
+        std::unique_lock<std::mutex> Guard(Lock);
+        while (true)
+        {
+            // threads wait for tasks as long as running tasks may add some
+            Changed.wait(Guard, [&]() { return !Tasks.empty() || RunningTaskCount == 0; });
+            if (Tasks.empty())
+            {
+                break;
+            }
+
+            Task CurrentTask = std::move(Tasks.front());
+            Tasks.pop_front();
+
+            // once a task has failed, the remaining tasks are only dequeued
+            if (SUCCEEDED(Result))
+            {
+                RunningTaskCount += 1;
+                Guard.unlock();
+                const HRESULT TaskResult = CurrentTask();
+                Guard.lock();
+                RunningTaskCount -= 1;
+
+                if (FAILED(TaskResult) && SUCCEEDED(Result))
+                {
+                    Result = TaskResult;
+                }
+            }
+
+            if (RunningTaskCount == 0 && Tasks.empty())
+            {
+                Changed.notify_all();
+            }
+        }
+    };
+
+    // the calling thread is one of the workers
+    for (SIZE_T WorkerIndex = 1; WorkerIndex < ThreadCount; ++WorkerIndex)
+    {
+        Workers.emplace_back(RunTasks);
+    }
+    RunTasks();
+    for (std::thread& Worker : Workers)
+    {
+        Worker.join();
+    }
+
+    return Result;
+}
@@ -0,0 +1,81 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/// @brief Get the default count of worker threads
+/// @return Count of hardware threads, at least 1
+SIZE_T DefaultThreadCount();
+
+/// @brief Run independent tasks on worker threads
+/// @param[in] TaskCount Count of tasks, indexed from 0
+/// @param[in] ThreadCount Maximal count of threads running tasks, including the calling thread
+/// @param[in] Task Function running the task of a given index
+/// @return HRESULT semantics: S_OK if all tasks succeeded, otherwise the result of the failed task with the lowest index
+/// @note Tasks are handed out in index order to the first idle thread. Once a task has failed, the tasks that have
+///       not started yet are skipped.
+_Must_inspect_result_
+HRESULT RunParallelTasks
+(
+    _In_ const SIZE_T TaskCount,
+    _In_ const SIZE_T ThreadCount,
+    _In_ const std::function<HRESULT(SIZE_T TaskIndex)>& Task
+);
+
+/// Queue of independent tasks run by worker threads, to which running tasks may add more tasks.
+/// Tasks that find a large amount of work split it into new tasks when the queue runs short, so that idle threads
+/// take over parts of it.
+class WorkQueue {
+public:
+    using Task = std::function<HRESULT()>;
+
+    /// @brief Create an empty queue
+    /// @param[in] ThreadCount Maximal count of threads running tasks, including the calling thread of #Run
+    explicit WorkQueue(_In_ const SIZE_T ThreadCount);
+
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+
+    /// @brief Add a task to the queue. May be called by running tasks.
+    /// @param[in] NewTask Task to run
+    void Push
+    (
+        _Inout_ Task&& NewTask
+    );
+
+    /// @brief Check whether running tasks had better split their work, because threads may soon run out of tasks
+    /// @return true if fewer tasks are waiting than there are threads
+    bool IsShort();
+
+    /// @brief Run the tasks of the queue, and the tasks they add, until none is left
+    /// @return HRESULT semantics: S_OK if all tasks succeeded, otherwise the result of the first task that failed
+    /// @note Once a task has failed, the tasks that have not started yet are skipped.
+    _Must_inspect_result_
+    HRESULT Run();
+
+private:
+    /// Maximal count of threads running tasks
+    const SIZE_T ThreadCount;
+
+    /// Protects the members below
+    std::mutex Lock;
+
+    /// Signaled when a task is added, or when the last running task ends
+    std::condition_variable Changed;
+
+    /// Tasks waiting for a thread
+    std::deque<Task> Tasks;
+
+    /// Count of tasks being run
+    SIZE_T RunningTaskCount = 0;
+
+    /// Result of the first task that failed, S_OK if none
+    HRESULT Result = S_OK;
+};
@@ -0,0 +1,102 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+// Modules that do not need the Win32 API beyond basic types and HRESULT semantics
+// include this header instead of <windows.h>, so that they also build on other platforms.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cwchar>
+
+typedef uint8_t BYTE;
+typedef BYTE* PBYTE;
+typedef uint16_t WORD;
+typedef uint16_t USHORT;
+typedef uint32_t DWORD;
+typedef uint32_t ULONG;
+typedef uint64_t ULONGLONG;
+typedef int32_t LONG;
+typedef int32_t HRESULT;
+typedef int INT;
+typedef int BOOL;
+typedef size_t SIZE_T;
+typedef wchar_t WCHAR;
+typedef WCHAR* PWCHAR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef void VOID;
+typedef void* PVOID;
+typedef const void* LPCVOID;
+
+#define CONST const
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+#define MAXDWORD 0xffffffffu
+
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _Inout_opt_
+#define _Must_inspect_result_
+
+#define CopyMemory(Destination, Source, Length) std::memcpy((Destination), (Source), (Length))
+#define MoveMemory(Destination, Source, Length) std::memmove((Destination), (Source), (Length))
+#define ZeroMemory(Destination, Length) std::memset((Destination), 0, (Length))
+
+/// @brief Compare the first characters of two wide strings case-insensitively, as the CRT function of Windows does
+inline int _wcsnicmp(const WCHAR* Left, const WCHAR* Right, size_t Count)
+{
+    return wcsncasecmp(Left, Right, Count);
+}
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define HRESULT_FACILITY(hr) (((hr) >> 16) & 0x1fff)
+#define HRESULT_CODE(hr) ((hr) & 0xFFFF)
+#define FACILITY_WIN32 7
+#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT) (((x) & 0x0000FFFF) | (FACILITY_WIN32 << 16) | 0x80000000)))
+
+#define S_OK ((HRESULT)0L)
+#define S_FALSE ((HRESULT)1L)
+#define E_UNEXPECTED ((HRESULT)0x8000FFFFL)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define E_HANDLE ((HRESULT)0x80070006L)
+#define E_PENDING ((HRESULT)0x8000000AL)
+#define E_FAIL ((HRESULT)0x80004005L)
+
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_INVALID_DATA 13L
+#define ERROR_ARITHMETIC_OVERFLOW 534L
+
+#define REG_NONE 0ul
+#define REG_SZ 1ul
+#define REG_EXPAND_SZ 2ul
+#define REG_BINARY 3ul
+#define REG_DWORD 4ul
+#define REG_DWORD_BIG_ENDIAN 5ul
+#define REG_LINK 6ul
+#define REG_MULTI_SZ 7ul
+#define REG_RESOURCE_LIST 8ul
+#define REG_FULL_RESOURCE_DESCRIPTOR 9ul
+#define REG_RESOURCE_REQUIREMENTS_LIST 10ul
+#define REG_QWORD 11ul
+
+#endif
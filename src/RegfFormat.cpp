@@ -0,0 +1,482 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "RegfFormat.h"
+#include <cwchar>
+#include <vector>
+
+namespace Regf {
+
+    DWORD BaseBlockChecksum
+    (
+        _In_ const BYTE* BaseBlockData
+    )
+    {
+        DWORD Checksum = 0;
+        for (SIZE_T Offset = 0; Offset < BaseBlock::ChecksumOffset; Offset += sizeof(DWORD))
+        {
+            Checksum ^= ReadDword(BaseBlockData + Offset);
+        }
+
+        // 0 and -1 are reserved
+        if (Checksum == 0xFFFFFFFFu)
+        {
+            return 0xFFFFFFFEu;
+        }
+        if (Checksum == 0)
+        {
+            return 1;
+        }
+        return Checksum;
+    }
+
+    /// @brief Mix a Marvin32 state
+    /// @param[in,out] Low Low half of the state
+    /// @param[in,out] High High half of the state
+    static void Marvin32Block
+    (
+        _Inout_ DWORD& Low,
+        _Inout_ DWORD& High
+    )
+    {
+        High ^= Low;
+        Low = (Low << 20) | (Low >> 12);
+        Low += High;
+        High = (High << 9) | (High >> 23);
+        High ^= Low;
+        Low = (Low << 27) | (Low >> 5);
+        Low += High;
+        High = (High << 19) | (High >> 13);
+    }
+
+    ULONGLONG Marvin32
+    (
+        _In_ const BYTE* Data,
+        _In_ const SIZE_T Size,
+        _In_ const ULONGLONG Seed
+    )
+    {
+        DWORD Low = static_cast<DWORD>(Seed);
+        DWORD High = static_cast<DWORD>(Seed >> 32);
+        SIZE_T Offset = 0;
+
+        for (; Offset + sizeof(DWORD) <= Size; Offset += sizeof(DWORD))
+        {
+            Low += ReadDword(Data + Offset);
+            Marvin32Block(Low, High);
+        }
+
+        // the last bytes are padded with a single set bit
+        DWORD Final = 0x80u;
+        for (SIZE_T Index = Size; Index > Offset; --Index)
+        {
+            Final = (Final << 8) | Data[Index - 1];
+        }
+        Low += Final;
+        Marvin32Block(Low, High);
+        Marvin32Block(Low, High);
+
+        return (static_cast<ULONGLONG>(High) << 32) | Low;
+    }
+
+    /// Range of code units sharing the same distance to their uppercase code units
+    struct UpcaseRange {
+        /// First code unit of the range
+        WORD First;
+
+        /// Last code unit of the range
+        WORD Last;
+
+        /// Distance from each code unit of the range to its uppercase code unit
+        int Delta;
+
+        /// Distance between consecutive code units of the range: 2 where lowercase and uppercase letters alternate
+        int Step;
+    };
+
+    /// Simple uppercase mappings of the Unicode character database, for the characters of the basic multilingual
+    /// plane known to the upcase table of the system (Unicode 3.2, plus the Latin, Cyrillic, Georgian, Glagolitic
+    /// and Coptic blocks added up to Unicode 5.1)
+    static const UpcaseRange UpcaseRanges[] = {
+        { 0x0061u, 0x007Au, -32, 1 },
+        { 0x00B5u, 0x00B5u, 743, 1 },
+        { 0x00E0u, 0x00F6u, -32, 1 },
+        { 0x00F8u, 0x00FEu, -32, 1 },
+        { 0x00FFu, 0x00FFu, 121, 1 },
+        { 0x0101u, 0x012Fu, -1, 2 },
+        { 0x0131u, 0x0131u, -232, 1 },
+        { 0x0133u, 0x0137u, -1, 2 },
+        { 0x013Au, 0x0148u, -1, 2 },
+        { 0x014Bu, 0x0177u, -1, 2 },
+        { 0x017Au, 0x017Eu, -1, 2 },
+        { 0x017Fu, 0x017Fu, -300, 1 },
+        { 0x0183u, 0x0185u, -1, 2 },
+        { 0x0188u, 0x0188u, -1, 1 },
+        { 0x018Cu, 0x018Cu, -1, 1 },
+        { 0x0192u, 0x0192u, -1, 1 },
+        { 0x0195u, 0x0195u, 97, 1 },
+        { 0x0199u, 0x0199u, -1, 1 },
+        { 0x019Eu, 0x019Eu, 130, 1 },
+        { 0x01A1u, 0x01A5u, -1, 2 },
+        { 0x01A8u, 0x01A8u, -1, 1 },
+        { 0x01ADu, 0x01ADu, -1, 1 },
+        { 0x01B0u, 0x01B0u, -1, 1 },
+        { 0x01B4u, 0x01B6u, -1, 2 },
+        { 0x01B9u, 0x01B9u, -1, 1 },
+        { 0x01BDu, 0x01BDu, -1, 1 },
+        { 0x01BFu, 0x01BFu, 56, 1 },
+        { 0x01C5u, 0x01C5u, -1, 1 },
+        { 0x01C6u, 0x01C6u, -2, 1 },
+        { 0x01C8u, 0x01C8u, -1, 1 },
+        { 0x01C9u, 0x01C9u, -2, 1 },
+        { 0x01CBu, 0x01CBu, -1, 1 },
+        { 0x01CCu, 0x01CCu, -2, 1 },
+        { 0x01CEu, 0x01DCu, -1, 2 },
+        { 0x01DDu, 0x01DDu, -79, 1 },
+        { 0x01DFu, 0x01EFu, -1, 2 },
+        { 0x01F2u, 0x01F2u, -1, 1 },
+        { 0x01F3u, 0x01F3u, -2, 1 },
+        { 0x01F5u, 0x01F5u, -1, 1 },
+        { 0x01F9u, 0x021Fu, -1, 2 },
+        { 0x0223u, 0x0233u, -1, 2 },
+        { 0x0250u, 0x0250u, 10783, 1 },
+        { 0x0251u, 0x0251u, 10780, 1 },
+        { 0x0252u, 0x0252u, 10782, 1 },
+        { 0x0253u, 0x0253u, -210, 1 },
+        { 0x0254u, 0x0254u, -206, 1 },
+        { 0x0256u, 0x0257u, -205, 1 },
+        { 0x0259u, 0x0259u, -202, 1 },
+        { 0x025Bu, 0x025Bu, -203, 1 },
+        { 0x0260u, 0x0260u, -205, 1 },
+        { 0x0263u, 0x0263u, -207, 1 },
+        { 0x0265u, 0x0265u, 42280, 1 },
+        { 0x0268u, 0x0268u, -209, 1 },
+        { 0x0269u, 0x0269u, -211, 1 },
+        { 0x026Bu, 0x026Bu, 10743, 1 },
+        { 0x026Fu, 0x026Fu, -211, 1 },
+        { 0x0271u, 0x0271u, 10749, 1 },
+        { 0x0272u, 0x0272u, -213, 1 },
+        { 0x0275u, 0x0275u, -214, 1 },
+        { 0x027Du, 0x027Du, 10727, 1 },
+        { 0x0280u, 0x0280u, -218, 1 },
+        { 0x0283u, 0x0283u, -218, 1 },
+        { 0x0288u, 0x0288u, -218, 1 },
+        { 0x028Au, 0x028Bu, -217, 1 },
+        { 0x0292u, 0x0292u, -219, 1 },
+        { 0x0345u, 0x0345u, 84, 1 },
+        { 0x03ACu, 0x03ACu, -38, 1 },
+        { 0x03ADu, 0x03AFu, -37, 1 },
+        { 0x03B1u, 0x03C1u, -32, 1 },
+        { 0x03C2u, 0x03C2u, -31, 1 },
+        { 0x03C3u, 0x03CBu, -32, 1 },
+        { 0x03CCu, 0x03CCu, -64, 1 },
+        { 0x03CDu, 0x03CEu, -63, 1 },
+        { 0x03D0u, 0x03D0u, -62, 1 },
+        { 0x03D1u, 0x03D1u, -57, 1 },
+        { 0x03D5u, 0x03D5u, -47, 1 },
+        { 0x03D6u, 0x03D6u, -54, 1 },
+        { 0x03D9u, 0x03EFu, -1, 2 },
+        { 0x03F0u, 0x03F0u, -86, 1 },
+        { 0x03F1u, 0x03F1u, -80, 1 },
+        { 0x03F5u, 0x03F5u, -96, 1 },
+        { 0x0430u, 0x044Fu, -32, 1 },
+        { 0x0450u, 0x045Fu, -80, 1 },
+        { 0x0461u, 0x0481u, -1, 2 },
+        { 0x048Bu, 0x04BFu, -1, 2 },
+        { 0x04C2u, 0x04CEu, -1, 2 },
+        { 0x04D1u, 0x04F5u, -1, 2 },
+        { 0x04F9u, 0x04F9u, -1, 1 },
+        { 0x0501u, 0x052Fu, -1, 2 },
+        { 0x0561u, 0x0586u, -48, 1 },
+        { 0x1E01u, 0x1E95u, -1, 2 },
+        { 0x1E9Bu, 0x1E9Bu, -59, 1 },
+        { 0x1EA1u, 0x1EF9u, -1, 2 },
+        { 0x1F00u, 0x1F07u, 8, 1 },
+        { 0x1F10u, 0x1F15u, 8, 1 },
+        { 0x1F20u, 0x1F27u, 8, 1 },
+        { 0x1F30u, 0x1F37u, 8, 1 },
+        { 0x1F40u, 0x1F45u, 8, 1 },
+        { 0x1F51u, 0x1F57u, 8, 2 },
+        { 0x1F60u, 0x1F67u, 8, 1 },
+        { 0x1F70u, 0x1F71u, 74, 1 },
+        { 0x1F72u, 0x1F75u, 86, 1 },
+        { 0x1F76u, 0x1F77u, 100, 1 },
+        { 0x1F78u, 0x1F79u, 128, 1 },
+        { 0x1F7Au, 0x1F7Bu, 112, 1 },
+        { 0x1F7Cu, 0x1F7Du, 126, 1 },
+        { 0x1FB0u, 0x1FB1u, 8, 1 },
+        { 0x1FBEu, 0x1FBEu, -7205, 1 },
+        { 0x1FD0u, 0x1FD1u, 8, 1 },
+        { 0x1FE0u, 0x1FE1u, 8, 1 },
+        { 0x1FE5u, 0x1FE5u, 7, 1 },
+        { 0x2170u, 0x217Fu, -16, 1 },
+        { 0x24D0u, 0x24E9u, -26, 1 },
+        { 0x2C30u, 0x2C5Fu, -48, 1 },
+        { 0x2C61u, 0x2C61u, -1, 1 },
+        { 0x2C68u, 0x2C6Cu, -1, 2 },
+        { 0x2C73u, 0x2C73u, -1, 1 },
+        { 0x2C76u, 0x2C76u, -1, 1 },
+        { 0x2C81u, 0x2CE3u, -1, 2 },
+        { 0x2CECu, 0x2CEEu, -1, 2 },
+        { 0x2CF3u, 0x2CF3u, -1, 1 },
+        { 0x2D00u, 0x2D25u, -7264, 1 },
+        { 0xA641u, 0xA66Du, -1, 2 },
+        { 0xA681u, 0xA69Bu, -1, 2 },
+        { 0xA723u, 0xA72Fu, -1, 2 },
+        { 0xA733u, 0xA76Fu, -1, 2 },
+        { 0xA77Au, 0xA77Cu, -1, 2 },
+        { 0xA77Fu, 0xA787u, -1, 2 },
+        { 0xA78Cu, 0xA78Cu, -1, 1 },
+        { 0xFF41u, 0xFF5Au, -32, 1 },
+    };
+
+    /// @brief Build the table mapping each UTF-16 code unit to its uppercase code unit
+    /// @return Table of 0x10000 code units
+    /// @note On Windows, the table is read from the system with file system casing rules, which are the rules of
+    ///       the configuration manager. Elsewhere, it is built from #UpcaseRanges.
+    static std::vector<WORD> BuildUpcaseTable()
+    {
+        std::vector<WORD> Table(0x10000u);
+
+        for (SIZE_T CodeUnit = 0; CodeUnit < Table.size(); ++CodeUnit)
+        {
+            Table[CodeUnit] = static_cast<WORD>(CodeUnit);
+        }
+
+#ifdef _WIN32
+        for (SIZE_T CodeUnit = 0; CodeUnit < Table.size(); ++CodeUnit)
+        {
+            const WCHAR Source = static_cast<WCHAR>(CodeUnit);
+            WCHAR Upcased = Source;
+
+            // lone surrogates are not mapped, and are left as they are
+            if (LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, &Source, 1, &Upcased, 1, nullptr, nullptr, 0) == 1)
+            {
+                Table[CodeUnit] = static_cast<WORD>(Upcased);
+            }
+        }
+#else
+        for (const UpcaseRange& Range : UpcaseRanges)
+        {
+            for (SIZE_T CodeUnit = Range.First; CodeUnit <= Range.Last; CodeUnit += Range.Step)
+            {
+                Table[CodeUnit] = static_cast<WORD>(static_cast<int>(CodeUnit) + Range.Delta);
+            }
+        }
+#endif
+
+        return Table;
+    }
+
+    WORD UpcaseCodeUnit
+    (
+        _In_ const WORD CodeUnit
+    )
+    {
+        static const std::vector<WORD> Table = BuildUpcaseTable();
+        return Table[CodeUnit];
+    }
+
+    DWORD NameHash
+    (
+        _In_ const BYTE* Name,
+        _In_ const SIZE_T NameLength,
+        _In_ const bool Compressed
+    )
+    {
+        DWORD Hash = 0;
+        if (Compressed)
+        {
+            for (SIZE_T Index = 0; Index < NameLength; ++Index)
+            {
+                Hash = 37u * Hash + UpcaseCodeUnit(Name[Index]);
+            }
+        }
+        else
+        {
+            for (SIZE_T Index = 0; Index + 1 < NameLength; Index += sizeof(WORD))
+            {
+                Hash = 37u * Hash + UpcaseCodeUnit(ReadWord(Name + Index));
+            }
+        }
+        return Hash;
+    }
+
+    /// @brief Get the next UTF-16 code unit of a name
+    /// @param[in] Name Name being iterated
+    /// @param[in,out] Index Index of the next character in #Name
+    /// @param[in,out] PendingLowSurrogate Second half of a surrogate pair not returned yet, or 0
+    /// @return Next UTF-16 code unit
+    static WORD NextCodeUnit
+    (
+        _In_ const std::wstring_view Name,
+        _Inout_ SIZE_T& Index,
+        _Inout_ WORD& PendingLowSurrogate
+    )
+    {
+        if (PendingLowSurrogate != 0)
+        {
+            const WORD CodeUnit = PendingLowSurrogate;
+            PendingLowSurrogate = 0;
+            return CodeUnit;
+        }
+
+        const ULONG CodePoint = static_cast<ULONG>(Name[Index++]);
+        if (CodePoint > 0xFFFFu)
+        {
+            PendingLowSurrogate = static_cast<WORD>(0xDC00u + ((CodePoint - 0x10000u) & 0x3FFu));
+            return static_cast<WORD>(0xD800u + ((CodePoint - 0x10000u) >> 10));
+        }
+        return static_cast<WORD>(CodePoint);
+    }
+
+    int CompareNames
+    (
+        _In_ const std::wstring_view Left,
+        _In_ const std::wstring_view Right
+    )
+    {
+        SIZE_T LeftIndex = 0;
+        SIZE_T RightIndex = 0;
+        WORD LeftPending = 0;
+        WORD RightPending = 0;
+
+        while (true)
+        {
+            const bool LeftEnd = LeftIndex == Left.length() && LeftPending == 0;
+            const bool RightEnd = RightIndex == Right.length() && RightPending == 0;
+            if (LeftEnd || RightEnd)
+            {
+                return (LeftEnd ? 0 : 1) - (RightEnd ? 0 : 1);
+            }
+
+            const WORD LeftUnit = UpcaseCodeUnit(NextCodeUnit(Left, LeftIndex, LeftPending));
+            const WORD RightUnit = UpcaseCodeUnit(NextCodeUnit(Right, RightIndex, RightPending));
+            if (LeftUnit != RightUnit)
+            {
+                return LeftUnit < RightUnit ? -1 : 1;
+            }
+        }
+    }
+
+    SIZE_T Utf16Length
+    (
+        _In_ const std::wstring_view Name
+    )
+    {
+        SIZE_T Length = Name.length();
+#if WCHAR_MAX > 0xFFFF
+        for (const wchar_t Char : Name)
+        {
+            if (static_cast<ULONG>(Char) > 0xFFFFu)
+            {
+                ++Length;
+            }
+        }
+#endif
+        return Length;
+    }
+
+    void DecodeUtf16
+    (
+        _In_ const BYTE* Text,
+        _In_ const SIZE_T Size,
+        _Out_ std::wstring& Decoded
+    )
+    {
+        const SIZE_T CodeUnitCount = Size / sizeof(WORD);
+        Decoded.clear();
+        Decoded.reserve(CodeUnitCount);
+        for (SIZE_T Index = 0; Index < CodeUnitCount; ++Index)
+        {
+            WORD CodeUnit = ReadWord(Text + Index * sizeof(WORD));
+#if WCHAR_MAX > 0xFFFF
+            // wide strings hold UTF-32: combine surrogate pairs
+            if (CodeUnit >= 0xD800u && CodeUnit <= 0xDBFFu && Index + 1 < CodeUnitCount)
+            {
+                const WORD LowSurrogate = ReadWord(Text + (Index + 1) * sizeof(WORD));
+                if (LowSurrogate >= 0xDC00u && LowSurrogate <= 0xDFFFu)
+                {
+                    Decoded.push_back(static_cast<wchar_t>(0x10000u + ((CodeUnit - 0xD800u) << 10) + (LowSurrogate - 0xDC00u)));
+                    ++Index;
+                    continue;
+                }
+            }
+#endif
+            Decoded.push_back(static_cast<wchar_t>(CodeUnit));
+        }
+    }
+
+    void AppendUtf16
+    (
+        _In_ const std::wstring_view Text,
+        _Inout_ std::vector<BYTE>& Encoded
+    )
+    {
+        auto AppendCodeUnit = [&Encoded](const ULONG CodeUnit)
+        {
+            Encoded.push_back(static_cast<BYTE>(CodeUnit));
+            Encoded.push_back(static_cast<BYTE>(CodeUnit >> 8));
+        };
+        for (const wchar_t Char : Text)
+        {
+            const ULONG CodePoint = static_cast<ULONG>(Char);
+            if (CodePoint > 0xFFFFu)
+            {
+                AppendCodeUnit(0xD800u + ((CodePoint - 0x10000u) >> 10));
+                AppendCodeUnit(0xDC00u + ((CodePoint - 0x10000u) & 0x3FFu));
+            }
+            else
+            {
+                AppendCodeUnit(CodePoint);
+            }
+        }
+    }
+
+    void DecodeName
+    (
+        _In_ const BYTE* Name,
+        _In_ const SIZE_T NameLength,
+        _In_ const bool Compressed,
+        _Out_ std::wstring& Decoded
+    )
+    {
+        if (Compressed)
+        {
+            Decoded.assign(Name, Name + NameLength);
+            return;
+        }
+
+        DecodeUtf16(Name, NameLength, Decoded);
+    }
+
+    bool EncodeName
+    (
+        _In_ const std::wstring_view Name,
+        _Out_ std::vector<BYTE>& Encoded
+    )
+    {
+        Encoded.clear();
+
+        bool Compressed = true;
+        for (const wchar_t Char : Name)
+        {
+            if (static_cast<ULONG>(Char) > 0xFFu)
+            {
+                Compressed = false;
+                break;
+            }
+        }
+
+        if (Compressed)
+        {
+            Encoded.assign(Name.cbegin(), Name.cend());
+            return true;
+        }
+
+        Encoded.reserve(Name.length() * sizeof(WORD));
+        AppendUtf16(Name, Encoded);
+        return false;
+    }
+};
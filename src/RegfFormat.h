@@ -0,0 +1,358 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// On-disk layout of registry hive (regf) files.
+/// All integers are little-endian. Cell offsets are relative to the start of the hive bins data,
+/// which begins right after the base block.
+namespace Regf {
+
+    /// Base block (file header) layout
+    namespace BaseBlock {
+        /// Size of the base block, which is also the offset of the first hive bin
+        static const SIZE_T Size = 0x1000u;
+
+        /// "regf"
+        static const DWORD Signature = 0x66676572u;
+
+        static const SIZE_T SignatureOffset = 0x00u;
+        static const SIZE_T PrimarySequenceOffset = 0x04u;
+        static const SIZE_T SecondarySequenceOffset = 0x08u;
+        static const SIZE_T TimestampOffset = 0x0Cu;
+        static const SIZE_T MajorVersionOffset = 0x14u;
+        static const SIZE_T MinorVersionOffset = 0x18u;
+        static const SIZE_T FileTypeOffset = 0x1Cu;
+        static const SIZE_T FileFormatOffset = 0x20u;
+        static const SIZE_T RootCellOffset = 0x24u;
+        static const SIZE_T BinsDataSizeOffset = 0x28u;
+        static const SIZE_T ClusteringFactorOffset = 0x2Cu;
+        static const SIZE_T FileNameOffset = 0x30u;
+        static const SIZE_T FileNameSize = 0x40u;
+        static const SIZE_T ChecksumOffset = 0x1FCu;
+
+        /// Only major version handled by this program
+        static const DWORD MajorVersion = 1u;
+
+        /// Minor version from which big data (db) cells are used
+        static const DWORD BigDataMinorVersion = 4u;
+
+        /// Minor version written by this program (fast leaves, hash leaves and big data supported)
+        static const DWORD WrittenMinorVersion = 5u;
+
+        /// File type of a primary hive file
+        static const DWORD PrimaryFileType = 0u;
+
+        /// File format of a hive that may be loaded directly in memory
+        static const DWORD DirectMemoryLoadFormat = 1u;
+    };
+
+    /// Hive bin layout
+    namespace Bin {
+        /// Hive bins are sized in multiples of this value
+        static const SIZE_T Alignment = 0x1000u;
+
+        /// Size of the hive bin header
+        static const SIZE_T HeaderSize = 0x20u;
+
+        /// "hbin"
+        static const DWORD Signature = 0x6E696268u;
+
+        static const SIZE_T SignatureOffset = 0x00u;
+        static const SIZE_T OffsetOffset = 0x04u;
+        static const SIZE_T SizeOffset = 0x08u;
+        static const SIZE_T TimestampOffset = 0x14u;
+    };
+
+    /// Cell layout. Each cell begins with a 32-bit signed size, negative when the cell is allocated.
+    namespace Cell {
+        /// Size of the cell size field
+        static const SIZE_T HeaderSize = 4u;
+
+        /// Cell sizes are multiples of this value
+        static const SIZE_T Alignment = 8u;
+
+        /// Offset value meaning "no cell"
+        static const DWORD NullOffset = 0xFFFFFFFFu;
+
+        static const WORD KeyNodeSignature = 0x6B6Eu;     // "nk"
+        static const WORD ValueSignature = 0x6B76u;       // "vk"
+        static const WORD SecuritySignature = 0x6B73u;    // "sk"
+        static const WORD IndexLeafSignature = 0x696Cu;   // "li"
+        static const WORD FastLeafSignature = 0x666Cu;    // "lf"
+        static const WORD HashLeafSignature = 0x686Cu;    // "lh"
+        static const WORD IndexRootSignature = 0x6972u;   // "ri"
+        static const WORD BigDataSignature = 0x6264u;     // "db"
+    };
+
+    /// Key node (nk) cell layout, offsets relative to the cell data
+    namespace KeyNode {
+        static const SIZE_T FlagsOffset = 0x02u;
+        static const SIZE_T TimestampOffset = 0x04u;
+        static const SIZE_T ParentOffset = 0x10u;
+        static const SIZE_T SubkeyCountOffset = 0x14u;
+        static const SIZE_T VolatileSubkeyCountOffset = 0x18u;
+        static const SIZE_T SubkeyListOffset = 0x1Cu;
+        static const SIZE_T VolatileSubkeyListOffset = 0x20u;
+        static const SIZE_T ValueCountOffset = 0x24u;
+        static const SIZE_T ValueListOffset = 0x28u;
+        static const SIZE_T SecurityOffset = 0x2Cu;
+        static const SIZE_T ClassNameOffset = 0x30u;
+        static const SIZE_T MaxSubkeyNameLengthOffset = 0x34u;
+        static const SIZE_T MaxSubkeyClassLengthOffset = 0x38u;
+        static const SIZE_T MaxValueNameLengthOffset = 0x3Cu;
+        static const SIZE_T MaxValueDataSizeOffset = 0x40u;
+        static const SIZE_T NameLengthOffset = 0x48u;
+        static const SIZE_T ClassNameLengthOffset = 0x4Au;
+        static const SIZE_T NameOffset = 0x4Cu;
+
+        static const WORD VolatileFlag = 0x0001u;
+        static const WORD HiveExitFlag = 0x0002u;
+        static const WORD HiveEntryFlag = 0x0004u;
+        static const WORD NoDeleteFlag = 0x0008u;
+        static const WORD SymbolicLinkFlag = 0x0010u;
+        static const WORD CompressedNameFlag = 0x0020u;
+    };
+
+    /// Value (vk) cell layout, offsets relative to the cell data
+    namespace Value {
+        static const SIZE_T NameLengthOffset = 0x02u;
+        static const SIZE_T DataSizeOffset = 0x04u;
+        static const SIZE_T DataOffset = 0x08u;
+        static const SIZE_T TypeOffset = 0x0Cu;
+        static const SIZE_T FlagsOffset = 0x10u;
+        static const SIZE_T NameOffset = 0x14u;
+
+        static const WORD CompressedNameFlag = 0x0001u;
+
+        /// Set in the data size when the data (up to 4 bytes) is stored in the data offset field
+        static const DWORD InlineDataFlag = 0x80000000u;
+
+        /// Maximal data size stored in the data offset field
+        static const DWORD InlineDataMaximalSize = 4u;
+    };
+
+    /// Subkey list (li, lf, lh, ri) layout, offsets relative to the cell data
+    namespace SubkeyList {
+        static const SIZE_T CountOffset = 0x02u;
+        static const SIZE_T ElementsOffset = 0x04u;
+
+        /// Size of an element in li and ri lists (cell offset)
+        static const SIZE_T IndexElementSize = 4u;
+
+        /// Size of an element in lf and lh lists (cell offset, name hint or hash)
+        static const SIZE_T HashElementSize = 8u;
+
+        /// Maximal count of elements written in a single leaf, larger lists are split under an index root
+        static const SIZE_T MaximalLeafCount = 500u;
+    };
+
+    /// Security (sk) cell layout, offsets relative to the cell data
+    namespace Security {
+        static const SIZE_T FlinkOffset = 0x04u;
+        static const SIZE_T BlinkOffset = 0x08u;
+        static const SIZE_T ReferenceCountOffset = 0x0Cu;
+        static const SIZE_T DescriptorSizeOffset = 0x10u;
+        static const SIZE_T DescriptorOffset = 0x14u;
+    };
+
+    /// Big data (db) cell layout, offsets relative to the cell data
+    namespace BigData {
+        static const SIZE_T SegmentCountOffset = 0x02u;
+        static const SIZE_T SegmentListOffset = 0x04u;
+
+        /// Largest amount of data held by one segment, and largest value stored without big data
+        static const DWORD SegmentSize = 16344u;
+    };
+
+    /// Transaction log file (.LOG1, .LOG2) layout, in the format used since Windows 8.1
+    namespace LogFile {
+        /// Size of the base block of a log file, which is also the offset of the first log entry.
+        /// The base block has the layout of a hive base block, truncated after its checksum.
+        static const SIZE_T BaseBlockSize = 0x200u;
+
+        /// File type of a transaction log made of log entries
+        static const DWORD LogEntriesFileType = 6u;
+    };
+
+    /// Log entry (HvLE) layout, offsets relative to the log entry
+    namespace LogEntry {
+        /// "HvLE"
+        static const DWORD Signature = 0x454C7648u;
+
+        static const SIZE_T SignatureOffset = 0x00u;
+        static const SIZE_T SizeOffset = 0x04u;
+        static const SIZE_T FlagsOffset = 0x08u;
+        static const SIZE_T SequenceOffset = 0x0Cu;
+        static const SIZE_T BinsDataSizeOffset = 0x10u;
+        static const SIZE_T DirtyPageCountOffset = 0x14u;
+        static const SIZE_T DataHashOffset = 0x18u;
+        static const SIZE_T HeaderHashOffset = 0x20u;
+        static const SIZE_T DirtyPagesOffset = 0x28u;
+
+        /// Size of the beginning of the log entry covered by the header hash, data hash included
+        static const SIZE_T HeaderHashedSize = 0x20u;
+
+        /// Size of a dirty page reference (offset relative to the hive bins data, then size)
+        static const SIZE_T DirtyPageReferenceSize = 8u;
+
+        /// Log entries are sized in multiples of this value
+        static const SIZE_T Alignment = 0x200u;
+
+        /// Seed of the Marvin32 hashes of log entries
+        static const ULONGLONG HashSeed = 0x82EF4D887A4E55C5ull;
+    };
+
+    /// @brief Read a little-endian 16-bit integer at any alignment
+    inline WORD ReadWord(_In_ const BYTE* Data)
+    {
+        return static_cast<WORD>(Data[0] | (Data[1] << 8));
+    }
+
+    /// @brief Read a little-endian 32-bit integer at any alignment
+    inline DWORD ReadDword(_In_ const BYTE* Data)
+    {
+        return static_cast<DWORD>(Data[0]) | (static_cast<DWORD>(Data[1]) << 8) |
+               (static_cast<DWORD>(Data[2]) << 16) | (static_cast<DWORD>(Data[3]) << 24);
+    }
+
+    /// @brief Read a little-endian 64-bit integer at any alignment
+    inline ULONGLONG ReadQword(_In_ const BYTE* Data)
+    {
+        return static_cast<ULONGLONG>(ReadDword(Data)) | (static_cast<ULONGLONG>(ReadDword(Data + 4)) << 32);
+    }
+
+    /// @brief Write a little-endian 16-bit integer at any alignment
+    inline void WriteWord(_Out_ BYTE* Data, _In_ const WORD Value)
+    {
+        Data[0] = static_cast<BYTE>(Value);
+        Data[1] = static_cast<BYTE>(Value >> 8);
+    }
+
+    /// @brief Write a little-endian 32-bit integer at any alignment
+    inline void WriteDword(_Out_ BYTE* Data, _In_ const DWORD Value)
+    {
+        Data[0] = static_cast<BYTE>(Value);
+        Data[1] = static_cast<BYTE>(Value >> 8);
+        Data[2] = static_cast<BYTE>(Value >> 16);
+        Data[3] = static_cast<BYTE>(Value >> 24);
+    }
+
+    /// @brief Write a little-endian 64-bit integer at any alignment
+    inline void WriteQword(_Out_ BYTE* Data, _In_ const ULONGLONG Value)
+    {
+        WriteDword(Data, static_cast<DWORD>(Value));
+        WriteDword(Data + 4, static_cast<DWORD>(Value >> 32));
+    }
+
+    /// @brief Compute the checksum of a base block
+    /// @param[in] BaseBlockData The first BaseBlock::ChecksumOffset bytes of the base block
+    /// @return Checksum as expected at BaseBlock::ChecksumOffset
+    DWORD BaseBlockChecksum
+    (
+        _In_ const BYTE* BaseBlockData
+    );
+
+    /// @brief Compute the Marvin32 hash of a buffer, as stored in log entries
+    /// @param[in] Data Buffer to hash
+    /// @param[in] Size Size of #Data in bytes
+    /// @param[in] Seed Seed of the hash
+    /// @return 64-bit hash
+    ULONGLONG Marvin32
+    (
+        _In_ const BYTE* Data,
+        _In_ const SIZE_T Size,
+        _In_ const ULONGLONG Seed
+    );
+
+    /// @brief Uppercase a UTF-16 code unit the way the configuration manager compares names
+    /// @param[in] CodeUnit UTF-16 code unit
+    /// @return Uppercase code unit
+    /// @note On Windows, this is the upcase table of the system, as used by the kernel. Elsewhere, the table is
+    ///       built from the simple uppercase mappings of the Unicode character database, which may differ from the
+    ///       system for the few letters added to Unicode after the table of the system was made.
+    WORD UpcaseCodeUnit
+    (
+        _In_ const WORD CodeUnit
+    );
+
+    /// @brief Compute the hash stored in lh subkey lists for a key name
+    /// @param[in] Name Name as stored in the nk cell (Latin-1 or UTF-16LE)
+    /// @param[in] NameLength Length of #Name in bytes
+    /// @param[in] Compressed Whether #Name is stored as Latin-1
+    /// @return Hash of the uppercase name
+    DWORD NameHash
+    (
+        _In_ const BYTE* Name,
+        _In_ const SIZE_T NameLength,
+        _In_ const bool Compressed
+    );
+
+    /// @brief Compare two names case-insensitively, in the order used for sorting subkey lists
+    /// @param[in] Left First name
+    /// @param[in] Right Second name
+    /// @return Negative, zero or positive value when #Left sorts before, with or after #Right
+    int CompareNames
+    (
+        _In_ const std::wstring_view Left,
+        _In_ const std::wstring_view Right
+    );
+
+    /// @brief Count the UTF-16 code units of a name
+    /// @param[in] Name Name to measure
+    /// @return Length of #Name in UTF-16 code units
+    SIZE_T Utf16Length
+    (
+        _In_ const std::wstring_view Name
+    );
+
+    /// @brief Decode UTF-16LE text, as stored in string data and in .reg files
+    /// @param[in] Text Code units of the text
+    /// @param[in] Size Size of #Text in bytes. A trailing odd byte is ignored.
+    /// @param[out] Decoded Decoded text
+    void DecodeUtf16
+    (
+        _In_ const BYTE* Text,
+        _In_ const SIZE_T Size,
+        _Out_ std::wstring& Decoded
+    );
+
+    /// @brief Encode text as UTF-16LE, as stored in string data and in .reg files
+    /// @param[in] Text Text to encode
+    /// @param[in,out] Encoded Buffer to which the code units of #Text are appended
+    void AppendUtf16
+    (
+        _In_ const std::wstring_view Text,
+        _Inout_ std::vector<BYTE>& Encoded
+    );
+
+    /// @brief Decode a key or value name as stored in a hive
+    /// @param[in] Name Name as stored in the cell (Latin-1 or UTF-16LE)
+    /// @param[in] NameLength Length of #Name in bytes
+    /// @param[in] Compressed Whether #Name is stored as Latin-1
+    /// @param[out] Decoded Decoded name
+    void DecodeName
+    (
+        _In_ const BYTE* Name,
+        _In_ const SIZE_T NameLength,
+        _In_ const bool Compressed,
+        _Out_ std::wstring& Decoded
+    );
+
+    /// @brief Encode a key or value name for storage in a hive
+    /// @param[in] Name Name to encode
+    /// @param[out] Encoded Encoded name (Latin-1 when possible, UTF-16LE otherwise)
+    /// @return Whether the name was stored as Latin-1 (compressed)
+    bool EncodeName
+    (
+        _In_ const std::wstring_view Name,
+        _Out_ std::vector<BYTE>& Encoded
+    );
+};
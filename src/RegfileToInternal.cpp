@@ -5,545 +5,1314 @@
 #include "Constants.h"
 #include "Conversions.h"
 #include "CommonFunctions.h"
+#include "HexCodec.h"
+#include "InputFile.h"
+#include "MappedFile.h"
+#include "MonotonicArena.h"
+#include "ParallelTasks.h"
+#include "RegfFormat.h"
+#include "StructuralScan.h"
 #include <sstream>
 #include <iomanip>
 #include <string_view>
+#include <algorithm>
+#include <cassert>
 
-/// @brief Consume a list of registry values in a .reg file
-/// @param[in,out] ValueList String view to the beginning of a list of values.
-///                Updated to the next token after the list of values, newlines having been consumed.
-/// @param[in] Values Container for the read values
+/// Next element of a .reg file that the parser expects
+enum class RegfileParserStep {
+    /// Preamble at the beginning of the file
+    Preamble,
+
+    /// Key path between brackets, possibly preceded by blank lines
+    KeyPath,
+
+    /// Beginning of a value declaration, or blank line ending the list of values
+    ValueName,
+
+    /// Remainder of a value name, after its opening quotation mark
+    QuotedValueName,
+
+    /// Sign between the name of a value and its data
+    NameSeparator,
+
+    /// Beginning of the rendition of value data
+    ValueData,
+
+    /// Bytes of a hexadecimal rendition
+    HexData,
+
+    /// Leading spaces of a continuation line in a hexadecimal rendition
+    HexLeadingSpaces,
+
+    /// Remainder of a string rendition, after its opening quotation mark
+    StringData,
+
+    /// New line after the closing quotation mark of a string rendition
+    StringEnd,
+};
+
+/// Key of the .reg file that may still receive values or subkeys
+struct OpenedRegfileKey {
+    /// Path of the key in the file, followed by a path separator
+    std::wstring SubkeyPrefix;
+
+    /// Representation of the key in the tree being built
+    RegistryKey* Key;
+};
+
+/// Key of a chunk of a .reg file whose parent key is not in the chunk
+struct DetachedRegfileKey {
+    /// Path of the key in the file
+    std::wstring Path;
+
+    /// Representation of the key, with its values and subkeys. Its name is set when attached to its parent.
+    RegistryKey Key;
+};
+
+/// State of a .reg file parser, kept from one window of the file to the next
+struct RegfileParserState {
+    RegfileParserState(const RegistryAllocator& Allocator, NameTable& Names) :
+        Allocator(Allocator), Names(Names), Value(Allocator)
+    {
+    }
+
+    /// Allocator of the tree being built
+    RegistryAllocator Allocator;
+
+    /// Table in which the names of the tree being built are interned
+    NameTable& Names;
+
+    /// Root key of the file, filled while parsing. Null when parsing a chunk of the file.
+    RegistryKey* RootKey = nullptr;
+
+    /// Keys of the chunk whose parent is not in the chunk, in file order. Only used when parsing a chunk.
+    std::vector<DetachedRegfileKey> DetachedKeys;
+
+    /// Next element that the parser expects
+    RegfileParserStep Step = RegfileParserStep::Preamble;
+
+    /// Whether the root key has been read already
+    bool RootKeyFound = false;
+
+    /// Last read key, preceded by all its ancestors
+    std::vector<OpenedRegfileKey> OpenedKeys;
+
+    /// Value being read
+    RegistryValue Value;
+
+    /// Name of the value being read, until its closing quotation mark is found and the name is interned
+    std::wstring ValueName;
+
+    /// Data of the value being read, until the value is stored. Growing data in a reusable buffer rather than
+    /// in the tree spares the tree's arena the blocks that data outgrows.
+    std::vector<BYTE> ValueData;
+};
+
+/// @brief Check whether a window stops in the middle of an expected sequence
+/// @param[in] Window Unparsed part of the window
+/// @param[in] Expected Sequence that may begin at the start of #Window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return true if more input is needed to tell whether #Window begins with #Expected
+static bool IsTruncated
+(
+    _In_ const std::wstring_view& Window,
+    _In_ const std::wstring_view& Expected,
+    _In_ const bool EndOfInput
+)
+{
+    return !EndOfInput && Window.length() < Expected.length() && std::equal(Window.cbegin(), Window.cend(), Expected.cbegin());
+}
+
+/// @brief Consume an expected sequence at the start of a window
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] Expected Sequence to consume
+/// @return true if #Window began with #Expected, which has been consumed
+static bool ConsumeString
+(
+    _Inout_ std::wstring_view& Window,
+    _In_ const std::wstring_view& Expected
+)
+{
+    bool ReturnValue = Window.length() >= Expected.length() && std::equal(Expected.cbegin(), Expected.cend(), Window.cbegin());
+    if (ReturnValue)
+    {
+        Window.remove_prefix(Expected.length());
+    }
+    return ReturnValue;
+}
+
+/// @brief Consume an expected character at the start of a window
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] Expected Character to consume
+/// @return true if #Window began with #Expected, which has been consumed
+static bool ConsumeChar
+(
+    _Inout_ std::wstring_view& Window,
+    _In_ const WCHAR Expected
+)
+{
+    bool ReturnValue = !Window.empty() && Window[0] == Expected;
+    if (ReturnValue)
+    {
+        Window.remove_prefix(1);
+    }
+    return ReturnValue;
+}
+
+/// @brief Report a parsing error, with the path of the key being read
+/// @param[in] State Parser state
+/// @param[in] Message Description of the error
+/// @return E_UNEXPECTED
+static HRESULT ReportParsingError
+(
+    _In_ const RegfileParserState& State,
+    _In_ const std::wstring_view Message
+)
+{
+    if (State.OpenedKeys.empty())
+    {
+        ReportError(E_UNEXPECTED, Message);
+    }
+    else
+    {
+        const std::wstring& SubkeyPrefix = State.OpenedKeys.back().SubkeyPrefix;
+        ReportError(E_UNEXPECTED, std::wstring{ Message } + L" - Current key: " + SubkeyPrefix.substr(0, SubkeyPrefix.length() - 1));
+    }
+    return E_UNEXPECTED;
+}
+
+/// @brief Report that the window is exhausted before the end of an element
+/// @param[in] State Parser state
+/// @param[in] EndOfInput Whether the window ends at the end of the file
+/// @param[in] Message Description of the error, should the file end here
+/// @retval E_PENDING More input is needed
+/// @retval E_UNEXPECTED The file is truncated
+static HRESULT NeedMoreInput
+(
+    _In_ const RegfileParserState& State,
+    _In_ const bool EndOfInput,
+    _In_ const std::wstring_view Message
+)
+{
+    return EndOfInput ? ReportParsingError(State, Message) : E_PENDING;
+}
+
+/// @brief Append code units to a string
+/// @param[in,out] Destination String receiving the code units
+/// @param[in] CodeUnits Code units to append
+/// @param[in] Count Count of code units to append
+static void AppendCodeUnits
+(
+    _Inout_ std::wstring& Destination,
+    _In_ const WCHAR* CodeUnits,
+    _In_ const SIZE_T Count
+)
+{
+    Destination.append(CodeUnits, Count);
+}
+
+/// @brief Append code units to a byte buffer, as the binary representation of string data
+/// @param[in,out] Destination Buffer receiving the code units
+/// @param[in] CodeUnits Code units to append
+/// @param[in] Count Count of code units to append
+static void AppendCodeUnits
+(
+    _Inout_ std::vector<BYTE>& Destination,
+    _In_ const WCHAR* CodeUnits,
+    _In_ const SIZE_T Count
+)
+{
+#if WCHAR_MAX > 0xFFFF
+    // wide strings hold UTF-32, but string data is UTF-16LE
+    Regf::AppendUtf16(std::wstring_view{ CodeUnits, Count }, Destination);
+#else
+    const BYTE* Bytes = reinterpret_cast<const BYTE*>(CodeUnits);
+    Destination.insert(Destination.end(), Bytes, Bytes + Count * sizeof(WCHAR));
+#endif
+}
+
+/// @brief Consume the unescaped characters of a quoted string, up to its closing quotation mark
+/// @param[in,out] Window Unparsed part of the window, beginning after the opening quotation mark
+/// @param[in,out] Unescaped Destination of the characters: a string or the byte buffer of a value.
+///                The characters consumed are appended.
+/// @retval S_OK The closing quotation mark has been consumed
+/// @retval E_PENDING The window has been consumed up to an incomplete escape sequence or to its end
+/// @note A string may span several windows: #Unescaped keeps the characters across calls.
+/// @note Characters are unescaped in place: runs without escape sequences are appended at once.
+template <typename Destination>
+static HRESULT ConsumeQuotedString
+(
+    _Inout_ std::wstring_view& Window,
+    _Inout_ Destination& Unescaped
+)
+{
+    SIZE_T Position = 0;
+    HRESULT Result = E_PENDING;
+
+    while (Position < Window.length())
+    {
+        // copy the run of ordinary characters up to the next quote, backslash or new line at once
+        const SIZE_T StructuralPos = FindStructuralChar(Window, Position, StructuralClasses::Quotes | StructuralClasses::Backslashes | StructuralClasses::NewLines);
+        const SIZE_T RunEnd = StructuralPos == Window.npos ? Window.length() : StructuralPos;
+        AppendCodeUnits(Unescaped, Window.data() + Position, RunEnd - Position);
+        Position = RunEnd;
+        if (Position == Window.length())
+        {
+            break;
+        }
+
+        const WCHAR CurrentChar = Window[Position];
+        if (CurrentChar == L'"')
+        {
+            Position += 1;
+            Result = S_OK;
+            break;
+        }
+        if ((CurrentChar == L'\\' || CurrentChar == L'\r') && Position + 1 >= Window.length())
+        {
+            // the following character is in the next window
+            break;
+        }
+        if (CurrentChar == L'\\')
+        {
+            AppendCodeUnits(Unescaped, &Window[Position + 1], 1);
+            Position += 2;
+        }
+        else if (CurrentChar == L'\r' && Window[Position + 1] == L'\n')
+        {
+            // ignore \r before \n
+            Position += 1;
+        }
+        else
+        {
+            AppendCodeUnits(Unescaped, &Window[Position], 1);
+            Position += 1;
+        }
+    }
+
+    Window.remove_prefix(Position);
+    return Result;
+}
+
+/// @brief Store the value that has been read in the current key
+/// @param[in,out] State Parser state
+static void StoreValue
+(
+    _Inout_ RegfileParserState& State
+)
+{
+    State.Value.BinaryValue.assign(State.ValueData.data(), State.ValueData.size());
+    State.ValueData.clear();
+    State.OpenedKeys.back().Key->Values.emplace_back(std::move(State.Value));
+    State.Value = RegistryValue{ State.Allocator };
+    State.Step = RegfileParserStep::ValueName;
+}
+
+/// @brief Close the opened keys that are not ancestors of a key
+/// @param[in,out] OpenedKeys Opened keys, each one preceded by its ancestors
+/// @param[in] KeyPath Path of the key in the file
+static void CloseNonAncestorKeys
+(
+    _Inout_ std::vector<OpenedRegfileKey>& OpenedKeys,
+    _In_ const std::wstring_view& KeyPath
+)
+{
+    while (!OpenedKeys.empty())
+    {
+        const std::wstring& SubkeyPrefix = OpenedKeys.back().SubkeyPrefix;
+        if (KeyPath.length() > SubkeyPrefix.length() && std::equal(SubkeyPrefix.cbegin(), SubkeyPrefix.cend(), KeyPath.cbegin()))
+        {
+            break;
+        }
+        OpenedKeys.pop_back();
+    }
+}
+
+/// @brief Attach a key to the last opened key, or make it the root key, then open it
+/// @param[in,out] OpenedKeys Opened keys, each one preceded by its ancestors. Non-ancestors must have been closed.
+/// @param[in,out] Names Table in which the name of the key is interned
+/// @param[in,out] RootKey Root key of the tree being built. May be null if #OpenedKeys is not empty.
+/// @param[in,out] RootKeyFound Whether #RootKey has been read already
+/// @param[in] KeyPath Path of the key in the file
+/// @param[in,out] Key Representation of the key, moved to its place in the tree
 /// @return HRESULT semantics
 _Must_inspect_result_
-static HRESULT ValueListToInternal
+static HRESULT OpenRegfileKey
+(
+    _Inout_ std::vector<OpenedRegfileKey>& OpenedKeys,
+    _Inout_ NameTable& Names,
+    _Inout_opt_ RegistryKey* RootKey,
+    _Inout_ bool& RootKeyFound,
+    _In_ const std::wstring_view& KeyPath,
+    _Inout_ RegistryKey&& Key
+)
+{
+    RegistryKey* NewKey = nullptr;
+    std::wstring Name;
+
+    if (OpenedKeys.empty())
+    {
+        if (RootKey == nullptr || RootKeyFound)
+        {
+            ReportError(E_UNEXPECTED, L"Multiple root keys were found in the registry file - Unexpected key: " + std::wstring{ KeyPath });
+            return E_UNEXPECTED;
+        }
+        if (KeyPath.empty())
+        {
+            ReportError(E_UNEXPECTED, L"Root key has an empty name");
+            return E_UNEXPECTED;
+        }
+        RootKeyFound = true;
+#ifdef _DEBUG
+        // root keys are only met by a single thread: no other allocation may happen while the parsed tree is taken over
+        const MonotonicArena* Arena = dynamic_cast<const MonotonicArena*>(RootKey->get_allocator().resource());
+        const SIZE_T AllocationCount = Arena == nullptr ? 0 : Arena->GetStatistics().AllocationCount;
+#endif
+        *RootKey = std::move(Key);
+#ifdef _DEBUG
+        // the tree is moved, never copied: taking it over allocates nothing
+        assert(Arena == nullptr || Arena->GetStatistics().AllocationCount == AllocationCount);
+#endif
+        NewKey = RootKey;
+        Name = KeyPath;
+    }
+    else
+    {
+        OpenedRegfileKey& Parent = OpenedKeys.back();
+        Parent.Key->Subkeys.emplace_back(std::move(Key));
+        NewKey = &Parent.Key->Subkeys.back();
+        Name = KeyPath.substr(Parent.SubkeyPrefix.length());
+    }
+    // keys may have newlines in their name
+    GlobalStringSubstitute(Name, L"\r\n", L"\n");
+    NewKey->Name = Names.Intern(Name);
+
+    OpenedKeys.push_back(OpenedRegfileKey{ std::wstring{ KeyPath } + Constants::RegFiles::PathSeparator, NewKey });
+    return S_OK;
+}
+
+/// @brief Consume the preamble of a .reg file
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed.
+_Must_inspect_result_
+static HRESULT ParsePreamble
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    if (IsTruncated(Window, Constants::RegFiles::Preamble, EndOfInput))
+    {
+        return E_PENDING;
+    }
+    if (!ConsumeString(Window, Constants::RegFiles::Preamble))
+    {
+        return ReportParsingError(State, L"Preamble not found");
+    }
+
+    State.Step = RegfileParserStep::KeyPath;
+    return S_OK;
+}
+
+/// @brief Consume the path of a key in a .reg file, and open the key in the tree being built
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed, S_FALSE at the end of the file.
+_Must_inspect_result_
+static HRESULT ParseKeyPath
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    static const std::wstring KeyClosingAtEOL = Constants::RegFiles::KeyClosing + Constants::RegFiles::NewLines;
+
+    // remove additional line breaks
+    while (ConsumeString(Window, Constants::RegFiles::NewLines))
+    {
+    }
+
+    if (IsTruncated(Window, Constants::RegFiles::NewLines, EndOfInput))
+    {
+        return E_PENDING;
+    }
+
+    if (Window.empty())
+    {
+        if (State.RootKey != nullptr && !State.RootKeyFound)
+        {
+            return ReportParsingError(State, L"Reading root key - Expecting content");
+        }
+        return S_FALSE;
+    }
+
+    if (Window[0] != Constants::RegFiles::KeyOpening)
+    {
+        return ReportParsingError(State, L"Line does not begin with opening bracket");
+    }
+
+    // jump from bracket to bracket until one closes the line
+    SIZE_T EndKeyPos = 1;
+    while (true)
+    {
+        EndKeyPos = FindStructuralChar(Window, EndKeyPos, StructuralClasses::Brackets);
+        if (EndKeyPos == Window.npos || Window.compare(EndKeyPos, KeyClosingAtEOL.length(), KeyClosingAtEOL) == 0)
+        {
+            break;
+        }
+        EndKeyPos += 1;
+    }
+    if (EndKeyPos == Window.npos)
+    {
+        // the whole path must be in the window
+        return NeedMoreInput(State, EndOfInput, L"Could not find closing bracket followed by new line");
+    }
+
+    const std::wstring_view KeyPath{ &Window[1], EndKeyPos - 1 };
+
+    CloseNonAncestorKeys(State.OpenedKeys, KeyPath);
+
+    if (State.RootKey == nullptr && State.OpenedKeys.empty())
+    {
+        // the parent is in a previous chunk: the key is attached when stitching chunks together
+        State.DetachedKeys.push_back(DetachedRegfileKey{ std::wstring{ KeyPath }, RegistryKey{ State.Allocator } });
+        State.OpenedKeys.push_back(OpenedRegfileKey{ std::wstring{ KeyPath } + Constants::RegFiles::PathSeparator, &State.DetachedKeys.back().Key });
+    }
+    else
+    {
+        HRESULT Result = OpenRegfileKey(State.OpenedKeys, State.Names, State.RootKey, State.RootKeyFound, KeyPath, RegistryKey{ State.Allocator });
+        if (FAILED(Result))
+        {
+            return Result;
+        }
+    }
+
+    Window.remove_prefix(EndKeyPos + KeyClosingAtEOL.length());
+    State.Step = RegfileParserStep::ValueName;
+    return S_OK;
+}
+
+/// @brief Consume the beginning of a value declaration, or the blank line ending a list of values
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed, S_FALSE at the end of the file.
+_Must_inspect_result_
+static HRESULT ParseValueName
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    if (IsTruncated(Window, Constants::RegFiles::NewLines, EndOfInput))
+    {
+        return E_PENDING;
+    }
+
+    if (Window.empty())
+    {
+        return S_FALSE;
+    }
+
+    // Values are all consumed when getting a new line.
+    if (ConsumeString(Window, Constants::RegFiles::NewLines))
+    {
+        State.Step = RegfileParserStep::KeyPath;
+    }
+    else if (ConsumeChar(Window, Constants::RegFiles::DefaultValue))
+    {
+        State.Value.Name = RegistryName{};
+        State.Step = RegfileParserStep::NameSeparator;
+    }
+    else if (ConsumeChar(Window, L'"'))
+    {
+        State.Step = RegfileParserStep::QuotedValueName;
+    }
+    else
+    {
+        return ReportParsingError(State, L"Value name should be literal @ or begin with double quote");
+    }
+
+    return S_OK;
+}
+
+/// @brief Consume the remainder of a quoted value name
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed.
+_Must_inspect_result_
+static HRESULT ParseQuotedValueName
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    if (ConsumeQuotedString(Window, State.ValueName) == E_PENDING)
+    {
+        return NeedMoreInput(State, EndOfInput, L"Looking for closing quotation mark");
+    }
+
+    State.Value.Name = State.Names.Intern(State.ValueName);
+    State.ValueName.clear();
+
+    State.Step = RegfileParserStep::NameSeparator;
+    return S_OK;
+}
+
+/// @brief Consume the sign between the name of a value and its data
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed.
+_Must_inspect_result_
+static HRESULT ParseNameSeparator
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    if (Window.empty())
+    {
+        return NeedMoreInput(State, EndOfInput, L"Value " + State.Value.Name + L" - Missing data");
+    }
+    if (!ConsumeChar(Window, Constants::RegFiles::ValueNameSeparator))
+    {
+        return ReportParsingError(State, L"Value name " + State.Value.Name + L" - Missing = sign");
+    }
+
+    State.Step = RegfileParserStep::ValueData;
+    return S_OK;
+}
+
+/// @brief Consume the beginning of the rendition of value data. Dword renditions are consumed entirely.
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed.
+_Must_inspect_result_
+static HRESULT ParseValueData
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    RegistryValue& Value = State.Value;
+
+    if (Window.empty())
+    {
+        return NeedMoreInput(State, EndOfInput, L"Value name " + Value.Name + L" - No data after = sign");
+    }
+
+    if (ConsumeChar(Window, L'"'))
+    {
+        Value.Type = REG_SZ;
+        State.Step = RegfileParserStep::StringData;
+        return S_OK;
+    }
+
+    if (IsTruncated(Window, Constants::RegFiles::DwordPrefix, EndOfInput) || IsTruncated(Window, Constants::RegFiles::HexPrefix, EndOfInput))
+    {
+        return E_PENDING;
+    }
+
+    // the declaration is only consumed once complete, so it is parsed from a copy of the window
+    std::wstring_view Declaration = Window;
+
+    if (ConsumeString(Declaration, Constants::RegFiles::DwordPrefix))
+    {
+        Value.Type = REG_DWORD;
+        DWORD DwordValue;
+        if (Declaration.length() < 8 + Constants::RegFiles::NewLines.length())
+        {
+            return NeedMoreInput(State, EndOfInput, L"Value name " + Value.Name + L" - Buffer less than 8 characters after dword declaration");
+        }
+
+        {
+            std::wstring ReadValue{ &Declaration[0], 8 };
+            std::wistringstream DwordReadingStream{ ReadValue, std::ios_base::in };
+            DwordReadingStream >> std::hex >> DwordValue;
+
+            std::wostringstream DwordVerificationStream;
+            DwordVerificationStream << std::hex << std::setw(8) << std::setfill(L'0') << DwordValue;
+
+            std::wstring VerificationString{ DwordVerificationStream.str() };
+            if (_wcsnicmp(VerificationString.c_str(), ReadValue.c_str(), 8) != 0)
+            {
+                return ReportParsingError(State, L"Value name " + Value.Name + L" - Could not parse dword from string " + ReadValue.c_str());
+            }
+        }
+
+        State.ValueData.resize(sizeof(DWORD));
+        CopyMemory(State.ValueData.data(), &DwordValue, sizeof(DwordValue));
+
+        Declaration.remove_prefix(8);
+
+        if (!ConsumeString(Declaration, Constants::RegFiles::NewLines))
+        {
+            return ReportParsingError(State, L"Value name " + Value.Name + L" - Dword value not followed by \\r\\n");
+        }
+
+        Window = Declaration;
+        StoreValue(State);
+        return S_OK;
+    }
+
+    if (ConsumeString(Declaration, Constants::RegFiles::HexPrefix))
+    {
+        // general case
+        if (Declaration.empty())
+        {
+            return NeedMoreInput(State, EndOfInput, L"Value name " + Value.Name + L" - End of buffer after hex declaration");
+        }
+
+        // in the general case, (xx) indicates the value type:
+        //                        "myvalue"=hex(xx):...
+        // for REG_BINARY, (xx) is omitted:
+        //                        "myvalue"=hex:...
+        // If we find the opening parenthese, we parse the registry type.
+        if (ConsumeChar(Declaration, Constants::RegFiles::HexTypeSpecOpening))
+        {
+            size_t ClosingParenPos = Declaration.find_first_not_of(L"0123456789abcdefABCDEF");
+            if (ClosingParenPos == Declaration.npos)
+            {
+                return NeedMoreInput(State, EndOfInput, L"Value name " + Value.Name + L" - Could not find closing parenthesis");
+            }
+            if (ClosingParenPos == 0 || Declaration[ClosingParenPos] != Constants::RegFiles::HexTypeSpecClosing)
+            {
+                return ReportParsingError(State, L"Value name " + Value.Name + L" - Could not find closing parenthesis");
+            }
+
+            {
+                std::wistringstream ValueTypeInStream{ std::wstring{ &Declaration[0], ClosingParenPos }, std::ios_base::in };
+                ValueTypeInStream >> std::hex >> Value.Type;
+            }
+            Declaration.remove_prefix(ClosingParenPos + 1);
+        }
+        else
+        {
+            Value.Type = REG_BINARY;
+        }
+
+        if (Declaration.empty())
+        {
+            return NeedMoreInput(State, EndOfInput, L"Value name " + Value.Name + L" - Missing : sign after hex declaration");
+        }
+        if (!ConsumeChar(Declaration, Constants::RegFiles::HexSuffix))
+        {
+            return ReportParsingError(State, L"Value name " + Value.Name + L" - Missing : sign after hex declaration");
+        }
+
+        Window = Declaration;
+        State.Step = RegfileParserStep::HexData;
+        return S_OK;
+    }
+
+    return ReportParsingError(State, L"Value name " + Value.Name + L" - Unknown rendition of value data");
+}
+
+/// @brief Consume bytes of a hexadecimal rendition, up to the end of the rendition or of a line
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed.
+_Must_inspect_result_
+static HRESULT ParseHexData
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    RegistryValue& Value = State.Value;
+
+    while (true)
+    {
+        // bulk of the rendition
+        Window.remove_prefix(DecodeHexRendition(Window, State.ValueData));
+
+        if (IsTruncated(Window, Constants::RegFiles::NewLines, EndOfInput) || IsTruncated(Window, Constants::RegFiles::HexByteNewLine, EndOfInput))
+        {
+            return E_PENDING;
+        }
+        if (Window.empty())
+        {
+            return ReportParsingError(State, L"Value name " + Value.Name + L" - End of data while reading binary value");
+        }
+        if (ConsumeString(Window, Constants::RegFiles::NewLines))
+        {
+            // end of binary data
+            StoreValue(State);
+            return S_OK;
+        }
+        else if (ConsumeChar(Window, Constants::RegFiles::HexByteSeparator))
+        {
+            continue;
+        }
+        else if (ConsumeString(Window, Constants::RegFiles::HexByteNewLine))
+        {
+            State.Step = RegfileParserStep::HexLeadingSpaces;
+            return S_OK;
+        }
+        else if (Window.length() == 1 && !EndOfInput)
+        {
+            // second digit may be in the next window
+            return E_PENDING;
+        }
+        else
+        {
+            return ReportParsingError(State, L"Value name " + Value.Name + L" - Expecting two hexadecimal digits");
+        }
+    }
+}
+
+/// @brief Consume the leading spaces of a continuation line in a hexadecimal rendition
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed.
+_Must_inspect_result_
+static HRESULT ParseHexLeadingSpaces
 (
-    _Inout_ std::wstring_view& ValueList,
-    _Inout_ std::vector<RegistryValue>& Values
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
 )
 {
-    auto ConsumeChars = [&ValueList](SIZE_T CharCount)
+    while (ConsumeChar(Window, Constants::RegFiles::LeadingSpace))
     {
-        ValueList.remove_prefix(CharCount);
-    };
+    }
 
-    auto HasChar = [&ValueList](CONST WCHAR ExpectedChar) -> bool
+    if (Window.empty() && !EndOfInput)
     {
-        bool ReturnValue = !ValueList.empty() && ValueList[0] == ExpectedChar;
-        if (ReturnValue)
-        {
-            ValueList.remove_prefix(1);
-        }
-        return ReturnValue;
-    };
+        // more spaces may follow in the next window
+        return E_PENDING;
+    }
 
-    auto HasString = [&ValueList](const std::wstring& ExpectedString) -> bool
-    {
-        bool ReturnValue = ValueList.length() >= ExpectedString.length() && std::equal(ExpectedString.cbegin(), ExpectedString.cend(), ValueList.cbegin());
-        if (ReturnValue)
-        {
-            ValueList.remove_prefix(ExpectedString.length());
-        }
-        return ReturnValue;
-    };
+    State.Step = RegfileParserStep::HexData;
+    return S_OK;
+}
 
-    auto EndOfStream = [&ValueList]() -> bool { return ValueList.empty(); };
+/// @brief Consume the remainder of a string rendition
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed.
+_Must_inspect_result_
+static HRESULT ParseStringData
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    RegistryValue& Value = State.Value;
 
-    do
+    if (ConsumeQuotedString(Window, State.ValueData) == E_PENDING)
     {
-        if (ValueList.empty())
-        {
-            return S_OK;
-        }
+        return NeedMoreInput(State, EndOfInput, L"Value name " + Value.Name + L" - Could not find end of string value");
+    }
 
-        // Values are all consumed when getting a new line.
-        if (HasString(Constants::RegFiles::NewLines))
-        {
-            while (HasString(Constants::RegFiles::NewLines))
-            {
-                //
-            }
+    // we must store a terminator in the registry value
+    static const WCHAR Terminator = L'\0';
+    AppendCodeUnits(State.ValueData, &Terminator, 1);
 
-            return S_OK;
-        }
+    State.Step = RegfileParserStep::StringEnd;
+    return S_OK;
+}
 
+/// @brief Consume the new line after a string rendition
+/// @param[in,out] State Parser state
+/// @param[in,out] Window Unparsed part of the window
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @return HRESULT semantics. E_PENDING if more input is needed.
+_Must_inspect_result_
+static HRESULT ParseStringEnd
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    if (IsTruncated(Window, Constants::RegFiles::NewLines, EndOfInput))
+    {
+        return E_PENDING;
+    }
+    if (!ConsumeString(Window, Constants::RegFiles::NewLines))
+    {
+        return ReportParsingError(State, L"Value name " + State.Value.Name + L" - Value not followed by new line");
+    }
 
-        RegistryValue Value;
+    StoreValue(State);
+    return S_OK;
+}
 
-        if (HasChar(Constants::RegFiles::DefaultValue))
-        {
-            Value.Name.clear();
-        }
-        else if (HasChar(L'"'))
-        {
-            // We must have a value name here
-            size_t ClosingQuotePos = 0;
-            std::wostringstream ValueNameStream;
-            while (true)
-            {
-                if (ClosingQuotePos >= ValueList.length())
-                {
-                    ReportError(E_UNEXPECTED, L"Looking for closing quotation mark");
-                    return E_UNEXPECTED;
-                }
-                if (ValueList[ClosingQuotePos] == L'"')
-                {
-                    break;
-                }
-                if (ClosingQuotePos + 1 >= ValueList.length())
-                {
-                    ReportError(E_UNEXPECTED, L"Buffer too short for value name");
-                    return E_UNEXPECTED;
-                }
-                if (ValueList[ClosingQuotePos] == L'\\')
-                {
-                    ValueNameStream << ValueList[ClosingQuotePos + 1];
-                    ClosingQuotePos += 2;
-                }
-                else if (ValueList[ClosingQuotePos] == L'\r' && ValueList[ClosingQuotePos + 1] == L'\n')
-                {
-                    // ignore \r before \n
-                    ClosingQuotePos += 1;
-                }
-                else
-                {
-                    ValueNameStream << ValueList[ClosingQuotePos];
-                    ClosingQuotePos += 1;
-                }
-            }
-            Value.Name = ValueNameStream.str();
-            ConsumeChars(ClosingQuotePos + 1);
-        }
-        else
+/// @brief Parse a window over a .reg file, as far as it goes
+/// @param[in,out] State Parser state, carried over from the previous window
+/// @param[in,out] Window Window over the file. Updated to the part that could not be parsed yet.
+/// @param[in] EndOfInput Whether #Window ends at the end of the file
+/// @retval S_FALSE The whole file has been parsed
+/// @retval E_PENDING The remainder of #Window must be followed by more input before parsing goes on.
+///                   Elements that are carried over windows (quoted strings, hexadecimal renditions)
+///                   are consumed up to a short suffix; others are left entirely in #Window.
+/// @return Other values: HRESULT semantics
+_Must_inspect_result_
+static HRESULT ParseRegfileWindow
+(
+    _Inout_ RegfileParserState& State,
+    _Inout_ std::wstring_view& Window,
+    _In_ const bool EndOfInput
+)
+{
+    HRESULT Result = S_OK;
+
+    while (Result == S_OK)
+    {
+        switch (State.Step)
         {
-            ReportError(E_UNEXPECTED, L"Value name should be literal @ or begin with double quote");
-            return E_UNEXPECTED;
+        case RegfileParserStep::Preamble:
+            Result = ParsePreamble(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::KeyPath:
+            Result = ParseKeyPath(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::ValueName:
+            Result = ParseValueName(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::QuotedValueName:
+            Result = ParseQuotedValueName(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::NameSeparator:
+            Result = ParseNameSeparator(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::ValueData:
+            Result = ParseValueData(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::HexData:
+            Result = ParseHexData(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::HexLeadingSpaces:
+            Result = ParseHexLeadingSpaces(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::StringData:
+            Result = ParseStringData(State, Window, EndOfInput);
+            break;
+        case RegfileParserStep::StringEnd:
+            Result = ParseStringEnd(State, Window, EndOfInput);
+            break;
+        default:
+            Result = E_UNEXPECTED;
+            ReportError(Result, L"Unknown parser step");
+            break;
         }
+    }
+
+    return Result;
+}
 
-        if (EndOfStream())
+/// @brief Skip a quoted string in a .reg file
+/// @param[in] Text Text of the file
+/// @param[in] Position Position after the opening quotation mark
+/// @return Position after the closing quotation mark, or std::wstring_view::npos if there is none
+static SIZE_T SkipQuotedString
+(
+    _In_ const std::wstring_view& Text,
+    _In_ SIZE_T Position
+)
+{
+    while (true)
+    {
+        Position = FindStructuralChar(Text, Position, StructuralClasses::Quotes | StructuralClasses::Backslashes);
+        if (Position == Text.npos)
         {
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Value " << Value.Name << L" - Missing data";
-            ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-            return E_UNEXPECTED;
+            return Text.npos;
         }
-        if (!HasChar(Constants::RegFiles::ValueNameSeparator))
+        if (Text[Position] == L'"')
         {
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Value name " << Value.Name << L" - Missing = sign";
-            ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-            return E_UNEXPECTED;
+            return Position + 1;
         }
+        // skip the escaped character
+        Position += 2;
+    }
+}
+
+/// @brief Find positions at which a .reg file may be cut into chunks that are parsed independently
+/// @param[in] Text Text of the file
+/// @param[in] Start Position of the first key path, after the preamble
+/// @param[in] ChunkCount Desired count of chunks, of roughly equal sizes
+/// @param[in,out] SplitPoints Positions of the opening brackets beginning each chunk but the first one, in ascending order
+/// @note Only the structure of lines is followed: a split point is an opening bracket at the beginning of a line, after
+///       a blank line and outside any string. Lines are not validated: splitting simply stops on unexpected content,
+///       which is then reported by the chunk parser.
+static void FindRegfileSplitPoints
+(
+    _In_ const std::wstring_view& Text,
+    _In_ const SIZE_T Start,
+    _In_ const SIZE_T ChunkCount,
+    _Inout_ std::vector<SIZE_T>& SplitPoints
+)
+{
+    static const std::wstring KeyClosingAtEOL = Constants::RegFiles::KeyClosing + Constants::RegFiles::NewLines;
+    SIZE_T Position = Start;
+    bool AfterBlankLine = true;
+
+    // each iteration skips a line, or several ones for strings and continued hexadecimal renditions
+    while (Position < Text.length() && SplitPoints.size() + 1 < ChunkCount)
+    {
+        const WCHAR FirstChar = Text[Position];
 
-        if (EndOfStream())
+        if (FirstChar == Constants::RegFiles::NewLines[0])
         {
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Value name " << Value.Name << L" - No data after = sign";
-            ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-            return E_UNEXPECTED;
+            if (Text.compare(Position, Constants::RegFiles::NewLines.length(), Constants::RegFiles::NewLines) != 0)
+            {
+                break;
+            }
+            Position += Constants::RegFiles::NewLines.length();
+            AfterBlankLine = true;
+            continue;
         }
 
-        if (HasString(Constants::RegFiles::DwordPrefix))
+        if (FirstChar == Constants::RegFiles::KeyOpening)
         {
-            Value.Type = REG_DWORD;
-            DWORD DwordValue;
-            if (ValueList.length() <= 8)
+            if (AfterBlankLine && Position > Start && Position >= (SplitPoints.size() + 1) * (Text.length() / ChunkCount))
             {
-                std::wostringstream ErrorMessageStream;
-                ErrorMessageStream << L"Value name " << Value.Name << L" - Buffer less than 8 characters after dword declaration";
-                ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                return E_UNEXPECTED;
+                SplitPoints.push_back(Position);
             }
 
+            SIZE_T EndKeyPos = Position + 1;
+            while (true)
             {
-                std::wstring ReadValue{ &ValueList[0], 8 };
-                std::wistringstream DwordReadingStream{ ReadValue, std::ios_base::in };
-                DwordReadingStream >> std::hex >> DwordValue;
-
-                std::wostringstream DwordVerificationStream;
-                DwordVerificationStream << std::hex << std::setw(8) << std::setfill(L'0') << DwordValue;
-
-                std::wstring VerificationString{ DwordVerificationStream.str() };
-                if (_wcsnicmp(VerificationString.c_str(), ReadValue.c_str(), 8) != 0)
+                EndKeyPos = FindStructuralChar(Text, EndKeyPos, StructuralClasses::Brackets);
+                if (EndKeyPos == Text.npos || Text.compare(EndKeyPos, KeyClosingAtEOL.length(), KeyClosingAtEOL) == 0)
                 {
-                    std::wostringstream ErrorMessageStream;
-                    ErrorMessageStream << L"Value name " << Value.Name << L" - Could not parse dword from string " << ReadValue;
-                    ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                    return E_UNEXPECTED;
+                    break;
                 }
+                EndKeyPos += 1;
             }
-
-            Value.BinaryValue.resize(sizeof(DWORD));
-            CopyMemory(Value.BinaryValue.data(), &DwordValue, sizeof(DwordValue));
-
-            ConsumeChars(8);
-
-            if (!HasString(Constants::RegFiles::NewLines))
+            if (EndKeyPos == Text.npos)
             {
-                std::wostringstream ErrorMessageStream;
-                ErrorMessageStream << L"Value name " << Value.Name << L" - Dword value not followed by \\r\\n";
-                ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                return E_UNEXPECTED;
+                break;
             }
-
+            Position = EndKeyPos + KeyClosingAtEOL.length();
         }
-        else if (HasString(Constants::RegFiles::HexPrefix))
+        else
         {
-            // general case
-            if (ValueList.empty())
+            // value name
+            if (FirstChar == L'"')
             {
-                std::wostringstream ErrorMessageStream;
-                ErrorMessageStream << L"Value name " << Value.Name << L" - End of buffer after hex declaration";
-                ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                return E_UNEXPECTED;
+                Position = SkipQuotedString(Text, Position + 1);
             }
-
-            // in the general case, (xx) indicates the value type:
-            //                        "myvalue"=hex(xx):...
-            // for REG_BINARY, (xx) is omitted:
-            //                        "myvalue"=hex:...
-            // If we find the opening parenthese, we parse the registry type.
-            if (HasChar(Constants::RegFiles::HexTypeSpecOpening))
+            else if (FirstChar == Constants::RegFiles::DefaultValue)
             {
-                size_t ClosingParenPos = ValueList.find_first_not_of(L"0123456789abcdefABCDEF");
-                if (ClosingParenPos == ValueList.npos || ClosingParenPos == 0 || ValueList[ClosingParenPos] != Constants::RegFiles::HexTypeSpecClosing)
-                {
-                    std::wostringstream ErrorMessageStream;
-                    ErrorMessageStream << L"Value name " << Value.Name << L" - Could not find closing parenthesis";
-                    ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                    return E_UNEXPECTED;
-                }
-
-                {
-                    std::wistringstream ValueTypeInStream{ std::wstring{ &ValueList[0], ClosingParenPos }, std::ios_base::in };
-                    ValueTypeInStream >> std::hex >> Value.Type;
-                }
-                ConsumeChars(ClosingParenPos + 1);
+                Position += 1;
             }
             else
             {
-                Value.Type = REG_BINARY;
+                break;
             }
-
-            if (!HasChar(Constants::RegFiles::HexSuffix))
+            if (Position >= Text.length() || Text[Position] != Constants::RegFiles::ValueNameSeparator)
             {
-                std::wostringstream ErrorMessageStream;
-                ErrorMessageStream << L"Value name " << Value.Name << L" - Missing : sign after hex declaration";
-                ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                return E_UNEXPECTED;
+                break;
             }
+            Position += 1;
 
-            while (true)
+            // value data, up to the end of its last line
+            if (Position < Text.length() && Text[Position] == L'"')
             {
-                if (ValueList.empty())
-                {
-                    std::wostringstream ErrorMessageStream;
-                    ErrorMessageStream << L"Value name " << Value.Name << L" - End of data while reading binary value";
-                    ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                    return E_UNEXPECTED;
-                }
-                if (HasString(Constants::RegFiles::NewLines))
-                {
-                    // end of binary data
-                    break;
-                }
-                else if (HasChar(Constants::RegFiles::HexByteSeparator))
-                {
-                    continue;
-                }
-                else if (HasString(Constants::RegFiles::HexByteNewLine))
-                {
-                    while (HasChar(Constants::RegFiles::LeadingSpace))
-                    {
-                    }
-                    continue;
-                }
-                else if (ValueList.length() >= 2 && isxdigit(ValueList[0]) && isxdigit(ValueList[1]))
-                {
-                    {
-                        int ByteVal;
-                        std::wistringstream HexValueInStream{ std::wstring{ &ValueList[0], 2 }, std::ios_base::in };
-                        HexValueInStream >> std::hex >> ByteVal;
-                        Value.BinaryValue.push_back(static_cast<BYTE>(ByteVal));
-                    }
-                    ConsumeChars(2);
-                    continue;
-                }
-                else
-                {
-                    std::wostringstream ErrorMessageStream;
-                    ErrorMessageStream << L"Value name " << Value.Name << L" - Expecting two hexadecimal digits";
-                    ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                    return E_UNEXPECTED;
-                }
+                Position = SkipQuotedString(Text, Position + 1);
             }
-        }
-        else if (HasChar(L'"'))
-        {
-            Value.Type = REG_SZ;
-            size_t ClosingQuotePos = 0;
-            std::wostringstream ValueString;
-            while (true)
+            else if (Position < Text.length())
             {
-                if (ClosingQuotePos >= ValueList.length())
-                {
-                    std::wostringstream ErrorMessageStream;
-                    ErrorMessageStream << L"Value name " << Value.Name << L" - Could not find end of string value";
-                    ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                    return E_UNEXPECTED;
-                }
-                if (ValueList[ClosingQuotePos] == L'"')
-                {
-                    break;
-                }
-                if (ClosingQuotePos + 1 >= ValueList.length())
-                {
-                    std::wostringstream ErrorMessageStream;
-                    ErrorMessageStream << L"Value name " << Value.Name << L" - Buffer too short, maybe missing newline after closing quotation mark";
-                    ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                    return E_UNEXPECTED;
-                }
-                if (ValueList[ClosingQuotePos] == L'\\')
-                {
-                    ValueString << ValueList[ClosingQuotePos + 1];
-                    ClosingQuotePos += 2;
-                }
-                else if (ValueList[ClosingQuotePos] == L'\r' && ValueList[ClosingQuotePos + 1] == L'\n')
-                {
-                    // ignore \r before \n
-                    ClosingQuotePos += 1;
-                }
-                else
-                {
-                    ValueString << ValueList[ClosingQuotePos];
-                    ClosingQuotePos += 1;
-                }
+                Position += GetHexRenditionLength(Text.substr(Position));
             }
-            ConsumeChars(ClosingQuotePos + 1);
-
-            // we must store a terminator in the registry value
-            std::wstring SzVal = ValueString.str() + L'\0';
-            Value.BinaryValue.resize(SzVal.length() * sizeof(WCHAR));
-            CopyMemory(Value.BinaryValue.data(), SzVal.c_str(), Value.BinaryValue.size());
-
-            if (!HasString(Constants::RegFiles::NewLines))
+            if (Position >= Text.length() || Text.compare(Position, Constants::RegFiles::NewLines.length(), Constants::RegFiles::NewLines) != 0)
             {
-                std::wostringstream ErrorMessageStream;
-                ErrorMessageStream << L"Value name " << Value.Name << L" - Value not followed by new line";
-                ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                return E_UNEXPECTED;
+                break;
             }
+            Position += Constants::RegFiles::NewLines.length();
         }
 
-        Values.emplace_back(std::move(Value));
-    } while (TRUE);
+        AfterBlankLine = false;
+    }
 }
 
-/// @brief Serializes the keys from a .reg file to internal representation
-/// @param[in,out] RegList Remainder of the .reg file before and after serialization
-///                        Updated to the next token after all keys (and their values) that 
-///                        begin with #PathPrefix, newlines having been consumed.
-/// @param[in] PathPrefix Prefix to all keys that are to be read
-/// @param[in,out] RegKeys Container for all read keys
+/// @brief Attach the keys of chunks of a .reg file to their parents, in file order
+/// @param[in,out] Chunks Parser states of the chunks, in file order. Their detached keys are moved to the tree.
+/// @param[in,out] Names Table in which the names of the detached keys are interned
+/// @param[out] RegKey Root key of the tree
+/// @return HRESULT semantics
 _Must_inspect_result_
-static HRESULT RegListToInternal
+static HRESULT StitchRegfileChunks
 (
-    _Inout_ std::wstring_view& RegList,
-    _In_ const std::wstring& PathPrefix,
-    _Inout_ std::vector<RegistryKey>& RegKeys
+    _Inout_ std::vector<RegfileParserState>& Chunks,
+    _Inout_ NameTable& Names,
+    _Out_ RegistryKey& RegKey
 )
 {
     HRESULT Result = E_FAIL;
-    static const std::wstring KeyClosingAtEOL = Constants::RegFiles::KeyClosing + Constants::RegFiles::NewLines;
+    std::vector<OpenedRegfileKey> OpenedKeys;
+    bool RootKeyFound = false;
 
-    // remove additional line breaks
-    while (RegList.length() >= 2 && RegList[0] == L'\r' && RegList[1] == L'\n')
+    for (RegfileParserState& Chunk : Chunks)
     {
-        RegList.remove_prefix(2);
+        for (DetachedRegfileKey& Detached : Chunk.DetachedKeys)
+        {
+            CloseNonAncestorKeys(OpenedKeys, Detached.Path);
+            Result = OpenRegfileKey(OpenedKeys, Names, &RegKey, RootKeyFound, Detached.Path, std::move(Detached.Key));
+            if (FAILED(Result))
+            {
+                return Result;
+            }
+        }
+
+        // keys left opened by the chunk may receive subkeys from the next chunks.
+        // The first one is the last detached key, which has just been opened at its place in the tree.
+        if (!Chunk.OpenedKeys.empty())
+        {
+            OpenedKeys.insert(OpenedKeys.end(), Chunk.OpenedKeys.cbegin() + 1, Chunk.OpenedKeys.cend());
+        }
     }
 
-    if (RegList.empty())
+    if (!RootKeyFound)
     {
-        std::wostringstream ErrorMessageStream;
-        ErrorMessageStream << L"Reading key beginning with prefix " << (PathPrefix.empty() ? L"<empty>" : PathPrefix.c_str()) << L" - Expecting content";
-        ReportError(E_UNEXPECTED, ErrorMessageStream.str());
+        ReportError(E_UNEXPECTED, L"Reading root key - Expecting content");
         return E_UNEXPECTED;
     }
 
-    do
-    {
-        if (RegList[0] != Constants::RegFiles::KeyOpening)
-        {
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Reading key beginning with prefix " << (PathPrefix.empty() ? L"<empty>" : PathPrefix.c_str()) << L" - Line does not begin with opening bracket";
-            ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-            return E_UNEXPECTED;
-        }
-        auto EndKeyPos = RegList.find(KeyClosingAtEOL, 1);
-        if (EndKeyPos == RegList.npos)
-        {
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Reading key beginning with prefix " << (PathPrefix.empty() ? L"<empty>" : PathPrefix.c_str()) << L" - Could not find closing bracket followed by new line";
-            ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-            return E_UNEXPECTED;
-        }
+    return S_OK;
+}
 
-        const std::wstring_view KeyPath{ &RegList[1], EndKeyPos - 1 };
+/// @brief Parse a .reg file mapped in memory, as chunks parsed on worker threads
+/// @param[in] RegFilePath Path to the registry .reg file
+/// @param[in] ThreadCount Count of worker threads
+/// @param[in,out] Names Table in which the names of keys and values are interned
+/// @param[out] RegKey Internal structure
+/// @return HRESULT semantics
+_Must_inspect_result_
+static HRESULT ParseRegfileInParallel
+(
+    _In_ const std::wstring& RegFilePath,
+    _In_ const SIZE_T ThreadCount,
+    _Inout_ NameTable& Names,
+    _Out_ RegistryKey& RegKey
+)
+{
+    HRESULT Result = E_FAIL;
+    MappedFile InFile;
+    std::vector<SIZE_T> SplitPoints;
+    std::vector<RegfileParserState> Chunks;
 
-        if (KeyPath.length() <= PathPrefix.length() || !std::equal(PathPrefix.cbegin(), PathPrefix.cend(), KeyPath.cbegin()))
-        {
-            // not a sub-key for our caller. maybe a parent caller could handle this.
-            break;
-        }
-        const std::wstring_view KeyName{ &KeyPath[PathPrefix.length()], KeyPath.length() - PathPrefix.length() };
+    RegKey = RegistryKey{ RegKey.get_allocator() };
 
-        RegistryKey NewKey;
-        NewKey.Name = KeyName;
-        // keys may have newlines in their name
-        GlobalStringSubstitute(NewKey.Name, L"\r\n", L"\n");
+    Result = InFile.Open(RegFilePath);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Mapping registry file " + RegFilePath);
+        return Result;
+    }
 
-        RegList.remove_prefix(EndKeyPos + 1);
-        RegList.remove_prefix(Constants::RegFiles::NewLines.length());
-        Result = ValueListToInternal(RegList, NewKey.Values);
-        if (FAILED(Result))
-        {
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Reading key " << PathPrefix << KeyName << L" - Could not read values";
-            ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-            return Result;
-        }
+    if (InFile.Size() % sizeof(WORD) != 0)
+    {
+        Result = E_UNEXPECTED;
+        ReportError(Result, L"File " + RegFilePath + L" should have an even size because it is expected to hold UTF-16 code units only");
+        return Result;
+    }
 
-        if (!RegList.empty())
-        {
-            std::wstring NewPrefix = std::wstring{ KeyPath } + Constants::RegFiles::PathSeparator;
-            Result = RegListToInternal(RegList, NewPrefix, NewKey.Subkeys);
-            if (FAILED(Result))
-            {
-                std::wostringstream ErrorMessageStream;
-                ErrorMessageStream << L"Checking if there are keys beginning with " << NewPrefix;
-                ReportError(E_UNEXPECTED, ErrorMessageStream.str());
-                return Result;
-            }
-        }
+#if WCHAR_MAX > 0xFFFF
+    // wide strings hold UTF-32: the file is decoded once, and cut into chunks afterwards
+    std::wstring DecodedText;
+    Regf::DecodeUtf16(InFile.Data(), InFile.Size(), DecodedText);
+    const std::wstring_view Text{ DecodedText };
+#else
+    // the mapping is page-aligned, so it may be viewed as WCHAR code units directly
+    const std::wstring_view Text{ reinterpret_cast<const WCHAR*>(InFile.Data()), InFile.Size() / sizeof(WCHAR) };
+#endif
 
-        RegKeys.emplace_back(std::move(NewKey));
+    const SIZE_T ChunkCount = std::min(ThreadCount * Constants::RegFiles::ParallelChunksPerThread, Text.length() / Constants::RegFiles::ParallelChunkMinimalLength);
+    if (ChunkCount > 1 && Text.compare(0, Constants::RegFiles::Preamble.length(), Constants::RegFiles::Preamble) == 0)
+    {
+        FindRegfileSplitPoints(Text, Constants::RegFiles::Preamble.length(), ChunkCount, SplitPoints);
+    }
+
+    Chunks.reserve(SplitPoints.size() + 1);
+    for (SIZE_T ChunkIndex = 0; ChunkIndex <= SplitPoints.size(); ++ChunkIndex)
+    {
+        Chunks.emplace_back(RegKey.get_allocator(), Names);
+    }
+    Result = RunParallelTasks(Chunks.size(), ThreadCount, [&](SIZE_T ChunkIndex) -> HRESULT
+    {
+        RegfileParserState& Chunk = Chunks[ChunkIndex];
+        const SIZE_T ChunkStart = ChunkIndex == 0 ? 0 : SplitPoints[ChunkIndex - 1];
+        const SIZE_T ChunkEnd = ChunkIndex == SplitPoints.size() ? Text.length() : SplitPoints[ChunkIndex];
+        std::wstring_view Window = Text.substr(ChunkStart, ChunkEnd - ChunkStart);
 
-        while (RegList.length() >= 2 && RegList[0] == L'\r' && RegList[1] == L'\n')
+        Chunk.Step = ChunkIndex == 0 ? RegfileParserStep::Preamble : RegfileParserStep::KeyPath;
+
+        // each chunk ends with a blank line, like a whole file
+        HRESULT ChunkResult = ParseRegfileWindow(Chunk, Window, true);
+        if (ChunkResult != S_FALSE)
         {
-            RegList.remove_prefix(1);
+            ChunkResult = FAILED(ChunkResult) ? ChunkResult : E_UNEXPECTED;
+            ReportError(ChunkResult, L"Parsing chunk of registry file " + RegFilePath + L" at offset " + std::to_wstring(ChunkStart * sizeof(WCHAR)));
+            return ChunkResult;
         }
-    } while (!RegList.empty());
+        return S_OK;
+    });
+    if (FAILED(Result))
+    {
+        return Result;
+    }
+
+    Result = StitchRegfileChunks(Chunks, Names, RegKey);
+    if (FAILED(Result))
+    {
+        ReportError(Result, L"Assembling keys of registry file " + RegFilePath);
+        return Result;
+    }
 
     return S_OK;
 }
 
-// non-static function: documented in header.
+/// @brief Parse a .reg file sequentially, through a window of bounded size
+/// @param[in] RegFilePath Path to the registry .reg file
+/// @param[in] BufferSize Size in bytes of the window
+/// @param[in,out] Names Table in which the names of keys and values are interned
+/// @param[out] RegKey Internal structure
+/// @return HRESULT semantics
 _Must_inspect_result_
-HRESULT RegfileToInternal
+static HRESULT StreamRegfileToInternal
 (
     _In_ const std::wstring& RegFilePath,
+    _In_ const SIZE_T BufferSize,
+    _Inout_ NameTable& Names,
     _Out_ RegistryKey& RegKey
 )
 {
     HRESULT Result = E_FAIL;
-    HANDLE InFileHandle = INVALID_HANDLE_VALUE;
-    LARGE_INTEGER FileSize;
-    std::wstring FileContents;
-    std::vector<RegistryKey> KeysInFile;
+    InputFile InFile;
+    std::vector<WCHAR> Buffer;
+    SIZE_T BufferedSize = 0;
+    bool EndOfInput = false;
+#if WCHAR_MAX > 0xFFFF
+    std::wstring DecodedText;
+#endif
 
-    InFileHandle = CreateFileW(RegFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (InFileHandle == INVALID_HANDLE_VALUE)
-    {
-        Result = HRESULT_FROM_WIN32(GetLastError());
-        ReportError(Result, L"Opening file " + RegFilePath);
-        goto Cleanup;
-    }
+    RegKey = RegistryKey{ RegKey.get_allocator() };
 
-    if (!GetFileSizeEx(InFileHandle, &FileSize))
-    {
-        Result = HRESULT_FROM_WIN32(GetLastError());
-        ReportError(Result, L"Getting file size of " + RegFilePath);
-        goto Cleanup;
-    }
+    RegfileParserState State{ RegKey.get_allocator(), Names };
+    State.RootKey = &RegKey;
 
-    if (FileSize.HighPart > 0)
+    if (BufferSize < sizeof(WCHAR))
     {
-        Result = E_OUTOFMEMORY;
-        ReportError(Result, L"File " + RegFilePath + L" is too large (larger than 4GB)");
+        Result = E_INVALIDARG;
+        ReportError(Result, L"Buffer size is too small to hold a single character");
         goto Cleanup;
     }
 
-    if (FileSize.LowPart % sizeof(WCHAR) != 0)
+    Result = InFile.Open(RegFilePath);
+    if (FAILED(Result))
     {
-        Result = E_UNEXPECTED;
-        ReportError(Result, L"File " + RegFilePath + L" should have an even size because it is expected to hold WCHAR code units only");
+        ReportError(Result, L"Opening registry file " + RegFilePath);
         goto Cleanup;
     }
 
-    // resize buffer
-    FileContents.resize(FileSize.LowPart / sizeof(WCHAR), L'\0');
+    Buffer.resize(BufferSize / sizeof(WCHAR));
 
+    while (!EndOfInput)
     {
-        DWORD BytesRead = 0;
-        if (!ReadFile(InFileHandle, (PVOID)(&FileContents[0]), FileSize.LowPart, &BytesRead, NULL))
+        BYTE* BufferBytes = reinterpret_cast<BYTE*>(Buffer.data());
+        const SIZE_T BufferCapacity = Buffer.size() * sizeof(WCHAR);
+        SIZE_T BytesRead = 0;
+
+        Result = InFile.Read(BufferBytes + BufferedSize, BufferCapacity - BufferedSize, BytesRead);
+        if (FAILED(Result))
         {
-            Result = HRESULT_FROM_WIN32(GetLastError());
+            ReportError(Result, L"Reading registry file " + RegFilePath);
             goto Cleanup;
         }
-        if (BytesRead != FileSize.LowPart)
+        BufferedSize += BytesRead;
+        EndOfInput = BytesRead == 0;
+
+        if (EndOfInput && BufferedSize % sizeof(WORD) != 0)
         {
             Result = E_UNEXPECTED;
-            ReportError(Result, L"File " + RegFilePath + L" could not be read to buffer");
+            ReportError(Result, L"File " + RegFilePath + L" should have an even size because it is expected to hold UTF-16 code units only");
             goto Cleanup;
         }
-    }
-
-    {
-        std::wstring_view Remainder { FileContents };
 
-        if (Remainder.length() < Constants::RegFiles::Preamble.length() || !std::equal(Constants::RegFiles::Preamble.cbegin(), Constants::RegFiles::Preamble.cend(), FileContents.cbegin()))
+#if WCHAR_MAX > 0xFFFF
+        // wide strings hold UTF-32: the buffer holds the bytes of the file, and the window their decoding.
+        // The first half of a surrogate pair waits for the second one.
+        SIZE_T DecodedSize = BufferedSize - BufferedSize % sizeof(WORD);
+        if (!EndOfInput && DecodedSize != 0)
         {
-            Result = E_UNEXPECTED;
-            ReportError(Result, L"File " + RegFilePath + L" preamble not found");
-            goto Cleanup;
+            const WORD LastCodeUnit = Regf::ReadWord(BufferBytes + DecodedSize - sizeof(WORD));
+            if (LastCodeUnit >= 0xD800u && LastCodeUnit <= 0xDBFFu)
+            {
+                DecodedSize -= sizeof(WORD);
+            }
         }
-
-        Remainder.remove_prefix(Constants::RegFiles::Preamble.length());
-
-        Result = RegListToInternal(Remainder, std::wstring{}, KeysInFile);
-        if (FAILED(Result))
+        Regf::DecodeUtf16(BufferBytes, DecodedSize, DecodedText);
+        std::wstring_view Window{ DecodedText };
+#else
+        std::wstring_view Window{ Buffer.data(), BufferedSize / sizeof(WCHAR) };
+#endif
+        Result = ParseRegfileWindow(State, Window, EndOfInput);
+        if (Result == S_FALSE)
         {
-            goto Cleanup;
+            break;
         }
-
-        // at first level, should have exactly one registry key
-        if (KeysInFile.size() != 1)
+        if (Result != E_PENDING)
         {
-            Result = E_UNEXPECTED;
-            ReportError(Result, L"Multiple root keys were found in the registry file");
+            ReportError(Result, L"Parsing registry file " + RegFilePath);
             goto Cleanup;
         }
 
-        // whole file should have been slurped.
-        if (Remainder.length() != 0)
+        // carry the unparsed part of the window, and any odd byte, over to the next window
+#if WCHAR_MAX > 0xFFFF
+        const SIZE_T ConsumedSize = Regf::Utf16Length(std::wstring_view{ DecodedText }.substr(0, DecodedText.length() - Window.length())) * sizeof(WORD);
+#else
+        const SIZE_T ConsumedSize = (BufferedSize / sizeof(WCHAR) - Window.length()) * sizeof(WCHAR);
+#endif
+        MoveMemory(BufferBytes, BufferBytes + ConsumedSize, BufferedSize - ConsumedSize);
+        BufferedSize -= ConsumedSize;
+
+        if (BufferedSize == BufferCapacity)
         {
-            Result = E_UNEXPECTED;
-            std::wostringstream ErrorMessageStream;
-            ErrorMessageStream << L"Conversion to internal structure left " << Remainder.length() << L" code units in the file unparsed";
-            ReportError(Result, ErrorMessageStream.str());
-            goto Cleanup;
+            // a single element does not fit in the buffer
+            Buffer.resize(Buffer.size() * 2);
         }
-
-        RegKey = KeysInFile[0];
     }
 
     Result = S_OK;
 
 Cleanup:
-    if (InFileHandle != INVALID_HANDLE_VALUE)
+    return Result;
+}
+
+// non-static function: documented in header.
+_Must_inspect_result_
+HRESULT RegfileToInternal
+(
+    _In_ const std::wstring& RegFilePath,
+    _In_ const SIZE_T BufferSize,
+    _In_ const SIZE_T ThreadCount,
+    _Inout_ NameTable& Names,
+    _Out_ RegistryKey& RegKey
+)
+{
+    if (ThreadCount > 1)
     {
-        CloseHandle(InFileHandle);
-        InFileHandle = INVALID_HANDLE_VALUE;
+        return ParseRegfileInParallel(RegFilePath, ThreadCount, Names, RegKey);
     }
-
-    return Result;
+    return StreamRegfileToInternal(RegFilePath, BufferSize, Names, RegKey);
 }
@@ -0,0 +1,245 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "StructuralScan.h"
+#include <cstdint>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define STRUCTURAL_SCAN_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define STRUCTURAL_SCAN_AVX2_FUNCTION
+#else
+#define STRUCTURAL_SCAN_AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+/// Maximal count of distinct structural code units
+static const SIZE_T MaximalStructuralCharCount = 7u;
+
+// non-static function: documented in header.
+DWORD ClassifyStructuralChar
+(
+    _In_ const WCHAR CodeUnit
+)
+{
+    switch (CodeUnit)
+    {
+    case L'[':
+    case L']':
+        return StructuralClasses::Brackets;
+    case L'"':
+        return StructuralClasses::Quotes;
+    case L'\\':
+        return StructuralClasses::Backslashes;
+    case L'\r':
+    case L'\n':
+        return StructuralClasses::NewLines;
+    case L'=':
+        return StructuralClasses::Equals;
+    default:
+        return 0u;
+    }
+}
+
+/// @brief Scan code units one at a time
+/// @param[in] Text Text to scan
+/// @param[in] Start Position in #Text at which the scan begins
+/// @param[in] Classes Combination of #StructuralClasses to look for
+/// @return Position of the first matching code unit, or std::wstring_view::npos
+static SIZE_T FindStructuralCharScalar
+(
+    _In_ const std::wstring_view& Text,
+    _In_ const SIZE_T Start,
+    _In_ const DWORD Classes
+)
+{
+    for (SIZE_T Position = Start; Position < Text.length(); ++Position)
+    {
+        if ((ClassifyStructuralChar(Text[Position]) & Classes) != 0)
+        {
+            return Position;
+        }
+    }
+    return std::wstring_view::npos;
+}
+
+#ifdef STRUCTURAL_SCAN_SIMD
+
+/// @brief List the code units belonging to some structural classes
+/// @param[in] Classes Combination of #StructuralClasses
+/// @param[out] Chars Code units of #Classes
+/// @return Count of valid entries in #Chars
+static SIZE_T GetStructuralChars
+(
+    _In_ const DWORD Classes,
+    _Out_ uint16_t (&Chars)[MaximalStructuralCharCount]
+)
+{
+    static const WCHAR AllChars[MaximalStructuralCharCount] = { L'[', L']', L'"', L'\\', L'\r', L'\n', L'=' };
+    SIZE_T CharCount = 0;
+
+    for (const WCHAR Char : AllChars)
+    {
+        if ((ClassifyStructuralChar(Char) & Classes) != 0)
+        {
+            Chars[CharCount++] = static_cast<uint16_t>(Char);
+        }
+    }
+    return CharCount;
+}
+
+/// @brief Get the index of the lowest set bit of a non-zero mask
+static unsigned long LowestSetBit
+(
+    _In_ const uint32_t Mask
+)
+{
+#ifdef _MSC_VER
+    unsigned long Index = 0;
+    _BitScanForward(&Index, Mask);
+    return Index;
+#else
+    return static_cast<unsigned long>(__builtin_ctz(Mask));
+#endif
+}
+
+/// @brief Check whether the processor and the operating system support AVX2
+static bool IsAvx2Supported()
+{
+#ifdef _MSC_VER
+    int CpuInfo[4] = { 0 };
+    __cpuid(CpuInfo, 0);
+    if (CpuInfo[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(CpuInfo, 1);
+    const bool HasOsxsave = (CpuInfo[2] & (1 << 27)) != 0;
+    const bool HasAvx = (CpuInfo[2] & (1 << 28)) != 0;
+    if (!HasOsxsave || !HasAvx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(CpuInfo, 7, 0);
+    return (CpuInfo[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+/// @brief Scan UTF-16 code units 8 at a time
+/// @param[in] Text Code units to scan
+/// @param[in] Length Count of code units in #Text
+/// @param[in,out] Position Position at which the scan begins. Updated to the first matching code unit,
+///                or to the beginning of the last incomplete block of 8 code units.
+/// @param[in] Chars Code units to look for
+/// @param[in] CharCount Count of valid entries in #Chars
+/// @return true if a matching code unit was found
+static bool FindStructuralCharSse2
+(
+    _In_ const uint16_t* Text,
+    _In_ const SIZE_T Length,
+    _Inout_ SIZE_T& Position,
+    _In_ const uint16_t (&Chars)[MaximalStructuralCharCount],
+    _In_ const SIZE_T CharCount
+)
+{
+    __m128i Targets[MaximalStructuralCharCount];
+    for (SIZE_T CharIndex = 0; CharIndex < CharCount; ++CharIndex)
+    {
+        Targets[CharIndex] = _mm_set1_epi16(static_cast<short>(Chars[CharIndex]));
+    }
+
+    for (; Position + 8 <= Length; Position += 8)
+    {
+        const __m128i Units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Text + Position));
+        __m128i Matches = _mm_setzero_si128();
+        for (SIZE_T CharIndex = 0; CharIndex < CharCount; ++CharIndex)
+        {
+            Matches = _mm_or_si128(Matches, _mm_cmpeq_epi16(Units, Targets[CharIndex]));
+        }
+        const uint32_t Mask = static_cast<uint32_t>(_mm_movemask_epi8(Matches));
+        if (Mask != 0)
+        {
+            // two mask bits per code unit
+            Position += LowestSetBit(Mask) / 2;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Scan UTF-16 code units 16 at a time
+/// @note Same contract as #FindStructuralCharSse2, with blocks of 16 code units
+STRUCTURAL_SCAN_AVX2_FUNCTION
+static bool FindStructuralCharAvx2
+(
+    _In_ const uint16_t* Text,
+    _In_ const SIZE_T Length,
+    _Inout_ SIZE_T& Position,
+    _In_ const uint16_t (&Chars)[MaximalStructuralCharCount],
+    _In_ const SIZE_T CharCount
+)
+{
+    __m256i Targets[MaximalStructuralCharCount];
+    for (SIZE_T CharIndex = 0; CharIndex < CharCount; ++CharIndex)
+    {
+        Targets[CharIndex] = _mm256_set1_epi16(static_cast<short>(Chars[CharIndex]));
+    }
+
+    for (; Position + 16 <= Length; Position += 16)
+    {
+        const __m256i Units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Text + Position));
+        __m256i Matches = _mm256_setzero_si256();
+        for (SIZE_T CharIndex = 0; CharIndex < CharCount; ++CharIndex)
+        {
+            Matches = _mm256_or_si256(Matches, _mm256_cmpeq_epi16(Units, Targets[CharIndex]));
+        }
+        const uint32_t Mask = static_cast<uint32_t>(_mm256_movemask_epi8(Matches));
+        if (Mask != 0)
+        {
+            // two mask bits per code unit
+            Position += LowestSetBit(Mask) / 2;
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
+
+// non-static function: documented in header.
+SIZE_T FindStructuralChar
+(
+    _In_ const std::wstring_view& Text,
+    _In_ const SIZE_T Start,
+    _In_ const DWORD Classes
+)
+{
+    SIZE_T Position = Start;
+
+#ifdef STRUCTURAL_SCAN_SIMD
+    if constexpr (sizeof(WCHAR) == sizeof(uint16_t))
+    {
+        static const bool Avx2Supported = IsAvx2Supported();
+        uint16_t Chars[MaximalStructuralCharCount];
+        const SIZE_T CharCount = GetStructuralChars(Classes, Chars);
+        const uint16_t* Units = reinterpret_cast<const uint16_t*>(Text.data());
+
+        if (Avx2Supported && FindStructuralCharAvx2(Units, Text.length(), Position, Chars, CharCount))
+        {
+            return Position;
+        }
+        if (FindStructuralCharSse2(Units, Text.length(), Position, Chars, CharCount))
+        {
+            return Position;
+        }
+    }
+#endif
+
+    // remaining code units, or all of them without SIMD support
+    return FindStructuralCharScalar(Text, Position, Classes);
+}
@@ -0,0 +1,48 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include <string_view>
+
+/// Classes of code units that delimit the structure of a .reg file
+namespace StructuralClasses {
+    /// Opening and closing brackets around key paths
+    static const DWORD Brackets = 0x01u;
+
+    /// Double quotes around value names and string data
+    static const DWORD Quotes = 0x02u;
+
+    /// Backslashes, escaping characters in strings or continuing hexadecimal renditions
+    static const DWORD Backslashes = 0x04u;
+
+    /// Carriage returns and line feeds
+    static const DWORD NewLines = 0x08u;
+
+    /// Equal signs between value names and value data
+    static const DWORD Equals = 0x10u;
+};
+
+/// @brief Classify a code unit of a .reg file
+/// @param[in] CodeUnit Code unit to classify
+/// @return One of #StructuralClasses, or zero for code units that are not structural
+DWORD ClassifyStructuralChar
+(
+    _In_ const WCHAR CodeUnit
+);
+
+/// @brief Find the next structural code unit of some classes in a .reg file
+/// @param[in] Text Text to scan
+/// @param[in] Start Position in #Text at which the scan begins
+/// @param[in] Classes Combination of #StructuralClasses to look for
+/// @return Position of the first code unit at or after #Start that belongs to one of #Classes,
+///         or std::wstring_view::npos if there is none
+/// @note UTF-16 code units are compared 8 (SSE2) or 16 (AVX2) at a time where available.
+SIZE_T FindStructuralChar
+(
+    _In_ const std::wstring_view& Text,
+    _In_ const SIZE_T Start,
+    _In_ const DWORD Classes
+);
@@ -0,0 +1,151 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#include "ValueData.h"
+#include <algorithm>
+#include <cstring>
+
+ValueData::ValueData
+(
+    _Inout_ ValueData&& Other
+) noexcept :
+    Allocator(Other.Allocator)
+{
+    if (Other.IsInline())
+    {
+        std::memcpy(Inline, Other.Inline, Other.Size);
+    }
+    else
+    {
+        Heap = Other.Heap;
+        Capacity = Other.Capacity;
+        Other.Capacity = Constants::Defaults::ValueDataInlineSize;
+    }
+    Size = Other.Size;
+    Other.Size = 0;
+}
+
+ValueData::ValueData
+(
+    _Inout_ ValueData&& Other,
+    _In_ const allocator_type& Allocator
+) :
+    Allocator(Allocator)
+{
+    // storage may only be taken over from the same memory resource
+    if (!Other.IsInline() && Other.Allocator == Allocator)
+    {
+        Heap = Other.Heap;
+        Capacity = Other.Capacity;
+        Size = Other.Size;
+        Other.Capacity = Constants::Defaults::ValueDataInlineSize;
+        Other.Size = 0;
+    }
+    else
+    {
+        assign(Other.data(), Other.Size);
+    }
+}
+
+ValueData& ValueData::operator=
+(
+    _Inout_ ValueData&& Other
+)
+{
+    if (this == &Other)
+    {
+        return *this;
+    }
+
+    if (!Other.IsInline() && Other.Allocator == Allocator)
+    {
+        Release();
+        Heap = Other.Heap;
+        Capacity = Other.Capacity;
+        Size = Other.Size;
+        Other.Capacity = Constants::Defaults::ValueDataInlineSize;
+        Other.Size = 0;
+    }
+    else
+    {
+        assign(Other.data(), Other.Size);
+    }
+    return *this;
+}
+
+ValueData::~ValueData()
+{
+    Release();
+}
+
+void ValueData::Release()
+{
+    if (!IsInline())
+    {
+        Allocator.resource()->deallocate(Heap, Capacity, alignof(std::max_align_t));
+        Capacity = Constants::Defaults::ValueDataInlineSize;
+    }
+}
+
+void ValueData::reserve
+(
+    _In_ const SIZE_T NewCapacity
+)
+{
+    if (NewCapacity <= Capacity)
+    {
+        return;
+    }
+
+    BYTE* NewHeap = static_cast<BYTE*>(Allocator.resource()->allocate(NewCapacity, alignof(std::max_align_t)));
+    std::memcpy(NewHeap, data(), Size);
+
+    Release();
+    Heap = NewHeap;
+    Capacity = NewCapacity;
+}
+
+void ValueData::resize
+(
+    _In_ const SIZE_T NewSize
+)
+{
+    reserve(NewSize);
+    if (NewSize > Size)
+    {
+        std::memset(data() + Size, 0, NewSize - Size);
+    }
+    Size = NewSize;
+}
+
+void ValueData::assign
+(
+    _In_ const BYTE* Bytes,
+    _In_ const SIZE_T Count
+)
+{
+    // exact size: data is usually assigned once
+    Size = 0;
+    reserve(Count);
+    append(Bytes, Count);
+}
+
+void ValueData::append
+(
+    _In_ const BYTE* Bytes,
+    _In_ const SIZE_T Count
+)
+{
+    if (Count == 0)
+    {
+        return;
+    }
+    if (Size + Count > Capacity)
+    {
+        // geometric growth, so that appending piece by piece stays linear
+        reserve(std::max(Size + Count, Capacity * 2));
+    }
+    std::memcpy(data() + Size, Bytes, Count);
+    Size += Count;
+}
@@ -0,0 +1,115 @@
+// (C) Stormshield 2025
+// Licensed under the Apache license, version 2.0
+// See LICENSE.txt for details
+
+#pragma once
+
+#include "Platform.h"
+#include "Constants.h"
+#include <cstddef>
+#include <memory_resource>
+
+/// Data of a registry value. Data up to Constants::Defaults::ValueDataInlineSize bytes is stored within the object;
+/// larger data is stored in memory obtained from the allocator.
+/// @note The allocator follows the rules of std::pmr containers: it is kept by moves.
+/// @note Data cannot be copied, only moved, like the registry values holding it.
+class ValueData {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    ValueData() noexcept = default;
+
+    explicit ValueData(const allocator_type& Allocator) noexcept :
+        Allocator(Allocator)
+    {
+    }
+
+    ValueData(const ValueData&) = delete;
+
+    ValueData(ValueData&& Other) noexcept;
+
+    ValueData(ValueData&& Other, const allocator_type& Allocator);
+
+    ValueData& operator=(const ValueData&) = delete;
+
+    ValueData& operator=(ValueData&& Other);
+
+    ~ValueData();
+
+    /// @brief Get the allocator of the data
+    allocator_type get_allocator() const { return Allocator; }
+
+    /// @brief Get the beginning of the data, aligned for numbers up to 8 bytes wide
+    const BYTE* data() const { return IsInline() ? Inline : Heap; }
+    BYTE* data() { return IsInline() ? Inline : Heap; }
+
+    /// @brief Get the size of the data, in bytes
+    SIZE_T size() const { return Size; }
+
+    /// @brief Check whether the data is empty
+    bool empty() const { return Size == 0; }
+
+    const BYTE* begin() const { return data(); }
+    const BYTE* end() const { return data() + Size; }
+    const BYTE* cbegin() const { return data(); }
+    const BYTE* cend() const { return data() + Size; }
+
+    /// @brief Remove all bytes, keeping the storage
+    void clear() { Size = 0; }
+
+    /// @brief Make room for exactly a given size, so that the data may reach it without reallocating
+    /// @param[in] NewCapacity Size in bytes that the data may reach without reallocating
+    void reserve
+    (
+        _In_ const SIZE_T NewCapacity
+    );
+
+    /// @brief Change the size of the data. Added bytes are zeroed.
+    /// @param[in] NewSize New size of the data, in bytes
+    void resize
+    (
+        _In_ const SIZE_T NewSize
+    );
+
+    /// @brief Replace the data
+    /// @param[in] Bytes New data
+    /// @param[in] Count Size of the new data, in bytes
+    void assign
+    (
+        _In_ const BYTE* Bytes,
+        _In_ const SIZE_T Count
+    );
+
+    /// @brief Append bytes to the data
+    /// @param[in] Bytes Bytes to append
+    /// @param[in] Count Count of bytes to append
+    void append
+    (
+        _In_ const BYTE* Bytes,
+        _In_ const SIZE_T Count
+    );
+
+private:
+    /// @brief Check whether the data is stored within the object
+    bool IsInline() const { return Capacity == Constants::Defaults::ValueDataInlineSize; }
+
+    /// @brief Give back the memory obtained from the allocator, if any, and store the data within the object again
+    void Release();
+
+    /// Allocator of the memory holding data that does not fit in the object
+    allocator_type Allocator;
+
+    /// Size of the data, in bytes
+    SIZE_T Size = 0;
+
+    /// Size of the storage, in bytes. Equals Constants::Defaults::ValueDataInlineSize when the data is stored in #Inline.
+    SIZE_T Capacity = Constants::Defaults::ValueDataInlineSize;
+
+    union {
+        /// Storage of small data
+        alignas(ULONGLONG) BYTE Inline[Constants::Defaults::ValueDataInlineSize];
+
+        /// Storage of large data, obtained from #Allocator
+        BYTE* Heap;
+    };
+};